@@ -0,0 +1,272 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Corpus.hpp"
+#include "Image.hpp"
+#include "ThreadPool.hpp"
+
+// Decodes every image of the synthetic corpus and prints one JSON object per line: the machine
+// first, then the best time of each stage for every image and parallelism policy.
+//
+//   pngreader_bench [--max-size N] [--min-time MS] [--match TEXT] [--policy serial|auto|parallel]
+//                   [--write-corpus DIR]
+
+namespace
+{
+struct BenchArgs
+{
+	std::uint32_t maxSize = 1024;
+	double minTimeMs      = 100.0;
+	std::string match;
+	std::vector<std::string> policies;
+	std::string corpusDir;
+};
+
+// Best of repeated decodes, in nanoseconds.
+struct StageTimes
+{
+	double parse   = std::numeric_limits<double>::max();
+	double inflate = std::numeric_limits<double>::max();
+	double decode  = std::numeric_limits<double>::max();
+	double total   = std::numeric_limits<double>::max();
+	std::size_t iterations = 0;
+};
+
+BenchArgs parse_args(int argc, char** argv)
+{
+	BenchArgs args;
+
+	for (int index = 1; index < argc; ++index)
+	{
+		std::string arg = argv[index];
+
+		if (index + 1 >= argc)
+		{
+			throw std::runtime_error("TRV::BENCH::MAIN - Missing value for " + arg);
+		}
+
+		std::string value = argv[++index];
+
+		if (arg == "--max-size")
+		{
+			args.maxSize = static_cast<std::uint32_t>(std::stoul(value));
+		}
+		else if (arg == "--min-time")
+		{
+			args.minTimeMs = std::stod(value);
+		}
+		else if (arg == "--match")
+		{
+			args.match = value;
+		}
+		else if (arg == "--policy")
+		{
+			args.policies.push_back(value);
+		}
+		else if (arg == "--write-corpus")
+		{
+			args.corpusDir = value;
+		}
+		else
+		{
+			throw std::runtime_error("TRV::BENCH::MAIN - Unknown option " + arg);
+		}
+	}
+
+	if (args.policies.empty())
+	{
+		args.policies = { "serial", "auto" };
+	}
+
+	return args;
+}
+
+trv::ParallelismPolicy policy_named(const std::string& name)
+{
+	if (name == "serial")
+	{
+		return { trv::Parallelism::Serial };
+	}
+	if (name == "parallel")
+	{
+		return { trv::Parallelism::Parallel };
+	}
+	if (name == "auto")
+	{
+		return { trv::Parallelism::Auto };
+	}
+
+	throw std::runtime_error("TRV::BENCH::MAIN - Unknown policy " + name);
+}
+
+double elapsed_ns(std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// Decodes file to 16-bit samples and compares them with the generator.
+bool verify(const trv::bench::CorpusCase& image, std::span<const unsigned char> file)
+{
+	trv::DecodeOptions options;
+	options.parallelism = trv::ParallelismPolicy { trv::Parallelism::Serial };
+
+	trv::Chunks chunks = trv::read_chunks(file, options);
+	trv::ImageInfo info = trv::image_info(chunks, options);
+
+	std::vector<unsigned char> decompressed = trv::decompress_image(chunks, options);
+	std::vector<std::uint16_t> output(std::size_t { info.width } * info.height * info.channels);
+	trv::decode_chunks<std::uint16_t>(chunks, decompressed, output, info.width * info.channels,
+	                                  options);
+
+	std::uint32_t scale = 65535 / ((1u << image.bitDepth) - 1);
+
+	for (std::uint32_t y = 0; y < info.height; ++y)
+	{
+		for (std::uint32_t x = 0; x < info.width; ++x)
+		{
+			for (std::uint32_t c = 0; c < info.channels; ++c)
+			{
+				std::uint32_t expected =
+				    image.colorType == 3
+				        ? trv::bench::corpus_palette_entry(trv::bench::corpus_sample(image, x, y,
+				                                                                     0))[c] *
+				              257u
+				        : trv::bench::corpus_sample(image, x, y, c) * scale;
+
+				if (output[(std::size_t { y } * info.width + x) * info.channels + c] != expected)
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+StageTimes measure(std::span<const unsigned char> file, const trv::DecodeOptions& options,
+                   double minTimeMs)
+{
+	using Clock = std::chrono::steady_clock;
+
+	StageTimes best;
+	double spent = 0;
+
+	trv::Chunks chunks;
+	std::vector<trv::ChunkType> sequence;
+	std::vector<unsigned char> decompressed;
+	std::vector<std::uint8_t> output;
+
+	while (best.iterations < 3 || (spent < minTimeMs * 1e6 && best.iterations < 1000))
+	{
+		auto start = Clock::now();
+		trv::read_chunks(file, chunks, sequence, options);
+		auto parsed = Clock::now();
+
+		trv::ImageInfo info   = trv::image_info(chunks, options);
+		std::size_t rowStride = trv::packed_row_stride(options, info.width, info.channels);
+		output.resize(
+		    trv::output_size(options, info.width, info.height, info.channels, rowStride));
+
+		auto inflateStart = Clock::now();
+		trv::decompress_image(chunks, options, decompressed);
+		auto inflated = Clock::now();
+
+		trv::decode_chunks<std::uint8_t>(chunks, decompressed, output, rowStride, options);
+		auto decoded = Clock::now();
+
+		best.parse   = std::min(best.parse, elapsed_ns(start, parsed));
+		best.inflate = std::min(best.inflate, elapsed_ns(inflateStart, inflated));
+		best.decode  = std::min(best.decode, elapsed_ns(inflated, decoded));
+		best.total   = std::min(best.total, elapsed_ns(start, parsed) +
+		                                        elapsed_ns(inflateStart, decoded));
+
+		spent += elapsed_ns(start, decoded);
+		++best.iterations;
+	}
+
+	return best;
+}
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		BenchArgs args = parse_args(argc, argv);
+		bool failed    = false;
+
+		std::cout << std::fixed << std::setprecision(3);
+
+		std::cout << "{\"bench\":\"pngreader\",\"hardware_threads\":"
+		          << std::thread::hardware_concurrency()
+		          << ",\"pool_threads\":" << trv::ThreadPool::instance().size()
+		          << ",\"max_size\":" << args.maxSize << ",\"min_time_ms\":" << args.minTimeMs
+		          << "}\n";
+
+		for (const auto& image : trv::bench::corpus_cases(args.maxSize))
+		{
+			std::string name = image.name();
+
+			if (name.find(args.match) == std::string::npos)
+			{
+				continue;
+			}
+
+			std::vector<unsigned char> file = trv::bench::encode_png(image);
+
+			if (!args.corpusDir.empty())
+			{
+				std::ofstream out(args.corpusDir + "/" + name + ".png", std::ios_base::binary);
+				out.write(reinterpret_cast<const char*>(file.data()),
+				          static_cast<std::streamsize>(file.size()));
+			}
+
+			bool verified = verify(image, file);
+			failed        = failed || !verified;
+
+			std::size_t rawBytes = trv::decompressed_size(
+			    trv::read_chunks(std::span<const unsigned char>(file)).header->data, {});
+			double pixels = static_cast<double>(image.width) * image.height;
+
+			for (const auto& policyName : args.policies)
+			{
+				trv::DecodeOptions options;
+				options.parallelism = policy_named(policyName);
+
+				StageTimes times = measure(file, options, args.minTimeMs);
+
+				std::cout << "{\"name\":\"" << name << "\",\"color_type\":"
+				          << int { image.colorType } << ",\"bit_depth\":" << int { image.bitDepth }
+				          << ",\"interlaced\":" << (image.interlaced ? "true" : "false")
+				          << ",\"filter\":" << static_cast<int>(image.filter)
+				          << ",\"block\":" << static_cast<int>(image.block)
+				          << ",\"width\":" << image.width << ",\"height\":" << image.height
+				          << ",\"policy\":\"" << policyName << "\",\"file_bytes\":" << file.size()
+				          << ",\"raw_bytes\":" << rawBytes << ",\"iterations\":" << times.iterations
+				          << ",\"parse_ns\":" << times.parse << ",\"inflate_ns\":" << times.inflate
+				          << ",\"unfilter_expand_ns\":" << times.decode
+				          << ",\"total_ns\":" << times.total
+				          << ",\"mb_per_s\":" << rawBytes / times.total * 1e3
+				          << ",\"pixels_per_s\":" << pixels / times.total * 1e9
+				          << ",\"verified\":" << (verified ? "true" : "false") << "}\n";
+			}
+		}
+
+		return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+	catch (const std::exception& error)
+	{
+		std::cerr << error.what() << "\n";
+		return EXIT_FAILURE;
+	}
+}
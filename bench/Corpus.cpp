@@ -0,0 +1,294 @@
+#include "Corpus.hpp"
+
+#include <array>
+#include <span>
+
+#include "Chunk.hpp"
+
+namespace trv::bench
+{
+// IDAT chunks are split at this size, as most encoders do
+static constexpr std::size_t idatSize = 1 << 16;
+
+struct Pass
+{
+	std::uint32_t xStart, yStart, xStep, yStep;
+};
+
+static constexpr std::array<Pass, 7> adam7 = { { { 0, 0, 8, 8 },
+	                                             { 4, 0, 8, 8 },
+	                                             { 0, 4, 4, 8 },
+	                                             { 2, 0, 4, 4 },
+	                                             { 0, 2, 2, 4 },
+	                                             { 1, 0, 2, 2 },
+	                                             { 0, 1, 1, 2 } } };
+
+std::string CorpusCase::name() const
+{
+	static constexpr const char* filters[] = { "none", "sub", "up", "average", "paeth" };
+	static constexpr const char* blocks[]  = { "stored", "fixed", "dynamic" };
+
+	return "ct" + std::to_string(colorType) + "_d" + std::to_string(bitDepth) +
+	       (interlaced ? "_adam7_" : "_") + filters[static_cast<std::size_t>(filter)] + "_" +
+	       blocks[static_cast<std::size_t>(block)] + "_" + std::to_string(width) + "x" +
+	       std::to_string(height);
+}
+
+std::size_t CorpusCase::channels() const
+{
+	switch (colorType)
+	{
+		case 2:
+			return 3;
+		case 4:
+			return 2;
+		case 6:
+			return 4;
+		default:
+			return 1;
+	}
+}
+
+std::vector<CorpusCase> corpus_cases(std::uint32_t maxSize)
+{
+	static constexpr std::array<std::pair<std::uint8_t, std::uint8_t>, 15> formats = {
+		{ { 0, 1 },
+		  { 0, 2 },
+		  { 0, 4 },
+		  { 0, 8 },
+		  { 0, 16 },
+		  { 2, 8 },
+		  { 2, 16 },
+		  { 3, 1 },
+		  { 3, 2 },
+		  { 3, 4 },
+		  { 3, 8 },
+		  { 4, 8 },
+		  { 4, 16 },
+		  { 6, 8 },
+		  { 6, 16 } }
+	};
+
+	std::vector<CorpusCase> cases;
+
+	for (std::uint32_t size = 16; size <= maxSize; size *= 4)
+	{
+		for (auto [colorType, bitDepth] : formats)
+		{
+			for (bool interlaced : { false, true })
+			{
+				cases.push_back({ size, size, colorType, bitDepth, interlaced, FilterMethod::Paeth,
+				                  BlockType::Dynamic });
+			}
+		}
+
+		for (std::uint8_t filter = 0; filter <= static_cast<std::uint8_t>(FilterMethod::Paeth);
+		     ++filter)
+		{
+			for (BlockType block : { BlockType::Stored, BlockType::Fixed, BlockType::Dynamic })
+			{
+				if (static_cast<FilterMethod>(filter) == FilterMethod::Paeth &&
+				    block == BlockType::Dynamic)
+				{
+					continue;
+				}
+
+				cases.push_back(
+				    { size, size, 6, 8, false, static_cast<FilterMethod>(filter), block });
+			}
+		}
+	}
+
+	return cases;
+}
+
+std::uint32_t corpus_sample(const CorpusCase& image, std::uint32_t x, std::uint32_t y,
+                            std::uint32_t c)
+{
+	// A diagonal gradient with a little noise, compressible like a photograph rather than a
+	// flat fill or random bytes
+	std::uint32_t noise = ((x + 1) * 2654435761u) ^ ((y + 1) * 40503u) ^ ((c + 1) * 2246822519u);
+	std::uint64_t ramp  = (std::uint64_t { x } + y + c * 17) << image.bitDepth;
+	std::uint32_t value = static_cast<std::uint32_t>(ramp / (image.width + image.height + 64)) +
+	                      (noise >> 30);
+
+	std::uint32_t mask = (1u << image.bitDepth) - 1;
+
+	if (image.colorType == 3)
+	{
+		return (value & mask) % std::min<std::uint32_t>(256, mask + 1);
+	}
+
+	return value & mask;
+}
+
+std::array<std::uint8_t, 3> corpus_palette_entry(std::uint32_t index)
+{
+	return { static_cast<uint8_t>(index * 67 + 11), static_cast<uint8_t>(index * 151 + 23),
+		     static_cast<uint8_t>(index * 199 + 37) };
+}
+
+static std::uint8_t paeth(int left, int up, int upLeft)
+{
+	int p      = left + up - upLeft;
+	int pLeft  = std::abs(p - left);
+	int pUp    = std::abs(p - up);
+	int pUpLeft = std::abs(p - upLeft);
+
+	if (pLeft <= pUp && pLeft <= pUpLeft)
+	{
+		return static_cast<std::uint8_t>(left);
+	}
+
+	return static_cast<std::uint8_t>(pUp <= pUpLeft ? up : upLeft);
+}
+
+// Appends the filtered scanlines of the pixels at (pass.xStart + i * xStep, pass.yStart +
+// j * yStep) to output.
+static void append_scanlines(const CorpusCase& image, const Pass& pass,
+                             std::vector<unsigned char>& output)
+{
+	if (pass.xStart >= image.width || pass.yStart >= image.height)
+	{
+		return;
+	}
+
+	std::uint32_t columns = (image.width - pass.xStart + pass.xStep - 1) / pass.xStep;
+	std::size_t channels  = image.channels();
+	std::size_t bits      = channels * image.bitDepth;
+	std::size_t rowBytes  = (columns * bits + 7) / 8;
+	std::size_t bpp       = std::max<std::size_t>(1, bits / 8);
+
+	std::vector<std::uint8_t> raw(rowBytes), prior(rowBytes, 0);
+
+	for (std::uint32_t y = pass.yStart; y < image.height; y += pass.yStep)
+	{
+		std::fill(raw.begin(), raw.end(), 0);
+
+		for (std::uint32_t column = 0; column < columns; ++column)
+		{
+			std::uint32_t x = pass.xStart + column * pass.xStep;
+
+			for (std::uint32_t c = 0; c < channels; ++c)
+			{
+				std::uint32_t value = corpus_sample(image, x, y, c);
+				std::size_t bit     = (column * channels + c) * image.bitDepth;
+
+				if (image.bitDepth == 16)
+				{
+					raw[bit / 8]     = static_cast<std::uint8_t>(value >> 8);
+					raw[bit / 8 + 1] = static_cast<std::uint8_t>(value);
+				}
+				else
+				{
+					raw[bit / 8] |= static_cast<std::uint8_t>(value
+					                                          << (8 - image.bitDepth - bit % 8));
+				}
+			}
+		}
+
+		output.push_back(static_cast<unsigned char>(image.filter));
+
+		for (size_t i = 0; i < rowBytes; ++i)
+		{
+			int left   = i >= bpp ? raw[i - bpp] : 0;
+			int up     = prior[i];
+			int upLeft = i >= bpp ? prior[i - bpp] : 0;
+			int predictor;
+
+			switch (image.filter)
+			{
+				case FilterMethod::Sub:
+					predictor = left;
+					break;
+				case FilterMethod::Up:
+					predictor = up;
+					break;
+				case FilterMethod::Average:
+					predictor = (left + up) / 2;
+					break;
+				case FilterMethod::Paeth:
+					predictor = paeth(left, up, upLeft);
+					break;
+				default:
+					predictor = 0;
+			}
+
+			output.push_back(static_cast<unsigned char>(raw[i] - predictor));
+		}
+
+		std::swap(raw, prior);
+	}
+}
+
+static void append_be32(std::vector<unsigned char>& output, std::uint32_t value)
+{
+	for (int shift = 24; shift >= 0; shift -= 8)
+	{
+		output.push_back(static_cast<unsigned char>(value >> shift));
+	}
+}
+
+static void append_chunk(std::vector<unsigned char>& output, const char* type,
+                         std::span<const unsigned char> data)
+{
+	append_be32(output, static_cast<std::uint32_t>(data.size()));
+
+	std::size_t typeStart = output.size();
+	output.insert(output.end(), type, type + 4);
+	output.insert(output.end(), data.begin(), data.end());
+
+	append_be32(output, CRC32Table.crc(output.data() + typeStart, data.size() + 4));
+}
+
+std::vector<unsigned char> encode_png(const CorpusCase& image)
+{
+	std::vector<unsigned char> scanlines;
+
+	if (image.interlaced)
+	{
+		for (const Pass& pass : adam7)
+		{
+			append_scanlines(image, pass, scanlines);
+		}
+	}
+	else
+	{
+		append_scanlines(image, { 0, 0, 1, 1 }, scanlines);
+	}
+
+	std::vector<unsigned char> file { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	std::vector<unsigned char> header;
+	append_be32(header, image.width);
+	append_be32(header, image.height);
+	header.insert(header.end(),
+	              { image.bitDepth, image.colorType, 0, 0, std::uint8_t { image.interlaced } });
+	append_chunk(file, "IHDR", header);
+
+	if (image.colorType == 3)
+	{
+		std::vector<unsigned char> palette;
+
+		for (std::uint32_t index = 0; index < std::min(256u, 1u << image.bitDepth); ++index)
+		{
+			auto entry = corpus_palette_entry(index);
+			palette.insert(palette.end(), entry.begin(), entry.end());
+		}
+
+		append_chunk(file, "PLTE", palette);
+	}
+
+	std::vector<unsigned char> compressed = zlib_compress(scanlines, image.block);
+
+	for (std::size_t pos = 0; pos < compressed.size(); pos += idatSize)
+	{
+		std::size_t size = std::min(idatSize, compressed.size() - pos);
+		append_chunk(file, "IDAT", std::span(compressed).subspan(pos, size));
+	}
+
+	append_chunk(file, "IEND", {});
+
+	return file;
+}
+}
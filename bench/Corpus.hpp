@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Common.hpp"
+#include "Deflate.hpp"
+
+namespace trv::bench
+{
+// One synthetic image of the corpus. Every sample is a function of its position, so the corpus is
+// identical on every machine and a decode can be checked without storing the expected output.
+struct CorpusCase
+{
+	std::uint32_t width, height;
+	std::uint8_t colorType, bitDepth;
+	bool interlaced;
+	// Filter of every scanline
+	FilterMethod filter;
+	BlockType block;
+
+	[[nodiscard]] std::string name() const;
+	[[nodiscard]] std::size_t channels() const;
+};
+
+// Every color type and bit depth in both interlace modes with Paeth rows and dynamic blocks, then
+// every filter and block type for 8-bit RGBA, each at square sizes from 16 up to maxSize.
+[[nodiscard]] std::vector<CorpusCase> corpus_cases(std::uint32_t maxSize);
+
+// Sample of channel c at (x, y) as stored in the file, a palette index for palette images.
+[[nodiscard]] std::uint32_t corpus_sample(const CorpusCase& image, std::uint32_t x,
+                                          std::uint32_t y, std::uint32_t c);
+
+// RGB of a palette entry.
+[[nodiscard]] std::array<std::uint8_t, 3> corpus_palette_entry(std::uint32_t index);
+
+// Complete PNG file of image.
+[[nodiscard]] std::vector<unsigned char> encode_png(const CorpusCase& image);
+}
@@ -0,0 +1,540 @@
+#include "Deflate.hpp"
+
+#include <algorithm>
+#include <array>
+#include <queue>
+
+#include "Zlib.hpp"
+
+namespace trv::bench
+{
+// Literal when distance is 0, otherwise a match
+struct Token
+{
+	std::uint16_t length;
+	std::uint16_t distance;
+	std::uint8_t literal;
+};
+
+// Most symbols in one fixed or dynamic block, longer streams are split into several blocks.
+static constexpr std::size_t blockTokens = 1 << 16;
+
+static constexpr std::size_t windowSize = 1 << 15;
+static constexpr std::size_t minMatch   = 3;
+static constexpr std::size_t maxMatch   = 258;
+static constexpr std::size_t maxChain   = 32;
+
+// Code length symbols in the order the dynamic block header stores their lengths
+static constexpr std::array<std::uint8_t, 19> codeLengthOrder = { 16, 17, 18, 0, 8,  7, 9,
+	                                                              6,  10, 5,  11, 4, 12, 3,
+	                                                              13, 2,  14, 1,  15 };
+
+class BitWriter
+{
+   public:
+	explicit BitWriter(std::vector<unsigned char>& output) : m_output(output) {}
+
+	// Writes the low count bits of value, least significant first.
+	void put(std::uint32_t value, std::size_t count)
+	{
+		m_bits |= static_cast<std::uint64_t>(value) << m_count;
+		m_count += count;
+
+		while (m_count >= 8)
+		{
+			m_output.push_back(static_cast<unsigned char>(m_bits));
+			m_bits >>= 8;
+			m_count -= 8;
+		}
+	}
+
+	// Huffman codes are stored most significant bit first.
+	void put_code(std::uint32_t code, std::size_t length)
+	{
+		std::uint32_t reversed = 0;
+
+		for (size_t bit = 0; bit < length; ++bit)
+		{
+			reversed |= ((code >> bit) & 1u) << (length - 1 - bit);
+		}
+
+		put(reversed, length);
+	}
+
+	void flush_byte()
+	{
+		if (m_count)
+		{
+			put(0, 8 - m_count);
+		}
+	}
+
+   private:
+	std::vector<unsigned char>& m_output;
+	std::uint64_t m_bits = 0;
+	std::size_t m_count  = 0;
+};
+
+// Huffman code of every symbol of an alphabet.
+struct Code
+{
+	std::vector<std::uint8_t> lengths;
+	std::vector<std::uint32_t> codes;
+};
+
+static std::size_t length_symbol(std::size_t length)
+{
+	std::size_t index = 0;
+
+	while (index + 1 < 29 && lengthExtraTable[(index + 1) * 2] <= length)
+	{
+		++index;
+	}
+
+	return index;
+}
+
+static std::size_t distance_symbol(std::size_t distance)
+{
+	std::size_t index = 0;
+
+	while (index + 1 < 30 && distanceExtraTable[(index + 1) * 2] <= distance)
+	{
+		++index;
+	}
+
+	return index;
+}
+
+// Canonical codes of lengths, as rebuilt by the decoder.
+static Code canonical_code(std::vector<std::uint8_t> lengths)
+{
+	std::array<std::uint32_t, 16> histogram {};
+	std::array<std::uint32_t, 16> next {};
+
+	for (std::uint8_t length : lengths)
+	{
+		++histogram[length];
+	}
+
+	histogram[0] = 0;
+
+	for (size_t bits = 1; bits < 16; ++bits)
+	{
+		next[bits] = (next[bits - 1] + histogram[bits - 1]) << 1;
+	}
+
+	Code code { std::move(lengths), {} };
+	code.codes.resize(code.lengths.size());
+
+	for (size_t symbol = 0; symbol < code.lengths.size(); ++symbol)
+	{
+		if (code.lengths[symbol])
+		{
+			code.codes[symbol] = next[code.lengths[symbol]]++;
+		}
+	}
+
+	return code;
+}
+
+// Huffman code lengths of no more than limit bits. Frequencies are halved until the tree is
+// shallow enough, which costs a little compression but never fails.
+static std::vector<std::uint8_t> code_lengths(std::vector<std::uint32_t> frequencies,
+                                              std::size_t limit)
+{
+	std::size_t symbols = frequencies.size();
+
+	while (true)
+	{
+		// Nodes past symbols are internal, parent of the root is itself
+		std::vector<std::size_t> parent(symbols * 2, 0);
+		std::priority_queue<std::pair<std::uint64_t, std::size_t>,
+		                    std::vector<std::pair<std::uint64_t, std::size_t>>, std::greater<>>
+		    queue;
+
+		for (size_t symbol = 0; symbol < symbols; ++symbol)
+		{
+			if (frequencies[symbol])
+			{
+				queue.emplace(frequencies[symbol], symbol);
+			}
+		}
+
+		std::vector<std::uint8_t> lengths(symbols, 0);
+
+		if (queue.size() == 1)
+		{
+			lengths[queue.top().second] = 1;
+			return lengths;
+		}
+
+		std::size_t next = symbols;
+
+		while (queue.size() > 1)
+		{
+			auto [firstWeight, first]   = queue.top();
+			queue.pop();
+			auto [secondWeight, second] = queue.top();
+			queue.pop();
+
+			parent[first] = parent[second] = next;
+			queue.emplace(firstWeight + secondWeight, next++);
+		}
+
+		std::size_t root = next - 1;
+		std::size_t deepest = 0;
+
+		for (size_t symbol = 0; symbol < symbols; ++symbol)
+		{
+			if (!frequencies[symbol])
+			{
+				continue;
+			}
+
+			std::size_t depth = 0;
+
+			for (std::size_t node = symbol; node != root; node = parent[node])
+			{
+				++depth;
+			}
+
+			lengths[symbol] = static_cast<std::uint8_t>(depth);
+			deepest         = std::max(deepest, depth);
+		}
+
+		if (deepest <= limit)
+		{
+			return lengths;
+		}
+
+		for (auto& frequency : frequencies)
+		{
+			frequency = frequency ? (frequency + 1) / 2 : 0;
+		}
+	}
+}
+
+// Greedy LZ77 over hash chains of three byte prefixes.
+static std::vector<Token> find_matches(std::span<const unsigned char> data)
+{
+	constexpr std::size_t hashSize = 1 << 15;
+	constexpr std::size_t none     = SIZE_MAX;
+
+	std::vector<std::size_t> head(hashSize, none);
+	std::vector<std::size_t> previous(windowSize, none);
+	std::vector<Token> tokens;
+
+	auto hash = [&](std::size_t pos)
+	{ return ((data[pos] << 10) ^ (data[pos + 1] << 5) ^ data[pos + 2]) & (hashSize - 1); };
+
+	auto insert = [&](std::size_t pos)
+	{
+		if (pos + minMatch <= data.size())
+		{
+			std::size_t key                 = hash(pos);
+			previous[pos & (windowSize - 1)] = head[key];
+			head[key]                        = pos;
+		}
+	};
+
+	for (std::size_t pos = 0; pos < data.size();)
+	{
+		std::size_t bestLength = 0, bestDistance = 0;
+
+		if (pos + minMatch <= data.size())
+		{
+			std::size_t candidate = head[hash(pos)];
+			std::size_t limit     = std::min(maxMatch, data.size() - pos);
+
+			for (size_t chain = 0; chain < maxChain && candidate != none &&
+			                       pos - candidate <= windowSize - 1;
+			     ++chain)
+			{
+				std::size_t length = 0;
+
+				while (length < limit && data[candidate + length] == data[pos + length])
+				{
+					++length;
+				}
+
+				if (length > bestLength)
+				{
+					bestLength   = length;
+					bestDistance = pos - candidate;
+				}
+
+				std::size_t earlier = previous[candidate & (windowSize - 1)];
+				candidate           = earlier < candidate ? earlier : none;
+			}
+		}
+
+		if (bestLength >= minMatch)
+		{
+			tokens.push_back({ static_cast<std::uint16_t>(bestLength),
+			                   static_cast<std::uint16_t>(bestDistance), 0 });
+
+			for (size_t step = 0; step < bestLength; ++step)
+			{
+				insert(pos + step);
+			}
+			pos += bestLength;
+		}
+		else
+		{
+			tokens.push_back({ 0, 0, data[pos] });
+			insert(pos);
+			++pos;
+		}
+	}
+
+	return tokens;
+}
+
+static Code fixed_lit_len_code()
+{
+	std::vector<std::uint8_t> lengths(288);
+
+	std::fill(lengths.begin(), lengths.begin() + 144, 8);
+	std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+	std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+	std::fill(lengths.begin() + 280, lengths.end(), 8);
+
+	return canonical_code(std::move(lengths));
+}
+
+static void write_tokens(BitWriter& writer, std::span<const Token> tokens, const Code& litLen,
+                         const Code& dist)
+{
+	for (const Token& token : tokens)
+	{
+		if (!token.distance)
+		{
+			writer.put_code(litLen.codes[token.literal], litLen.lengths[token.literal]);
+			continue;
+		}
+
+		std::size_t lengthIndex = length_symbol(token.length);
+		writer.put_code(litLen.codes[257 + lengthIndex], litLen.lengths[257 + lengthIndex]);
+		writer.put(token.length - lengthExtraTable[lengthIndex * 2],
+		           lengthExtraTable[lengthIndex * 2 + 1]);
+
+		std::size_t distIndex = distance_symbol(token.distance);
+		writer.put_code(dist.codes[distIndex], dist.lengths[distIndex]);
+		writer.put(token.distance - distanceExtraTable[distIndex * 2],
+		           distanceExtraTable[distIndex * 2 + 1]);
+	}
+
+	writer.put_code(litLen.codes[256], litLen.lengths[256]);
+}
+
+// Code length symbols of lengths, runs become repeat codes 16, 17 and 18. Pairs hold the symbol
+// and the value of its extra bits.
+static void run_length_encode(std::span<const std::uint8_t> lengths,
+                              std::vector<std::pair<std::uint8_t, std::uint8_t>>& symbols)
+{
+	for (std::size_t index = 0; index < lengths.size();)
+	{
+		std::uint8_t length = lengths[index];
+		std::size_t run     = 1;
+
+		while (index + run < lengths.size() && lengths[index + run] == length)
+		{
+			++run;
+		}
+
+		index += run;
+
+		if (!length)
+		{
+			while (run >= 11)
+			{
+				std::size_t count = std::min<std::size_t>(run, 138);
+				symbols.emplace_back(18, static_cast<std::uint8_t>(count - 11));
+				run -= count;
+			}
+
+			if (run >= 3)
+			{
+				symbols.emplace_back(17, static_cast<std::uint8_t>(run - 3));
+				run = 0;
+			}
+		}
+		else
+		{
+			symbols.emplace_back(length, 0);
+			--run;
+
+			while (run >= 3)
+			{
+				std::size_t count = std::min<std::size_t>(run, 6);
+				symbols.emplace_back(16, static_cast<std::uint8_t>(count - 3));
+				run -= count;
+			}
+		}
+
+		for (; run; --run)
+		{
+			symbols.emplace_back(length, 0);
+		}
+	}
+}
+
+static void write_dynamic_block(BitWriter& writer, std::span<const Token> tokens)
+{
+	std::vector<std::uint32_t> litLenFrequencies(286, 0);
+	std::vector<std::uint32_t> distFrequencies(30, 0);
+
+	for (const Token& token : tokens)
+	{
+		if (token.distance)
+		{
+			++litLenFrequencies[257 + length_symbol(token.length)];
+			++distFrequencies[distance_symbol(token.distance)];
+		}
+		else
+		{
+			++litLenFrequencies[token.literal];
+		}
+	}
+
+	++litLenFrequencies[256];
+	// Keeps the distance code a real tree even for blocks without matches
+	distFrequencies[0] = std::max<std::uint32_t>(distFrequencies[0], 1);
+	distFrequencies[1] = std::max<std::uint32_t>(distFrequencies[1], 1);
+
+	Code litLen = canonical_code(code_lengths(litLenFrequencies, 15));
+	Code dist   = canonical_code(code_lengths(distFrequencies, 15));
+
+	std::size_t hlit = 286;
+	while (hlit > 257 && !litLen.lengths[hlit - 1])
+	{
+		--hlit;
+	}
+
+	std::size_t hdist = 30;
+	while (hdist > 1 && !dist.lengths[hdist - 1])
+	{
+		--hdist;
+	}
+
+	std::vector<std::pair<std::uint8_t, std::uint8_t>> symbols;
+	run_length_encode(std::span(litLen.lengths).first(hlit), symbols);
+	run_length_encode(std::span(dist.lengths).first(hdist), symbols);
+
+	std::vector<std::uint32_t> lengthFrequencies(19, 0);
+
+	for (const auto& [symbol, extra] : symbols)
+	{
+		++lengthFrequencies[symbol];
+	}
+
+	Code lengthCode = canonical_code(code_lengths(lengthFrequencies, 7));
+
+	std::size_t hclen = 19;
+	while (hclen > 4 && !lengthCode.lengths[codeLengthOrder[hclen - 1]])
+	{
+		--hclen;
+	}
+
+	writer.put(static_cast<std::uint32_t>(hlit - 257), 5);
+	writer.put(static_cast<std::uint32_t>(hdist - 1), 5);
+	writer.put(static_cast<std::uint32_t>(hclen - 4), 4);
+
+	for (size_t index = 0; index < hclen; ++index)
+	{
+		writer.put(lengthCode.lengths[codeLengthOrder[index]], 3);
+	}
+
+	static constexpr std::array<std::uint8_t, 19> extraBits = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		                                                        0, 0, 0, 0, 0, 0, 2, 3, 7 };
+
+	for (const auto& [symbol, extra] : symbols)
+	{
+		writer.put_code(lengthCode.codes[symbol], lengthCode.lengths[symbol]);
+		writer.put(extra, extraBits[symbol]);
+	}
+
+	write_tokens(writer, tokens, litLen, dist);
+}
+
+static std::uint32_t adler32(std::span<const unsigned char> data)
+{
+	std::uint32_t a = 1, b = 0;
+
+	for (unsigned char byte : data)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+
+	return (b << 16) | a;
+}
+
+std::vector<unsigned char> zlib_compress(std::span<const unsigned char> data, BlockType type)
+{
+	std::vector<unsigned char> output { 0x78, 0x9C };
+	BitWriter writer(output);
+
+	if (type == BlockType::Stored)
+	{
+		std::size_t pos = 0;
+
+		do
+		{
+			std::size_t length = std::min<std::size_t>(data.size() - pos, 65535);
+			bool final         = pos + length == data.size();
+
+			writer.put(final, 1);
+			writer.put(static_cast<std::uint32_t>(BTYPES::None), 2);
+			writer.flush_byte();
+			writer.put(static_cast<std::uint32_t>(length), 16);
+			writer.put(static_cast<std::uint32_t>(~length & 0xFFFF), 16);
+
+			output.insert(output.end(), data.begin() + static_cast<std::ptrdiff_t>(pos),
+			              data.begin() + static_cast<std::ptrdiff_t>(pos + length));
+			pos += length;
+		} while (pos < data.size());
+	}
+	else
+	{
+		std::vector<Token> tokens = find_matches(data);
+		Code fixedLitLen          = fixed_lit_len_code();
+		Code fixedDist            = canonical_code(std::vector<std::uint8_t>(30, 5));
+		std::size_t pos           = 0;
+
+		do
+		{
+			std::size_t count = std::min(tokens.size() - pos, blockTokens);
+			bool final        = pos + count == tokens.size();
+			auto block        = std::span(tokens).subspan(pos, count);
+
+			writer.put(final, 1);
+
+			if (type == BlockType::Fixed)
+			{
+				writer.put(static_cast<std::uint32_t>(BTYPES::FixedHuff), 2);
+				write_tokens(writer, block, fixedLitLen, fixedDist);
+			}
+			else
+			{
+				writer.put(static_cast<std::uint32_t>(BTYPES::DynamicHuff), 2);
+				write_dynamic_block(writer, block);
+			}
+
+			pos += count;
+		} while (pos < tokens.size());
+
+		writer.flush_byte();
+	}
+
+	std::uint32_t checksum = adler32(data);
+
+	for (int shift = 24; shift >= 0; shift -= 8)
+	{
+		output.push_back(static_cast<unsigned char>(checksum >> shift));
+	}
+
+	return output;
+}
+}
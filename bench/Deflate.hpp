@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace trv::bench
+{
+// Deflate block type every block of a compressed stream uses.
+enum class BlockType : std::uint8_t
+{
+	Stored,
+	Fixed,
+	Dynamic
+};
+
+// Compresses data into a zlib stream of type blocks. Fixed and dynamic blocks come from a greedy
+// LZ77 match finder, good enough to give the decoder realistic match lengths and distances.
+[[nodiscard]] std::vector<unsigned char> zlib_compress(std::span<const unsigned char> data,
+                                                       BlockType type);
+}
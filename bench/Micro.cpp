@@ -0,0 +1,440 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Chunk.hpp"
+#include "Cpu.hpp"
+#include "Deflate.hpp"
+#include "Expand.hpp"
+#include "Filter.hpp"
+#include "Zlib.hpp"
+
+// Microbenchmarks of the decoder's kernels in isolation, each over a range of input sizes. Besides
+// the usual Google Benchmark output every kernel reports cycles_per_byte when the kernel lets
+// perf_event_open count CPU cycles. Kernels dispatched on the CPU take the CpuLevel as their last
+// argument and run at every level this machine supports. Compare builds with Google Benchmark's
+// compare.py.
+
+namespace
+{
+// CPU cycles this thread spends in user space, unavailable outside Linux or when perf events are
+// restricted.
+class CycleCounter
+{
+   public:
+	CycleCounter()
+	{
+#ifdef __linux__
+		perf_event_attr attr {};
+		attr.type           = PERF_TYPE_HARDWARE;
+		attr.size           = sizeof(attr);
+		attr.config         = PERF_COUNT_HW_CPU_CYCLES;
+		attr.disabled       = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv     = 1;
+
+		m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+
+		if (m_fd >= 0)
+		{
+			ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	~CycleCounter()
+	{
+#ifdef __linux__
+		if (m_fd >= 0)
+		{
+			close(m_fd);
+		}
+#endif
+	}
+
+	CycleCounter(const CycleCounter&)            = delete;
+	CycleCounter& operator=(const CycleCounter&) = delete;
+
+	[[nodiscard]] std::optional<std::uint64_t> stop()
+	{
+#ifdef __linux__
+		std::uint64_t count = 0;
+
+		if (m_fd >= 0 && ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0) == 0 &&
+		    read(m_fd, &count, sizeof(count)) == sizeof(count))
+		{
+			return count;
+		}
+#endif
+		return std::nullopt;
+	}
+
+   private:
+	int m_fd = -1;
+};
+
+// Runs kernel once per iteration, which processes bytes bytes.
+template <typename F>
+void run(benchmark::State& state, std::size_t bytes, F&& kernel)
+{
+	CycleCounter cycles;
+
+	for (auto _ : state)
+	{
+		kernel();
+	}
+
+	std::int64_t processed = state.iterations() * static_cast<std::int64_t>(bytes);
+
+	if (std::optional<std::uint64_t> count = cycles.stop(); count && processed)
+	{
+		state.counters["cycles_per_byte"] =
+		    static_cast<double>(*count) / static_cast<double>(processed);
+	}
+
+	state.SetBytesProcessed(processed);
+}
+
+std::vector<unsigned char> random_bytes(std::size_t size)
+{
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> byteDist(0, 255);
+	std::vector<unsigned char> bytes(size);
+
+	for (auto& byte : bytes)
+	{
+		byte = static_cast<unsigned char>(byteDist(rng));
+	}
+
+	return bytes;
+}
+
+void input_sizes(benchmark::internal::Benchmark* bench)
+{
+	for (std::int64_t size : { 4 << 10, 256 << 10, 16 << 20 })
+	{
+		bench->Arg(size);
+	}
+}
+
+std::vector<std::int64_t> cpu_levels()
+{
+	std::vector<std::int64_t> levels;
+
+	for (std::int64_t level = 0; level <= static_cast<std::int64_t>(trv::detected_cpu_level());
+	     ++level)
+	{
+		levels.push_back(level);
+	}
+
+	return levels;
+}
+
+// input_sizes at every CpuLevel.
+void level_sizes(benchmark::internal::Benchmark* bench)
+{
+	for (std::int64_t size : { 4 << 10, 256 << 10, 16 << 20 })
+	{
+		for (std::int64_t level : cpu_levels())
+		{
+			bench->Args({ size, level });
+		}
+	}
+}
+
+// Dispatches the kernels to the CpuLevel in argument arg while the benchmark runs, and labels the
+// benchmark with its name.
+class ScopedCpuLevel
+{
+   public:
+	ScopedCpuLevel(benchmark::State& state, int arg) : m_previous(trv::cpu_level())
+	{
+		trv::CpuLevel level = trv::set_cpu_level(static_cast<trv::CpuLevel>(state.range(arg)));
+		state.SetLabel(trv::cpu_level_name(level));
+	}
+
+	~ScopedCpuLevel() { trv::set_cpu_level(m_previous); }
+
+	ScopedCpuLevel(const ScopedCpuLevel&)            = delete;
+	ScopedCpuLevel& operator=(const ScopedCpuLevel&) = delete;
+
+   private:
+	trv::CpuLevel m_previous;
+};
+
+// Reads the whole input in fields of varying width, as an inflater reads codes and extra bits.
+template <std::endian Input, std::endian Output>
+void BM_ConsumeBits(benchmark::State& state)
+{
+	std::vector<unsigned char> input = random_bytes(static_cast<std::size_t>(state.range(0)));
+
+	run(state, input.size(),
+	    [&]()
+	    {
+		    trv::BitConsumer<Input> consumer(input);
+		    std::uint32_t sum = 0;
+
+		    for (std::size_t width = 1; consumer.bytes_consumed() + 8 < input.size();
+		         width = width % 16 + 1)
+		    {
+			    sum += consumer.template consume_bits<std::uint32_t, Output>(width);
+		    }
+
+		    benchmark::DoNotOptimize(sum);
+	    });
+}
+
+// Peeks a full code's worth of bits and discards fewer, as a table driven Huffman decode does.
+template <std::endian Input, std::endian Output>
+void BM_PeekBits(benchmark::State& state)
+{
+	std::vector<unsigned char> input = random_bytes(static_cast<std::size_t>(state.range(0)));
+
+	run(state, input.size(),
+	    [&]()
+	    {
+		    trv::BitConsumer<Input> consumer(input);
+		    std::uint32_t sum = 0;
+
+		    while (consumer.bytes_consumed() + 8 < input.size())
+		    {
+			    sum += consumer.template peek_bits<std::uint32_t, Output>(16);
+			    consumer.discard_bits(9);
+		    }
+
+		    benchmark::DoNotOptimize(sum);
+	    });
+}
+
+// Code lengths of the fixed literal/length code, complete so that any input decodes.
+std::vector<std::uint32_t> fixed_lengths(std::size_t symbols)
+{
+	std::vector<std::uint32_t> lengths(symbols);
+
+	for (size_t symbol = 0; symbol < symbols; ++symbol)
+	{
+		lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+	}
+
+	return lengths;
+}
+
+// Builds a decode table of as many symbols as the code length, distance and literal/length
+// alphabets, with the table width the inflater uses.
+void BM_HuffmanBuild(benchmark::State& state)
+{
+	std::vector<std::uint32_t> lengths = fixed_lengths(static_cast<std::size_t>(state.range(0)));
+	trv::Huffman<std::uint32_t> huffman;
+
+	run(state, lengths.size(),
+	    [&]()
+	    {
+		    huffman.build(16, static_cast<std::uint32_t>(lengths.size()), lengths.data());
+		    benchmark::ClobberMemory();
+	    });
+}
+
+void BM_HuffmanDecode(benchmark::State& state)
+{
+	std::vector<unsigned char> input   = random_bytes(static_cast<std::size_t>(state.range(0)));
+	std::vector<std::uint32_t> lengths = fixed_lengths(288);
+	trv::Huffman<std::uint32_t> huffman(16, 288, lengths.data());
+
+	run(state, input.size(),
+	    [&]()
+	    {
+		    trv::BitConsumer<std::endian::little> consumer(input);
+		    std::uint32_t sum = 0;
+
+		    while (consumer.bytes_consumed() + 8 < input.size())
+		    {
+			    sum += huffman.decode(consumer);
+		    }
+
+		    benchmark::DoNotOptimize(sum);
+	    });
+}
+
+// Inflates a stream of Type blocks holding range(0) bytes of rows with a little noise, so that
+// matches are common but not the whole stream.
+template <trv::bench::BlockType Type>
+void BM_Inflate(benchmark::State& state)
+{
+	ScopedCpuLevel level(state, 1);
+
+	std::vector<unsigned char> data = random_bytes(static_cast<std::size_t>(state.range(0)));
+
+	for (size_t byte = 0; byte < data.size(); ++byte)
+	{
+		data[byte] = static_cast<unsigned char>(byte % 251 + (data[byte] < 16 ? data[byte] : 0));
+	}
+
+	std::vector<unsigned char> input = trv::bench::zlib_compress(data, Type);
+	std::vector<unsigned char> output;
+	output.reserve(data.size());
+
+	run(state, data.size(),
+	    [&]()
+	    {
+		    output.clear();
+		    trv::DeflateArgs args { true, input, output };
+		    trv::decompress(args);
+		    benchmark::ClobberMemory();
+	    });
+}
+
+void BM_CRC(benchmark::State& state)
+{
+	ScopedCpuLevel level(state, 1);
+
+	std::vector<unsigned char> input = random_bytes(static_cast<std::size_t>(state.range(0)));
+
+	run(state, input.size(),
+	    [&]() { benchmark::DoNotOptimize(trv::CRC32Table.crc(input.data(), input.size())); });
+}
+
+void BM_Adler32(benchmark::State& state)
+{
+	ScopedCpuLevel level(state, 1);
+
+	std::vector<unsigned char> input = random_bytes(static_cast<std::size_t>(state.range(0)));
+
+	run(state, input.size(),
+	    [&]() { benchmark::DoNotOptimize(trv::adler32(1, input.data(), input.size())); });
+}
+
+// Unfilters rows of 1 KiB that all use Filter, with range(1) bytes per pixel.
+template <trv::FilterMethod Filter>
+void BM_Unfilter(benchmark::State& state)
+{
+	ScopedCpuLevel level(state, 2);
+
+	constexpr std::size_t byteWidth = 1025;
+
+	std::size_t bpp       = static_cast<std::size_t>(state.range(1));
+	std::size_t scanlines = std::max<std::size_t>(1, static_cast<std::size_t>(state.range(0)) /
+	                                                     byteWidth);
+	std::vector<unsigned char> rows = random_bytes(scanlines * byteWidth);
+
+	for (size_t row = 0; row < scanlines; ++row)
+	{
+		rows[row * byteWidth] = static_cast<unsigned char>(Filter);
+	}
+
+	// Unfiltering in place again each iteration costs the same, the filter bytes are kept
+	run(state, rows.size(),
+	    [&]()
+	    {
+		    trv::do_unfilter(rows, 0, scanlines, byteWidth, bpp);
+		    benchmark::ClobberMemory();
+	    });
+}
+
+void unfilter_sizes(benchmark::internal::Benchmark* bench)
+{
+	for (std::int64_t size : { 4 << 10, 256 << 10, 16 << 20 })
+	{
+		for (std::int64_t bpp : { 1, 2, 3, 4, 6, 8 })
+		{
+			for (std::int64_t level : cpu_levels())
+			{
+				bench->Args({ size, bpp, level });
+			}
+		}
+	}
+}
+
+// Rescales every sample of a buffer one at a time.
+template <std::uint8_t BitDepth, trv::SampleType T>
+void BM_ConvertBitDepth(benchmark::State& state)
+{
+	std::vector<unsigned char> bytes = random_bytes(static_cast<std::size_t>(state.range(0)));
+	std::vector<std::uint32_t> samples(bytes.size() * 8 / BitDepth);
+
+	for (size_t sample = 0; sample < samples.size(); ++sample)
+	{
+		samples[sample] = bytes[sample * BitDepth / 8] & ((1u << BitDepth) - 1u);
+	}
+
+	std::vector<T> output(samples.size());
+
+	run(state, bytes.size(),
+	    [&]()
+	    {
+		    for (size_t sample = 0; sample < samples.size(); ++sample)
+		    {
+			    output[sample] = trv::convertBitDepth<BitDepth, T>(samples[sample]);
+		    }
+		    benchmark::ClobberMemory();
+	    });
+}
+
+// Rescales a whole scanline of 8 or 16 bit samples through the row kernels.
+template <std::uint8_t BitDepth, trv::SampleType T>
+void BM_ConvertRow(benchmark::State& state)
+{
+	ScopedCpuLevel level(state, 1);
+
+	std::vector<unsigned char> input = random_bytes(static_cast<std::size_t>(state.range(0)));
+	std::vector<T> output(input.size() * 8 / BitDepth);
+
+	run(state, input.size(),
+	    [&]()
+	    {
+		    trv::convert_row<BitDepth, T>(input.data(), output.data(), output.size());
+		    benchmark::ClobberMemory();
+	    });
+}
+}
+
+BENCHMARK_TEMPLATE2(BM_ConsumeBits, std::endian::little, std::endian::little)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_ConsumeBits, std::endian::little, std::endian::big)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_ConsumeBits, std::endian::big, std::endian::little)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_ConsumeBits, std::endian::big, std::endian::big)->Apply(input_sizes);
+
+BENCHMARK_TEMPLATE2(BM_PeekBits, std::endian::little, std::endian::little)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_PeekBits, std::endian::little, std::endian::big)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_PeekBits, std::endian::big, std::endian::little)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_PeekBits, std::endian::big, std::endian::big)->Apply(input_sizes);
+
+BENCHMARK(BM_HuffmanBuild)->Arg(19)->Arg(30)->Arg(288);
+BENCHMARK(BM_HuffmanDecode)->Apply(input_sizes);
+
+BENCHMARK_TEMPLATE(BM_Inflate, trv::bench::BlockType::Fixed)->Apply(level_sizes);
+BENCHMARK_TEMPLATE(BM_Inflate, trv::bench::BlockType::Dynamic)->Apply(level_sizes);
+
+BENCHMARK(BM_CRC)->Apply(level_sizes);
+BENCHMARK(BM_Adler32)->Apply(level_sizes);
+
+BENCHMARK_TEMPLATE(BM_Unfilter, trv::FilterMethod::None)->Apply(unfilter_sizes);
+BENCHMARK_TEMPLATE(BM_Unfilter, trv::FilterMethod::Sub)->Apply(unfilter_sizes);
+BENCHMARK_TEMPLATE(BM_Unfilter, trv::FilterMethod::Up)->Apply(unfilter_sizes);
+BENCHMARK_TEMPLATE(BM_Unfilter, trv::FilterMethod::Average)->Apply(unfilter_sizes);
+BENCHMARK_TEMPLATE(BM_Unfilter, trv::FilterMethod::Paeth)->Apply(unfilter_sizes);
+
+BENCHMARK_TEMPLATE2(BM_ConvertBitDepth, 1, std::uint8_t)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_ConvertBitDepth, 2, std::uint8_t)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_ConvertBitDepth, 4, std::uint8_t)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_ConvertBitDepth, 8, std::uint16_t)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_ConvertBitDepth, 8, float)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_ConvertBitDepth, 16, std::uint8_t)->Apply(input_sizes);
+BENCHMARK_TEMPLATE2(BM_ConvertBitDepth, 16, float)->Apply(input_sizes);
+
+BENCHMARK_TEMPLATE2(BM_ConvertRow, 8, std::uint16_t)->Apply(level_sizes);
+BENCHMARK_TEMPLATE2(BM_ConvertRow, 8, float)->Apply(level_sizes);
+BENCHMARK_TEMPLATE2(BM_ConvertRow, 16, std::uint8_t)->Apply(level_sizes);
+BENCHMARK_TEMPLATE2(BM_ConvertRow, 16, std::uint16_t)->Apply(level_sizes);
+BENCHMARK_TEMPLATE2(BM_ConvertRow, 16, float)->Apply(level_sizes);
+
+BENCHMARK_MAIN();
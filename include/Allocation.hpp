@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "utility/export.hpp"
+
+namespace trv
+{
+// Memory resource that aligns every allocation to at least alignment bytes. Allocations of
+// hugePageThreshold bytes or more are aligned and padded to whole huge pages and advised to use
+// transparent huge pages where the platform supports it, 0 never does. Tracks the bytes it holds
+// upstream, so a decode's peak memory can be read from it.
+class DLL_PUBLIC AlignedResource : public std::pmr::memory_resource
+{
+   public:
+	static constexpr std::size_t hugePageSize = 2u << 20;
+
+	explicit AlignedResource(
+	    std::size_t alignment = 64, std::size_t hugePageThreshold = 0,
+	    std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+	// Bytes currently allocated upstream and the most allocated at once, padding included
+	[[nodiscard]] std::size_t allocated() const noexcept;
+	[[nodiscard]] std::size_t peak() const noexcept;
+
+	// Restarts the high-water mark from the bytes allocated now.
+	void reset_peak() noexcept;
+
+   private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+	// Size and alignment an allocation is forwarded upstream with.
+	[[nodiscard]] std::pair<std::size_t, std::size_t> upstream_layout(std::size_t bytes,
+	                                                                  std::size_t alignment) const;
+
+	std::size_t m_alignment;
+	std::size_t m_hugePageThreshold;
+	std::pmr::memory_resource* m_upstream;
+	std::atomic<std::size_t> m_allocated { 0 };
+	std::atomic<std::size_t> m_peak { 0 };
+};
+
+// Allocator that default-initializes the elements a container constructs without arguments, so
+// sizing a buffer of samples that decoding overwrites doesn't zero it first.
+template <typename T, typename Base = std::allocator<T>>
+class DefaultInitAllocator : public Base
+{
+   public:
+	template <typename U>
+	struct rebind
+	{
+		using other =
+		    DefaultInitAllocator<U, typename std::allocator_traits<Base>::template rebind_alloc<U>>;
+	};
+
+	using Base::Base;
+
+	DefaultInitAllocator() = default;
+
+	template <typename U, typename UBase>
+	DefaultInitAllocator(const DefaultInitAllocator<U, UBase>& other) noexcept :
+	    Base(static_cast<const UBase&>(other))
+	{
+	}
+
+	template <typename U>
+	void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>)
+	{
+		::new (static_cast<void*>(ptr)) U;
+	}
+
+	template <typename U, typename... Args>
+	void construct(U* ptr, Args&&... args)
+	{
+		std::allocator_traits<Base>::construct(static_cast<Base&>(*this), ptr,
+		                                       std::forward<Args>(args)...);
+	}
+};
+
+// Where load_image allocates its output and its decompressed scanlines. The resource has to
+// outlive every image allocated from it.
+struct AllocationPolicy
+{
+	std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+	// Output rows (and planes) start on multiples of this many bytes by padding the row stride,
+	// 0 packs rows. Pair it with a resource that aligns at least as much, such as AlignedResource
+	std::size_t rowAlignment = 0;
+};
+
+// Row stride in elements of elementSize bytes, padded so that every row of a buffer starts on a
+// multiple of rowAlignment bytes. rowAlignment must be a power of two that elementSize divides.
+[[nodiscard]] constexpr std::size_t aligned_row_stride(std::size_t elements,
+                                                       std::size_t elementSize,
+                                                       std::size_t rowAlignment)
+{
+	if (!rowAlignment)
+	{
+		return elements;
+	}
+
+	if ((rowAlignment & (rowAlignment - 1)) || rowAlignment % elementSize)
+	{
+		throw std::runtime_error(
+		    "TRV::ALLOCATION::ALIGNED_ROW_STRIDE - Row alignment must be a power of two and a "
+		    "multiple of the sample size.");
+	}
+
+	std::size_t bytes = (elements * elementSize + rowAlignment - 1) & ~(rowAlignment - 1);
+	return bytes / elementSize;
+}
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Image.hpp"
+
+namespace trv
+{
+// Runs the work it is given some time later, on any thread. An empty Executor stands for
+// ThreadPool::instance().
+typedef std::function<void(std::function<void()>)> Executor;
+
+// Calls work through executor, or runs it on the calling thread when the default pool has no
+// workers.
+DLL_PUBLIC void run_on(const Executor& executor, std::function<void()> work);
+
+// Lazily started coroutine producing an R. Awaiting it starts it and resumes the awaiting
+// coroutine on whichever thread it completes.
+template <typename R>
+class Task
+{
+   public:
+	struct promise_type
+	{
+		// Resumes the awaiting coroutine without growing the stack
+		struct FinalAwaiter
+		{
+			bool await_ready() noexcept { return false; }
+
+			std::coroutine_handle<> await_suspend(
+			    std::coroutine_handle<promise_type> handle) noexcept
+			{
+				std::coroutine_handle<> continuation = handle.promise().continuation;
+				return continuation ? continuation : std::noop_coroutine();
+			}
+
+			void await_resume() noexcept {}
+		};
+
+		Task get_return_object()
+		{
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		FinalAwaiter final_suspend() noexcept { return {}; }
+
+		void return_value(R result) { value.emplace(std::move(result)); }
+		void unhandled_exception() { error = std::current_exception(); }
+
+		std::optional<R> value;
+		std::exception_ptr error;
+		std::coroutine_handle<> continuation;
+	};
+
+	Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+	Task& operator=(Task&& other) noexcept
+	{
+		std::swap(m_handle, other.m_handle);
+		return *this;
+	}
+
+	Task(const Task&)            = delete;
+	Task& operator=(const Task&) = delete;
+
+	~Task()
+	{
+		if (m_handle)
+		{
+			m_handle.destroy();
+		}
+	}
+
+	bool await_ready() const noexcept { return false; }
+
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+	{
+		if (!m_handle)
+		{
+			throw std::runtime_error("TRV::ASYNC::TASK - Awaited a task that was moved from.");
+		}
+
+		m_handle.promise().continuation = awaiting;
+		return m_handle;
+	}
+
+	R await_resume()
+	{
+		if (m_handle.promise().error)
+		{
+			std::rethrow_exception(m_handle.promise().error);
+		}
+
+		return std::move(*m_handle.promise().value);
+	}
+
+   private:
+	explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+// Awaiting it moves the coroutine onto executor.
+struct ScheduleOn
+{
+	const Executor& executor;
+
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) const
+	{
+		run_on(executor, [handle]() { handle.resume(); });
+	}
+	void await_resume() const noexcept {}
+};
+
+// Coroutine that starts immediately and frees itself when it returns.
+struct DetachedTask
+{
+	struct promise_type
+	{
+		DetachedTask get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
+
+// Reads a PNG file on the thread awaiting the task, then decodes it on executor. Blocking reads of
+// slow files never hold the pool's workers, which unfiltering relies on. The awaiting coroutine
+// resumes on the thread that finished the decode. Arguments are copied since the task starts once
+// it is awaited.
+template <SampleType T>
+[[nodiscard]] Task<Image<T>> load_image_async(std::string path, DecodeOptions options = {},
+                                              Executor executor = {})
+{
+	std::vector<unsigned char> file = read_file(path);
+
+	co_await ScheduleOn { executor };
+	co_return load_image<T>(std::span<const unsigned char>(file), options);
+}
+
+// Same as load_image_async for callers without coroutines. The file is read before returning,
+// its decode starts right away on executor.
+template <SampleType T>
+[[nodiscard]] std::future<Image<T>> load_image_future(std::string path,
+                                                      DecodeOptions options = {},
+                                                      const Executor& executor = {})
+{
+	auto promise                 = std::make_shared<std::promise<Image<T>>>();
+	std::future<Image<T>> future = promise->get_future();
+	std::vector<unsigned char> file;
+
+	try
+	{
+		file = read_file(path);
+	}
+	catch (...)
+	{
+		promise->set_exception(std::current_exception());
+		return future;
+	}
+
+	run_on(executor,
+	       [promise, file = std::move(file), options]()
+	       {
+		       try
+		       {
+			       promise->set_value(load_image<T>(std::span<const unsigned char>(file), options));
+		       }
+		       catch (...)
+		       {
+			       promise->set_exception(std::current_exception());
+		       }
+	       });
+
+	return future;
+}
+
+// Blocks the calling thread until task completes and returns its result.
+template <typename R>
+R sync_wait(Task<R> task)
+{
+	std::mutex mutex;
+	std::condition_variable finished;
+	bool done = false;
+	std::optional<R> value;
+	std::exception_ptr error;
+
+	[](Task<R>& task, std::optional<R>& value, std::exception_ptr& error, std::mutex& mutex,
+	   std::condition_variable& finished, bool& done) -> DetachedTask
+	{
+		try
+		{
+			value.emplace(co_await task);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		// Notified under the lock, the waiter can't return and destroy it any earlier
+		std::lock_guard lock(mutex);
+		done = true;
+		finished.notify_one();
+	}(task, value, error, mutex, finished, done);
+
+	std::unique_lock lock(mutex);
+	finished.wait(lock, [&]() { return done; });
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+
+	return std::move(*value);
+}
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <exception>
+#include <expected>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "Image.hpp"
+
+namespace trv
+{
+// Encoded PNG of a batch, either a path to read or a file already in memory that outlives the
+// batch.
+typedef std::variant<std::string, std::span<const unsigned char>> ImageSource;
+
+// Shape of the load_images pipeline. Files are read on the calling thread and readThreads - 1
+// more, each image read is then parsed with its CRC checks, inflated and decoded as a task on the
+// pool of DecodeOptions::parallelism. Reading waits while maxInFlight images are read but not yet
+// delivered, which bounds the memory in flight.
+struct BatchOptions
+{
+	// 0 allows two images per thread of the pool
+	std::size_t maxInFlight = 0;
+	std::size_t readThreads = 1;
+};
+
+// One image on its way through the pipeline, every stage releases what later ones don't need.
+struct BatchItem
+{
+	std::size_t index = 0;
+	// Contents of a source read from disk
+	std::vector<unsigned char> file;
+	Chunks chunks;
+	std::vector<unsigned char> decompressed;
+	// Set by the stage that failed, the stages after it pass the item on untouched
+	std::exception_ptr error;
+};
+
+// Reads, parses and inflates sources in a pipeline and calls finish for every item on a pool
+// thread, in the order they complete. Memory budgets are checked against output samples of
+// sampleSize bytes. The first exception thrown by finish stops the batch, no stage is started for
+// an image after it, and it is rethrown once the images in flight are done. Reading waits on the
+// pool, so this must not run as a task of that pool.
+DLL_PUBLIC void run_batch(std::span<const ImageSource> sources, const DecodeOptions& options,
+                          const BatchOptions& batch, std::size_t sampleSize,
+                          const std::function<void(BatchItem&)>& finish);
+
+// Decoded image of a batch, or the exception that decoding it threw.
+template <SampleType T>
+using BatchResult = std::expected<Image<T>, std::exception_ptr>;
+
+// Decodes every source and calls callback(index, BatchResult<T>) as each image completes. A
+// failing image doesn't stop the others. Calls to callback are serialized but come from the
+// pool's threads. The first exception callback throws cancels the batch and is rethrown,
+// callback isn't called again after it. DecodeOptions::memoryUsage and stats are ignored,
+// unknownChunk is called from the parse threads.
+template <SampleType T, typename Callback>
+void load_images(std::span<const ImageSource> sources, Callback&& callback,
+                 const DecodeOptions& options = {}, const BatchOptions& batch = {})
+{
+	std::mutex callbackMutex;
+	// Set under callbackMutex before unwinding releases the lock, so an image another decode
+	// thread finished meanwhile isn't delivered
+	bool callbackThrew = false;
+
+	DecodeOptions shared = options;
+	shared.memoryUsage   = nullptr;
+	shared.stats         = nullptr;
+
+	run_batch(sources, shared, batch, sizeof(T),
+	          [&](BatchItem& item)
+	          {
+		          BatchResult<T> result = std::unexpected(item.error);
+
+		          if (!item.error)
+		          {
+			          try
+			          {
+				          ImageInfo info = image_info(item.chunks, shared);
+				          std::size_t rowStride =
+				              packed_row_stride(shared, info.width, info.channels);
+				          Image<T> image({}, info.width, info.height, info.channels, rowStride);
+
+				          size_output(image.data, info, rowStride, shared);
+				          decode_chunks<T>(item.chunks, item.decompressed, image.data, rowStride,
+				                           shared);
+
+				          result = std::move(image);
+			          }
+			          catch (...)
+			          {
+				          result = std::unexpected(std::current_exception());
+			          }
+		          }
+
+		          item.decompressed = {};
+
+		          std::lock_guard lock(callbackMutex);
+
+		          if (callbackThrew)
+		          {
+			          return;
+		          }
+
+		          try
+		          {
+			          callback(item.index, std::move(result));
+		          }
+		          catch (...)
+		          {
+			          callbackThrew = true;
+			          throw;
+		          }
+	          });
+}
+
+template <SampleType T, typename Callback>
+void load_images(std::span<const std::string> paths, Callback&& callback,
+                 const DecodeOptions& options = {}, const BatchOptions& batch = {})
+{
+	std::vector<ImageSource> sources(paths.begin(), paths.end());
+	load_images<T>(std::span<const ImageSource>(sources), std::forward<Callback>(callback),
+	               options, batch);
+}
+
+template <SampleType T, typename Callback>
+void load_images(std::span<const std::span<const unsigned char>> buffers, Callback&& callback,
+                 const DecodeOptions& options = {}, const BatchOptions& batch = {})
+{
+	std::vector<ImageSource> sources(buffers.begin(), buffers.end());
+	load_images<T>(std::span<const ImageSource>(sources), std::forward<Callback>(callback),
+	               options, batch);
+}
+}
@@ -4,9 +4,15 @@
 #include <concepts>
 
 #include "Common.hpp"
+#include "utility/export.hpp"
 
 namespace trv
 {
+// Advances the CRC-32 register crc (the running CRC inverted) over len bytes of buf with the
+// kernel of the current CpuLevel.
+[[nodiscard]] DLL_PUBLIC std::uint32_t crc32_update(std::uint32_t crc, const void* buf,
+                                                    std::size_t len);
+
 struct CRCTable
 {
    public:
@@ -33,15 +39,15 @@ struct CRCTable
 
 	[[nodiscard]] std::uint32_t crc(const void* buf, std::size_t len) const
 	{
-		return update_crc(0xFFFFFFFFUL, buf, len) ^ 0xFFFFFFFFUL;
+		return crc32_update(0xFFFFFFFFUL, buf, len) ^ 0xFFFFFFFFUL;
 	}
 
 	[[nodiscard]] std::uint32_t crc(uint32_t crc, const void* buf, std::size_t len) const
 	{
-		return update_crc(crc ^ 0xFFFFFFFFUL, buf, len) ^ 0xFFFFFFFFUL;
+		return crc32_update(crc ^ 0xFFFFFFFFUL, buf, len) ^ 0xFFFFFFFFUL;
 	}
 
-   private:
+	// Byte at a time update of a CRC register, the scalar kernel of crc32_update
 	[[nodiscard]] std::uint32_t update_crc(uint32_t crc, const void* buf, std::size_t len) const
 	{
 		std::uint32_t c = crc;
@@ -55,6 +61,7 @@ struct CRCTable
 		return c;
 	}
 
+   private:
 	std::array<uint32_t, 256> lookupTable;
 };
 }
@@ -7,6 +7,8 @@
 #include <type_traits>
 
 #include "CRC.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
 
 namespace trv
 {
@@ -16,6 +18,7 @@ enum class ChunkType : std::size_t
 {
 	IHDR,
 	PLTE,
+	tRNS,
 	IDAT,
 	IEND,
 	Count,
@@ -26,7 +29,7 @@ enum class ChunkType : std::size_t
 template <typename T>
 concept IsChunk = requires(T x)
 {
-	requires std::is_constructible_v < T, std::basic_ifstream<char>
+	requires std::is_constructible_v < T, std::istream
 	&, std::uint32_t > ;
 };
 
@@ -34,10 +37,12 @@ concept IsChunk = requires(T x)
 template <IsChunk T>
 struct Chunk
 {
-	Chunk(std::basic_ifstream<char>& input, std::uint32_t size, std::uint32_t type) :
+	// Time spent checking the CRC is added to crcNanos when set
+	Chunk(std::istream& input, std::uint32_t size, std::uint32_t type,
+	      std::uint64_t* crcNanos = nullptr) :
 	    size(size), type(type), data(input, size), crc(extract_from_ifstream<uint32_t>(input))
 	{
-		std::uint32_t computed_crc = data.getCRC();
+		std::uint32_t computed_crc = checked_crc(crcNanos);
 		if (computed_crc != crc)
 		{
 			std::stringstream msg;
@@ -48,11 +53,11 @@ struct Chunk
 		}
 	};
 
-	void append(std::basic_ifstream<char>& input, std::uint32_t chunkSize)
+	void append(std::istream& input, std::uint32_t chunkSize, std::uint64_t* crcNanos = nullptr)
 	{
 		data.append(input, chunkSize);
 		std::uint32_t file_crc     = extract_from_ifstream<uint32_t>(input);
-		std::uint32_t computed_crc = data.getCRC();
+		std::uint32_t computed_crc = checked_crc(crcNanos);
 
 		if (computed_crc != file_crc)
 		{
@@ -70,6 +75,14 @@ struct Chunk
 	std::uint32_t type;
 	T data;
 	std::uint32_t crc;
+
+   private:
+	std::uint32_t checked_crc(std::uint64_t* crcNanos)
+	{
+		StageTimer timer(crcNanos);
+		TraceScope trace("crc");
+		return data.getCRC();
+	}
 };
 
 struct IHDR
@@ -79,7 +92,7 @@ struct IHDR
 	constexpr static char typeStr[] = { 'I', 'H', 'D', 'R' };
 
 	IHDR() = default;
-	IHDR(std::basic_ifstream<char>& input, std::uint32_t)
+	IHDR(std::istream& input, std::uint32_t)
 	{
 		width             = extract_from_ifstream<uint32_t>(input);
 		height            = extract_from_ifstream<uint32_t>(input);
@@ -124,6 +137,7 @@ struct IHDR
 		switch (colorType)
 		{
 			case 0:
+				break;
 			case 2:
 				if (bitDepth < 8)
 				{
@@ -190,7 +204,7 @@ struct PLTE
 	constexpr static char typeStr[] = { 'P', 'L', 'T', 'E' };
 
 	PLTE() = default;
-	PLTE(std::basic_ifstream<char>& input, std::uint32_t size) : data(size)
+	PLTE(std::istream& input, std::uint32_t size) : data(size)
 	{
 		input.read(reinterpret_cast<char*>(data.data()), size);
 
@@ -216,32 +230,92 @@ struct PLTE
 	std::vector<unsigned char> data;
 };
 
+struct TRNS
+{
+   public:
+	constexpr static ChunkType type = ChunkType::tRNS;
+	constexpr static char typeStr[] = { 't', 'R', 'N', 'S' };
+
+	TRNS() = default;
+	TRNS(std::istream& input, std::uint32_t size) : data(size)
+	{
+		input.read(reinterpret_cast<char*>(data.data()), size);
+
+		lastCRC = CRC32Table.crc(typeStr, sizeof(typeStr));
+		lastCRC = CRC32Table.crc(lastCRC, data.data(), size);
+	};
+
+	[[nodiscard]] std::uint32_t getCRC() { return lastCRC; }
+
+	// Layout of tRNS depends on the color type, so it can only be checked once IHDR is known.
+	void verify(const IHDR& header, const PLTE* palette) const
+	{
+		switch (header.colorType)
+		{
+			case 0:
+				if (data.size() != 2)
+				{
+					throw std::runtime_error(
+					    "TRV::CHUNK::TRNS Grayscale transparency must be 2 bytes.");
+				}
+				break;
+			case 2:
+				if (data.size() != 6)
+				{
+					throw std::runtime_error(
+					    "TRV::CHUNK::TRNS Color transparency must be 6 bytes.");
+				}
+				break;
+			case 3:
+				if (!palette || data.size() > palette->data.size() / 3)
+				{
+					throw std::runtime_error(
+					    "TRV::CHUNK::TRNS More transparency entries than palette entries.");
+				}
+				break;
+			default:
+				throw std::runtime_error(
+				    "TRV::CHUNK::TRNS Transparency is not allowed for color types with alpha.");
+		}
+	}
+
+	// Color key sample for channel, only meaningful for color types 0 and 2.
+	[[nodiscard]] std::uint16_t key(std::size_t channel) const
+	{
+		return static_cast<uint16_t>(data[channel * 2] << 8 | data[channel * 2 + 1]);
+	}
+
+	std::uint32_t lastCRC;
+	std::vector<unsigned char> data;
+};
+
 struct IDAT
 {
 	constexpr static ChunkType type = ChunkType::IDAT;
 	constexpr static char typeStr[] = { 'I', 'D', 'A', 'T' };
 
 	IDAT() = default;
-	IDAT(std::basic_ifstream<char>& input, std::uint32_t size) : lastCRC(), data(size)
+	IDAT(std::istream& input, std::uint32_t size) : data(size)
 	{
 		input.read(reinterpret_cast<char*>(data.data()), size);
-
-		lastCRC = CRC32Table.crc(typeStr, sizeof(typeStr));
-		lastCRC = CRC32Table.crc(lastCRC, data.data(), size);
 	};
 
-	void append(std::basic_ifstream<char>& input, std::uint32_t size)
+	void append(std::istream& input, std::uint32_t size)
 	{
+		lastChunk = data.size();
 		data.resize(data.size() + size);
-		input.read(reinterpret_cast<char*>(data.data() + data.size() - size), size);
-
-		lastCRC = CRC32Table.crc(typeStr, sizeof(typeStr));
-		lastCRC = CRC32Table.crc(lastCRC, data.data() + data.size() - size, size);
+		input.read(reinterpret_cast<char*>(data.data() + lastChunk), size);
 	}
 
-	[[nodiscard]] std::uint32_t getCRC() { return lastCRC; }
+	// CRC of the chunk read last, computed here rather than while reading so it can be timed
+	[[nodiscard]] std::uint32_t getCRC()
+	{
+		std::uint32_t crc = CRC32Table.crc(typeStr, sizeof(typeStr));
+		return CRC32Table.crc(crc, data.data() + lastChunk, data.size() - lastChunk);
+	}
 
-	std::uint32_t lastCRC;
+	// Offset of the chunk read last in data
+	std::size_t lastChunk = 0;
 	std::vector<unsigned char> data;
 };
 
@@ -250,7 +324,7 @@ struct IEND
 	constexpr static ChunkType type = ChunkType::IEND;
 	constexpr static char typeStr[] = { 'I', 'E', 'N', 'D' };
 	IEND()                          = default;
-	IEND(std::basic_ifstream<char>&, std::uint32_t) {};
+	IEND(std::istream&, std::uint32_t) {};
 
 	[[nodiscard]] constexpr std::uint32_t getCRC() const { return 0xAE426082; }
 };
@@ -261,6 +335,7 @@ struct Chunks
 	Chunks() {};
 	std::unique_ptr<Chunk<IHDR>> header;
 	std::unique_ptr<Chunk<PLTE>> palette;
+	std::unique_ptr<Chunk<TRNS>> transparency;
 	std::unique_ptr<Chunk<IDAT>> image_data;
 	std::unique_ptr<Chunk<IEND>> end;
 };
@@ -33,6 +33,11 @@ enum class ColorType : std::uint8_t
 	Alpha   = 0b100
 };
 
+// Types samples can be decoded to, integers span their full range and floating point samples
+// are normalized to [0, 1].
+template <typename T>
+concept SampleType = std::integral<T> || std::floating_point<T>;
+
 [[nodiscard]] inline std::uint8_t reverse_byte(uint8_t val)
 {
 	return static_cast<uint8_t>(((val * 0x80200802ULL) & 0x0884422110ULL) * 0x0101010101ULL >> 32);
@@ -60,7 +65,7 @@ template <>
 
 // Allows reading of integral types from big-endian binary stream
 template <std::integral T>
-[[nodiscard]] T extract_from_ifstream(std::basic_ifstream<char>& input)
+[[nodiscard]] T extract_from_ifstream(std::istream& input)
 {
 	char bytes[sizeof(T)];
 	input.read(bytes, sizeof(T));
@@ -193,10 +198,23 @@ class BitConsumer
 		m_bitsConsumed = (m_bitsConsumed + bits) % 8;
 	};
 
+	// Skips to the next byte boundary, if not already on one.
 	void flush_byte()
 	{
-		m_bytesConsumed++;
-		m_bitsConsumed = 0;
+		if (m_bitsConsumed)
+		{
+			m_bytesConsumed++;
+			m_bitsConsumed = 0;
+		}
+	}
+
+	[[nodiscard]] std::size_t bytes_consumed() const { return m_bytesConsumed; }
+
+	// Called after the owner of the input erased its first bytes.
+	void drop_bytes(std::size_t bytes)
+	{
+		assert(bytes <= m_bytesConsumed);
+		m_bytesConsumed -= bytes;
 	}
 
 	template <typename T, std::endian outputBitType>
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "utility/export.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TRV_PNG_X86
+#endif
+
+// Compiles a single function for a wider instruction set than the rest of the library, MSVC
+// accepts intrinsics anywhere.
+#if defined(TRV_PNG_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TRV_PNG_TARGET(isa) __attribute__((target(isa)))
+#else
+#define TRV_PNG_TARGET(isa)
+#endif
+
+// Copies a shared body into each target variant of a kernel, so every copy is compiled for the
+// instruction set of its caller.
+#if defined(__GNUC__) || defined(__clang__)
+#define TRV_PNG_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define TRV_PNG_INLINE __forceinline
+#else
+#define TRV_PNG_INLINE inline
+#endif
+
+namespace trv
+{
+// Instruction sets the kernels are built for, each level includes those before it. SSE4 is
+// SSSE3, SSE4.1 and PCLMULQDQ, AVX2 adds BMI1, BMI2 and LZCNT, AVX512 adds AVX-512 F, BW and VL.
+enum class CpuLevel : std::uint8_t
+{
+	Scalar,
+	SSE2,
+	SSE4,
+	AVX2,
+	AVX512
+};
+
+inline constexpr std::size_t cpuLevels = 5;
+
+// Highest level this machine and its OS support.
+[[nodiscard]] DLL_PUBLIC CpuLevel detected_cpu_level();
+
+// Level the kernels run at. Chosen once at load time from the detected level, lowered when the
+// TRV_CPU_LEVEL environment variable names a lower one, see parse_cpu_level.
+[[nodiscard]] DLL_PUBLIC CpuLevel cpu_level();
+
+// Switches every kernel to level, clamped to the detected level, and returns the level used.
+// Decodes already running may finish on either.
+DLL_PUBLIC CpuLevel set_cpu_level(CpuLevel level);
+
+// scalar, sse2, sse4, avx2 or avx512.
+[[nodiscard]] DLL_PUBLIC const char* cpu_level_name(CpuLevel level);
+
+[[nodiscard]] DLL_PUBLIC std::optional<CpuLevel> parse_cpu_level(std::string_view name);
+
+// Implementation of a kernel for each CpuLevel, a level without a variant of its own repeats the
+// one below it.
+template <typename F>
+using KernelTable = std::array<F*, cpuLevels>;
+
+template <typename F>
+[[nodiscard]] F* select_kernel(const KernelTable<F>& table)
+{
+	return table[static_cast<std::size_t>(cpu_level())];
+}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Image.hpp"
+
+namespace trv
+{
+// Decodes one image after another while reusing its buffers. The image data, the decompressed
+// scanlines and the Huffman tables only ever grow, so a steady stream of similar images stops
+// allocating. Not thread safe, keep one per thread.
+class DLL_PUBLIC Decoder
+{
+   public:
+	Decoder() = default;
+
+	// Policy of every call whose DecodeOptions::parallelism is unset.
+	explicit Decoder(const ParallelismPolicy& parallelism) : m_parallelism(parallelism) {}
+
+	Decoder(const Decoder&)            = delete;
+	Decoder& operator=(const Decoder&) = delete;
+
+	// Same as trv::load_image, only the returned image is allocated.
+	template <SampleType T>
+	[[nodiscard]] Image<T> load_image(const std::string& path,
+	                                  const DecodeOptions& callOptions = {})
+	{
+		Image<T> image({}, 0, 0, 0);
+		load_image(path, image, callOptions);
+		return image;
+	}
+
+	// Decodes into image, reusing the storage of its data. A warm Decoder given an image at least
+	// as large as the last doesn't allocate, and no sample is filled before decoding writes it.
+	template <SampleType T, typename Allocator>
+	void load_image(const std::string& path, Image<T, Allocator>& image,
+	                const DecodeOptions& callOptions = {})
+	{
+		DecodeOptions options = resolve(callOptions);
+		ImageInfo info        = read(path, options);
+
+		std::size_t rowStride = packed_row_stride(options, info.width, info.channels);
+		std::size_t outputSize =
+		    output_size(options, info.width, info.height, info.channels, rowStride);
+
+		check_plane_pitch(info, rowStride, options);
+		reserve_memory(m_chunks, options, outputSize * sizeof(T));
+		inflate(options);
+
+		size_output(image.data, info, rowStride, options);
+		decode_chunks<T>(m_chunks, m_decompressed, std::span<T>(image.data), rowStride, options);
+		report_memory(m_chunks, options, m_decompressed.capacity(),
+		              image.data.capacity() * sizeof(T));
+
+		image.width     = info.width;
+		image.height    = info.height;
+		image.channels  = info.channels;
+		image.rowStride = rowStride;
+	}
+
+	// Same as trv::decode_into, a warm Decoder doesn't allocate.
+	template <SampleType T>
+	ImageInfo decode_into(const std::string& path, std::span<T> dst, std::size_t rowStride,
+	                      const DecodeOptions& callOptions = {})
+	{
+		DecodeOptions options = resolve(callOptions);
+		ImageInfo info        = read(path, options);
+
+		check_destination(info, dst.size(), rowStride, options);
+		reserve_memory(m_chunks, options, 0);
+
+		inflate(options);
+
+		decode_chunks<T>(m_chunks, m_decompressed, dst, rowStride, options);
+		report_memory(m_chunks, options, m_decompressed.capacity(), 0);
+
+		return info;
+	}
+
+   private:
+	[[nodiscard]] DecodeOptions resolve(const DecodeOptions& options) const;
+	ImageInfo read(const std::string& path, const DecodeOptions& options);
+	void inflate(const DecodeOptions& options);
+
+	Chunks m_chunks;
+	std::vector<ChunkType> m_sequence;
+	std::vector<unsigned char> m_decompressed;
+	InflateTables m_tables;
+	ParallelismPolicy m_parallelism;
+};
+}
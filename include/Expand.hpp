@@ -0,0 +1,708 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "Chunk.hpp"
+#include "Common.hpp"
+#include "Options.hpp"
+
+namespace trv
+{
+// Sample value of full intensity, the value opaque alpha is written as.
+template <SampleType T>
+[[nodiscard]] constexpr T sample_max()
+{
+	if constexpr (std::floating_point<T>)
+	{
+		return T { 1 };
+	}
+	else
+	{
+		return std::numeric_limits<T>::max();
+	}
+}
+
+// Rescales a sample of InputBitDepth bits to the full range of T using integer math only. Results
+// are exactly round(val * max(T) / (2^InputBitDepth - 1)), ties cannot occur as the divisor is odd.
+// Upscales to unsigned types are a multiply by a constant (bit replication), 16 to 8 bits uses
+// a multiply-shift and everything else splits the ratio into quotient and remainder so that no
+// intermediate overflows 64 bits. Floating point outputs are normalized to [0, 1].
+template <std::uint8_t InputBitDepth, SampleType T>
+[[nodiscard]] constexpr T convertBitDepth(std::uint32_t val)
+{
+	static_assert(InputBitDepth >= 1 && InputBitDepth <= 16);
+
+	constexpr std::uint64_t inputMax = (1ull << InputBitDepth) - 1ull;
+
+	assert(val <= inputMax);
+
+	if constexpr (std::floating_point<T>)
+	{
+		return static_cast<T>(val) / static_cast<T>(inputMax);
+	}
+	else
+	{
+		constexpr std::uint64_t outputMax = std::numeric_limits<T>::max();
+
+		if constexpr (outputMax % inputMax == 0)
+		{
+			return static_cast<T>(val * (outputMax / inputMax));
+		}
+		else if constexpr (InputBitDepth == 16 && outputMax == 255)
+		{
+			return static_cast<T>((val * 255u + 32895u) >> 16);
+		}
+		else
+		{
+			constexpr std::uint64_t quotient  = outputMax / inputMax;
+			constexpr std::uint64_t remainder = outputMax % inputMax;
+
+			return static_cast<T>(val * quotient + (val * remainder + inputMax / 2) / inputMax);
+		}
+	}
+}
+
+// Widens 8 bit samples to 16 bits by byte replication (val * 257).
+void widen_8_to_16(const std::uint8_t* src, std::uint16_t* dst, std::size_t samples);
+
+// Converts big-endian 16 bit samples to native 16 bit samples.
+void byteswap_16(const std::uint8_t* src, std::uint16_t* dst, std::size_t samples);
+
+// Narrows big-endian 16 bit samples to 8 bits, rounding like convertBitDepth<16, uint8_t>.
+void narrow_16_to_8(const std::uint8_t* src, std::uint8_t* dst, std::size_t samples);
+
+// Lookup table expanding one packed byte of a 1, 2 or 4 bit scanline into its 8 / BitDepth samples,
+// most significant bits first. Scaled entries are converted to T, unscaled entries are raw palette
+// indices.
+template <SampleType T, std::uint8_t BitDepth, bool Scaled>
+struct SubByteTable
+{
+	static_assert(BitDepth == 1 || BitDepth == 2 || BitDepth == 4);
+
+	static constexpr std::size_t samplesPerByte = 8 / BitDepth;
+	static constexpr std::uint8_t sampleMask    = (1u << BitDepth) - 1u;
+
+	constexpr SubByteTable() : entries()
+	{
+		for (std::size_t byte = 0; byte < 256; ++byte)
+		{
+			for (std::size_t sample = 0; sample < samplesPerByte; ++sample)
+			{
+				std::uint8_t val =
+				    static_cast<uint8_t>(byte >> (8 - BitDepth * (sample + 1))) & sampleMask;
+
+				if constexpr (Scaled)
+				{
+					entries[byte][sample] = convertBitDepth<BitDepth, T>(val);
+				}
+				else
+				{
+					entries[byte][sample] = static_cast<T>(val);
+				}
+			}
+		}
+	}
+
+	std::array<std::array<T, samplesPerByte>, 256> entries;
+};
+
+template <SampleType T, std::uint8_t BitDepth, bool Scaled>
+inline constexpr SubByteTable<T, BitDepth, Scaled> subByteTable {};
+
+// Unpacks the gray samples of a 1, 2 or 4 bit scanline, one table store per input byte.
+template <SampleType T, std::uint8_t BitDepth>
+void unpack_sub_byte_row(const std::uint8_t* src, T* dst, std::size_t samples)
+{
+	constexpr auto& table        = subByteTable<T, BitDepth, true>;
+	constexpr std::size_t stride = table.samplesPerByte;
+
+	std::size_t wholeBytes = samples / stride;
+
+	for (size_t byte = 0; byte < wholeBytes; ++byte)
+	{
+		std::memcpy(dst + byte * stride, table.entries[src[byte]].data(), stride * sizeof(T));
+	}
+
+	if (std::size_t remainder = samples % stride)
+	{
+		std::memcpy(dst + wholeBytes * stride, table.entries[src[wholeBytes]].data(),
+		            remainder * sizeof(T));
+	}
+}
+
+// Converts a scanline of 8 or 16 bit samples to T, the common pairs go through the
+// vectorized kernels. Samples are converted independently so gray, gray alpha, RGB and RGBA rows
+// share the same kernels.
+template <std::uint8_t BitDepth, SampleType T>
+void convert_row(const std::uint8_t* src, T* dst, std::size_t samples)
+{
+	if constexpr (BitDepth == 8 && std::is_same_v<T, uint8_t>)
+	{
+		std::memcpy(dst, src, samples);
+	}
+	else if constexpr (BitDepth == 8 && std::is_same_v<T, uint16_t>)
+	{
+		widen_8_to_16(src, dst, samples);
+	}
+	else if constexpr (BitDepth == 8)
+	{
+		for (size_t sample = 0; sample < samples; ++sample)
+		{
+			dst[sample] = convertBitDepth<8, T>(src[sample]);
+		}
+	}
+	else if constexpr (BitDepth == 16 && std::is_same_v<T, uint8_t>)
+	{
+		narrow_16_to_8(src, dst, samples);
+	}
+	else if constexpr (BitDepth == 16 && std::is_same_v<T, uint16_t>)
+	{
+		byteswap_16(src, dst, samples);
+	}
+	else
+	{
+		for (size_t sample = 0; sample < samples; ++sample)
+		{
+			std::uint32_t val = static_cast<uint32_t>(src[sample * 2] << 8 | src[sample * 2 + 1]);
+			dst[sample]       = convertBitDepth<16, T>(val);
+		}
+	}
+}
+
+// Samples per output pixel, palette images expand to RGB and tRNS adds an alpha channel.
+[[nodiscard]] inline std::size_t output_channels(const IHDR& header, bool hasTransparency,
+                                                 PixelFormat format = PixelFormat::Native)
+{
+	bool usesPalette     = header.colorType & static_cast<uint8_t>(ColorType::Palette);
+	std::size_t channels = ((header.colorType & static_cast<uint8_t>(ColorType::Color)) + 1) +
+	                       ((header.colorType & static_cast<uint8_t>(ColorType::Alpha)) >> 2);
+	channels             = usesPalette ? 3 : channels;
+
+	return format_channels(format, channels + (hasTransparency ? 1 : 0));
+}
+
+// BT.601 luma with 8 bit fixed point weights. The high and low bytes of each sample are weighted
+// separately, which is exact and can't overflow T.
+template <SampleType T>
+[[nodiscard]] constexpr T luminance(T red, T green, T blue)
+{
+	if constexpr (std::floating_point<T>)
+	{
+		return (red * T { 77 } + green * T { 150 } + blue * T { 29 }) / T { 256 };
+	}
+	else
+	{
+		using U = std::make_unsigned_t<T>;
+
+		U r = static_cast<U>(red), g = static_cast<U>(green), b = static_cast<U>(blue);
+
+		U high            = static_cast<U>((r >> 8) * 77u + (g >> 8) * 150u + (b >> 8) * 29u);
+		std::uint32_t low = static_cast<uint32_t>((r & 0xFFu) * 77u + (g & 0xFFu) * 150u);
+		low += static_cast<uint32_t>((b & 0xFFu) * 29u) + 128u;
+
+		return static_cast<T>(high + static_cast<U>(low >> 8));
+	}
+}
+
+// Scales color by alpha / max(T), rounding to nearest. 64 bit outputs go through long double.
+template <SampleType T>
+[[nodiscard]] constexpr T premultiply(T color, T alpha)
+{
+	constexpr auto outputMax = sample_max<T>();
+
+	if constexpr (std::floating_point<T>)
+	{
+		return color * alpha / outputMax;
+	}
+	else if constexpr (sizeof(T) <= 4)
+	{
+		std::uint64_t scaled = static_cast<uint64_t>(color) * static_cast<uint64_t>(alpha);
+		return static_cast<T>((scaled + outputMax / 2) / static_cast<uint64_t>(outputMax));
+	}
+	else
+	{
+		long double scaled = static_cast<long double>(color) * static_cast<long double>(alpha) /
+		                     static_cast<long double>(outputMax);
+		return static_cast<T>(scaled + 0.5L);
+	}
+}
+
+// Converts one pixel of Channels samples (gray, gray alpha, RGB or RGBA) to Format.
+template <PixelFormat Format, std::size_t Channels, SampleType T>
+constexpr void format_pixel(const T* in, T* out)
+{
+	static_assert(Channels >= 1 && Channels <= 4);
+
+	constexpr bool isGray   = Channels <= 2;
+	constexpr bool hasAlpha = Channels == 2 || Channels == 4;
+
+	T red   = in[0];
+	T green = isGray ? in[0] : in[1];
+	T blue  = isGray ? in[0] : in[2];
+	T alpha = hasAlpha ? in[Channels - 1] : sample_max<T>();
+
+	if constexpr (Format == PixelFormat::Native)
+	{
+		for (size_t channel = 0; channel < Channels; ++channel)
+		{
+			out[channel] = in[channel];
+		}
+	}
+	else if constexpr (Format == PixelFormat::Gray || Format == PixelFormat::GrayAlpha)
+	{
+		out[0] = isGray ? red : luminance(red, green, blue);
+
+		if constexpr (Format == PixelFormat::GrayAlpha)
+		{
+			out[1] = alpha;
+		}
+	}
+	else if constexpr (Format == PixelFormat::BGRA)
+	{
+		out[0] = blue;
+		out[1] = green;
+		out[2] = red;
+		out[3] = alpha;
+	}
+	else if constexpr (Format == PixelFormat::PremultipliedRGBA)
+	{
+		out[0] = premultiply(red, alpha);
+		out[1] = premultiply(green, alpha);
+		out[2] = premultiply(blue, alpha);
+		out[3] = alpha;
+	}
+	else
+	{
+		out[0] = red;
+		out[1] = green;
+		out[2] = blue;
+
+		if constexpr (Format == PixelFormat::RGBA)
+		{
+			out[3] = alpha;
+		}
+	}
+}
+
+// Runtime dispatch of format_pixel, used where a pixel is formatted once rather than per row.
+template <std::size_t Channels, SampleType T>
+constexpr void format_pixel(PixelFormat format, const T* in, T* out)
+{
+	switch (format)
+	{
+		case PixelFormat::Native:
+			return format_pixel<PixelFormat::Native, Channels>(in, out);
+		case PixelFormat::Gray:
+			return format_pixel<PixelFormat::Gray, Channels>(in, out);
+		case PixelFormat::GrayAlpha:
+			return format_pixel<PixelFormat::GrayAlpha, Channels>(in, out);
+		case PixelFormat::RGB:
+			return format_pixel<PixelFormat::RGB, Channels>(in, out);
+		case PixelFormat::RGBA:
+			return format_pixel<PixelFormat::RGBA, Channels>(in, out);
+		case PixelFormat::BGRA:
+			return format_pixel<PixelFormat::BGRA, Channels>(in, out);
+		case PixelFormat::PremultipliedRGBA:
+			return format_pixel<PixelFormat::PremultipliedRGBA, Channels>(in, out);
+	}
+}
+
+// Output pixels indexed by raw sample value, used for palette images and for gray images of 8
+// bits or less that need a tRNS color key or a format conversion. Entries are padded to four
+// samples so that every pixel is written with a single fixed size store, unused entries are zero.
+template <SampleType T>
+struct PaletteTable
+{
+	static constexpr std::size_t stride = 4;
+
+	PaletteTable() : entries() {};
+
+	// RGB or RGBA entries from PLTE, entries past the end of tRNS are opaque.
+	PaletteTable(const PLTE& palette, const TRNS* transparency) : entries()
+	{
+		std::size_t count = std::min<std::size_t>(palette.data.size() / 3, 256);
+
+		for (size_t index = 0; index < count; ++index)
+		{
+			for (size_t channel = 0; channel < 3; ++channel)
+			{
+				entries[index * stride + channel] =
+				    convertBitDepth<8, T>(palette.data[index * 3 + channel]);
+			}
+
+			if (transparency)
+			{
+				std::uint8_t alpha =
+				    index < transparency->data.size() ? transparency->data[index] : 255;
+				entries[index * stride + 3] = convertBitDepth<8, T>(alpha);
+			}
+		}
+	}
+
+	// Gray entries for every value of a bitDepth bit sample, with alpha when a key is given.
+	template <std::uint8_t BitDepth>
+	static PaletteTable gray(const std::uint16_t* key)
+	{
+		PaletteTable table;
+
+		for (std::uint32_t val = 0; val < (1u << BitDepth); ++val)
+		{
+			table.entries[val * stride] = convertBitDepth<BitDepth, T>(val);
+
+			if (key)
+			{
+				table.entries[val * stride + 1] =
+				    val == *key ? T {} : sample_max<T>();
+			}
+		}
+
+		return table;
+	}
+
+	// Rewrites every entry of channels samples in format.
+	void reformat(PixelFormat format, std::size_t channels)
+	{
+		for (size_t index = 0; index < 256; ++index)
+		{
+			std::array<T, stride> entry {};
+			T* in = entries.data() + index * stride;
+
+			switch (channels)
+			{
+				case 1:
+					format_pixel<1>(format, in, entry.data());
+					break;
+				case 2:
+					format_pixel<2>(format, in, entry.data());
+					break;
+				case 3:
+					format_pixel<3>(format, in, entry.data());
+					break;
+				default:
+					format_pixel<4>(format, in, entry.data());
+					break;
+			}
+
+			std::copy(entry.begin(), entry.end(), in);
+		}
+	}
+
+	std::array<T, 256 * stride> entries;
+};
+
+// Converts unfiltered scanlines (without their filter type byte) into output pixels. Built once
+// per image; tRNS and the requested PixelFormat are applied in the same write. Palette images and
+// low bit depth gray go through a precomputed PaletteTable, 8 and 16 bit samples through a kernel
+// specialized for bit depth, channel count and format.
+template <SampleType T>
+class RowExpander
+{
+   public:
+	RowExpander(const IHDR& header, const PLTE* palette, const TRNS* transparency = nullptr,
+	            PixelFormat format = PixelFormat::Native) :
+	    m_bitDepth(header.bitDepth),
+	    m_fileChannels(((header.colorType & static_cast<uint8_t>(ColorType::Color)) + 1) +
+	                   ((header.colorType & static_cast<uint8_t>(ColorType::Alpha)) >> 2)),
+	    m_channels(output_channels(header, transparency, format))
+	{
+		bool usesPalette           = header.colorType & static_cast<uint8_t>(ColorType::Palette);
+		std::size_t nativeChannels = output_channels(header, transparency);
+
+		// A format matching the file's own layout needs no conversion
+		constexpr PixelFormat sameLayout[5] { PixelFormat::Native, PixelFormat::Gray,
+			                                  PixelFormat::GrayAlpha, PixelFormat::RGB,
+			                                  PixelFormat::RGBA };
+		if (format == sameLayout[nativeChannels])
+		{
+			format = PixelFormat::Native;
+		}
+
+		if (transparency && !usesPalette)
+		{
+			for (size_t channel = 0; channel < m_fileChannels; ++channel)
+			{
+				m_key[channel] = transparency->key(channel);
+			}
+		}
+
+		const std::uint16_t* key = transparency ? m_key.data() : nullptr;
+
+		if (usesPalette)
+		{
+			if (!palette)
+			{
+				throw std::runtime_error(
+				    "TRV::EXPAND::ROW_EXPANDER - Palette image is missing its PLTE chunk.");
+			}
+
+			m_path         = Path::Indexed;
+			m_fileChannels = 1;
+			m_table        = PaletteTable<T>(*palette, transparency);
+		}
+		else if (m_fileChannels == 1 && m_bitDepth <= 8 &&
+		         (transparency || format != PixelFormat::Native))
+		{
+			// Key bits above the bit depth can never match a sample
+			m_path = Path::Indexed;
+
+			switch (m_bitDepth)
+			{
+				case 1:
+					m_table = PaletteTable<T>::template gray<1>(key);
+					break;
+				case 2:
+					m_table = PaletteTable<T>::template gray<2>(key);
+					break;
+				case 4:
+					m_table = PaletteTable<T>::template gray<4>(key);
+					break;
+				case 8:
+					m_table = PaletteTable<T>::template gray<8>(key);
+					break;
+			}
+		}
+		else if (m_bitDepth >= 8)
+		{
+			m_path = Path::Kernel;
+
+			bool keyed = transparency != nullptr;
+
+			switch (m_fileChannels)
+			{
+				case 1:
+					m_kernel =
+					    keyed ? select_kernel<1, true>(format) : select_kernel<1, false>(format);
+					break;
+				case 2:
+					m_kernel = select_kernel<2, false>(format);
+					break;
+				case 3:
+					m_kernel =
+					    keyed ? select_kernel<3, true>(format) : select_kernel<3, false>(format);
+					break;
+				default:
+					m_kernel = select_kernel<4, false>(format);
+					break;
+			}
+		}
+
+		if (m_path == Path::Indexed && format != PixelFormat::Native)
+		{
+			m_table.reformat(format, nativeChannels);
+		}
+	}
+
+	// Samples written per pixel.
+	[[nodiscard]] std::size_t channels() const { return m_channels; }
+
+	void expand(const std::uint8_t* src, T* dst, std::size_t width) const
+	{
+		if (m_path == Path::Kernel)
+		{
+			(this->*m_kernel)(src, dst, width);
+			return;
+		}
+
+		if (m_path == Path::Indexed)
+		{
+			switch (m_bitDepth)
+			{
+				case 1:
+					expand_indexed_row<1>(src, dst, width);
+					return;
+				case 2:
+					expand_indexed_row<2>(src, dst, width);
+					return;
+				case 4:
+					expand_indexed_row<4>(src, dst, width);
+					return;
+				case 8:
+					expand_indexed_row<8>(src, dst, width);
+					return;
+			}
+		}
+
+		switch (m_bitDepth)
+		{
+			case 1:
+				unpack_sub_byte_row<T, 1>(src, dst, width);
+				break;
+			case 2:
+				unpack_sub_byte_row<T, 2>(src, dst, width);
+				break;
+			case 4:
+				unpack_sub_byte_row<T, 4>(src, dst, width);
+				break;
+			default:
+				throw std::runtime_error(
+				    "TRV::EXPAND::EXPAND_ROW - Encountered unexpected bit depth.");
+		}
+	}
+
+   private:
+	typedef void (RowExpander::*Kernel)(const std::uint8_t*, T*, std::size_t) const;
+
+	enum class Path : std::uint8_t
+	{
+		Samples,
+		Indexed,
+		Kernel
+	};
+
+	template <std::size_t Channels, bool Keyed>
+	[[nodiscard]] Kernel select_kernel(PixelFormat format) const
+	{
+		if (m_bitDepth == 8)
+		{
+			return kernel_for_format<8, Channels, Keyed>(format);
+		}
+		else
+		{
+			return kernel_for_format<16, Channels, Keyed>(format);
+		}
+	}
+
+	template <std::uint8_t BitDepth, std::size_t Channels, bool Keyed>
+	[[nodiscard]] static Kernel kernel_for_format(PixelFormat format)
+	{
+		switch (format)
+		{
+			case PixelFormat::Gray:
+				return &RowExpander::kernel_row<BitDepth, Channels, Keyed, PixelFormat::Gray>;
+			case PixelFormat::GrayAlpha:
+				return &RowExpander::kernel_row<BitDepth, Channels, Keyed, PixelFormat::GrayAlpha>;
+			case PixelFormat::RGB:
+				return &RowExpander::kernel_row<BitDepth, Channels, Keyed, PixelFormat::RGB>;
+			case PixelFormat::RGBA:
+				return &RowExpander::kernel_row<BitDepth, Channels, Keyed, PixelFormat::RGBA>;
+			case PixelFormat::BGRA:
+				return &RowExpander::kernel_row<BitDepth, Channels, Keyed, PixelFormat::BGRA>;
+			case PixelFormat::PremultipliedRGBA:
+				return &RowExpander::kernel_row<BitDepth, Channels, Keyed,
+				                                PixelFormat::PremultipliedRGBA>;
+			default:
+				return &RowExpander::kernel_row<BitDepth, Channels, Keyed, PixelFormat::Native>;
+		}
+	}
+
+	// Writes one table entry per pixel. Every pixel with room for a whole padded entry before the
+	// end of the row stores all of it, to be partially overwritten by its successor, and only the
+	// last few pixels store their exact width.
+	template <std::uint8_t BitDepth>
+	void expand_indexed_row(const std::uint8_t* src, T* dst, std::size_t pixels) const
+	{
+		constexpr std::size_t stride = PaletteTable<T>::stride;
+		const T* entries             = m_table.entries.data();
+		std::size_t channels         = m_channels;
+		std::size_t padded           = pixels - std::min(pixels, (stride - 1) / channels);
+
+		auto storePadded = [&](std::uint8_t index)
+		{
+			std::memcpy(dst, entries + index * stride, stride * sizeof(T));
+			dst += channels;
+		};
+
+		auto storeExact = [&](std::uint8_t index)
+		{
+			std::memcpy(dst, entries + index * stride, channels * sizeof(T));
+			dst += channels;
+		};
+
+		if constexpr (BitDepth == 8)
+		{
+			for (size_t pixel = 0; pixel < padded; ++pixel)
+			{
+				storePadded(src[pixel]);
+			}
+
+			for (size_t pixel = padded; pixel < pixels; ++pixel)
+			{
+				storeExact(src[pixel]);
+			}
+		}
+		else
+		{
+			constexpr auto& table         = subByteTable<uint8_t, BitDepth, false>;
+			constexpr std::size_t perByte = table.samplesPerByte;
+			std::size_t paddedBytes       = padded / perByte;
+
+			for (size_t byte = 0; byte < paddedBytes; ++byte)
+			{
+				const auto& indices = table.entries[src[byte]];
+
+				for (size_t sample = 0; sample < perByte; ++sample)
+				{
+					storePadded(indices[sample]);
+				}
+			}
+
+			for (size_t pixel = paddedBytes * perByte; pixel < pixels; ++pixel)
+			{
+				storeExact(table.entries[src[pixel / perByte]][pixel % perByte]);
+			}
+		}
+	}
+
+	// Converts 8 or 16 bit pixels, appends alpha from the color key when Keyed (zero where all
+	// samples match) and writes them in Format.
+	template <std::uint8_t BitDepth, std::size_t Channels, bool Keyed, PixelFormat Format>
+	void kernel_row(const std::uint8_t* src, T* dst, std::size_t pixels) const
+	{
+		if constexpr (Format == PixelFormat::Native && !Keyed)
+		{
+			convert_row<BitDepth, T>(src, dst, pixels * Channels);
+		}
+		else
+		{
+			constexpr std::size_t bytesPerSample = BitDepth / 8;
+			constexpr std::size_t inChannels     = Channels + (Keyed ? 1 : 0);
+			constexpr std::size_t outChannels    = format_channels(Format, inChannels);
+
+			for (size_t pixel = 0; pixel < pixels; ++pixel)
+			{
+				std::array<T, 4> samples {};
+				bool matches = true;
+
+				for (size_t channel = 0; channel < Channels; ++channel)
+				{
+					std::uint32_t val = src[0];
+
+					if constexpr (BitDepth == 16)
+					{
+						val = static_cast<uint32_t>(src[0] << 8 | src[1]);
+					}
+
+					if constexpr (Keyed)
+					{
+						matches &= val == m_key[channel];
+					}
+
+					samples[channel] = convertBitDepth<BitDepth, T>(val);
+					src += bytesPerSample;
+				}
+
+				if constexpr (Keyed)
+				{
+					samples[Channels] = matches ? T {} : sample_max<T>();
+				}
+
+				format_pixel<Format, inChannels>(samples.data(), dst);
+				dst += outChannels;
+			}
+		}
+	}
+
+	std::uint8_t m_bitDepth;
+	std::size_t m_fileChannels;
+	std::size_t m_channels;
+	Path m_path     = Path::Samples;
+	Kernel m_kernel = nullptr;
+	std::array<std::uint16_t, 3> m_key {};
+	PaletteTable<T> m_table;
+};
+}
@@ -1,63 +1,375 @@
 #pragma once
 
+#include <array>
+#include <cstring>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <type_traits>
 #include <thread>
 #include <vector>
 
 #include "Chunk.hpp"
 #include "Common.hpp"
-#include "WorkerPool.hpp"
+#include "Cpu.hpp"
+#include "Expand.hpp"
+#include "Options.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
 
 namespace trv
 {
+// Position of one Adam7 pass within the image and within the decompressed data.
+struct Adam7Pass
+{
+	std::size_t rowStart, colStart, rowStride, colStride;
+	std::size_t width, height;
+	// Bytes per scanline including the filter type byte, 0 when the pass is empty
+	std::size_t byteWidth;
+	// Start of the pass' first scanline in the decompressed data
+	std::size_t offset;
+
+	// Scanlines of the pass that lie above image row row.
+	[[nodiscard]] std::size_t rows_before(std::size_t row) const
+	{
+		return std::min(height, (row + rowStride - 1 - rowStart) / rowStride);
+	}
+
+	// Pixels of a pass scanline that lie left of image column col.
+	[[nodiscard]] std::size_t cols_before(std::size_t col) const
+	{
+		return std::min(width, (col + colStride - 1 - colStart) / colStride);
+	}
+};
+
+// Geometry of the seven passes of an interlaced image, computed once per image.
+[[nodiscard]] std::array<Adam7Pass, 7> adam7_passes(std::size_t width, std::size_t height,
+                                                    std::size_t bitsPerPixel);
+
+// Number of Adam7 passes that options needs decoded, previews and reduced scales stop early.
+// Throws for a preview pass count or scale that isn't supported.
+[[nodiscard]] std::size_t adam7_passes_needed(const DecodeOptions& options);
+
+// Part of the image options decodes, before scaling. Throws for a region outside of the image or
+// one combined with a preview or reduced scale.
+[[nodiscard]] Region decode_region(const IHDR& header, const DecodeOptions& options);
+
 template <typename T>
 struct FilterArgs
 {
 	typedef std::vector<unsigned char> Bytes;
 	typedef std::vector<T> Outputs;
-	Bytes& input;
+	// Decompressed scanlines, unfiltered in place
+	std::span<unsigned char> input;
 	const IHDR* const header;
 	const PLTE* const palette;
-	Outputs& output;
+	const TRNS* const transparency;
+	// Row r of the image (or of each plane) is written to output[r * rowStride]
+	std::span<T> output;
+	std::size_t rowStride;
+	DecodeOptions options;
+
+	// Output is resized to hold the tightly packed image
+	FilterArgs(std::span<unsigned char> input, IHDR* header, PLTE* palette, Outputs& output,
+	           TRNS* transparency = nullptr, const DecodeOptions& options = {}) :
+	    input(input),
+	    header(header),
+	    palette(palette),
+	    transparency(transparency),
+	    rowStride(packed_row_stride(
+	        options, scaled_dimension(decode_region(*header, options).width, options.scale),
+	        output_channels(*header, transparency, options.format))),
+	    options(options)
+	{
+		Region region = decode_region(*header, options);
+
+		output.resize(output_size(options, scaled_dimension(region.width, options.scale),
+		                          scaled_dimension(region.height, options.scale),
+		                          output_channels(*header, transparency, options.format),
+		                          rowStride));
+		this->output = output;
+	};
+
+	FilterArgs(std::span<unsigned char> input, IHDR* header, PLTE* palette, std::span<T> output,
+	           std::size_t rowStride, TRNS* transparency = nullptr,
+	           const DecodeOptions& options = {}) :
+	    input(input),
+	    header(header),
+	    palette(palette),
+	    transparency(transparency),
+	    output(output),
+	    rowStride(rowStride),
+	    options(options) {};
 
-	FilterArgs(Bytes& input, IHDR* header, PLTE* palette, Outputs& output) :
-	    input(input), header(header), palette(palette), output(output) {};
 	FilterArgs(Bytes&&, IHDR*, PLTE*, Outputs&)  = delete;
 	FilterArgs(Bytes&, IHDR*, PLTE*, Outputs&&)  = delete;
 	FilterArgs(Bytes&&, IHDR*, PLTE*, Outputs&&) = delete;
 };
 
-void do_unfilter(std::vector<unsigned char>& input, std::size_t offset, std::size_t scanlines,
+// Destination of expanded rows, either interleaved pixels or one plane per channel.
+template <SampleType T>
+struct OutputView
+{
+	T* data;
+	std::size_t rowStride;
+	std::size_t planePitch;
+	std::size_t channels;
+	bool planar;
+
+	// Stores count pixels of interleaved samples to row y, the first at column x and the rest
+	// every step columns.
+	void store(const T* pixels, std::size_t count, std::size_t y, std::size_t x,
+	           std::size_t step) const
+	{
+		if (!planar)
+		{
+			T* out = data + y * rowStride + x * channels;
+
+			if (step == 1)
+			{
+				std::memcpy(out, pixels, count * channels * sizeof(T));
+				return;
+			}
+
+			switch (channels)
+			{
+				case 1:
+					return store_strided<1>(pixels, out, count, step);
+				case 2:
+					return store_strided<2>(pixels, out, count, step);
+				case 3:
+					return store_strided<3>(pixels, out, count, step);
+				default:
+					return store_strided<4>(pixels, out, count, step);
+			}
+		}
+
+		switch (channels)
+		{
+			case 1:
+				return store_planes<1>(pixels, count, y, x, step);
+			case 2:
+				return store_planes<2>(pixels, count, y, x, step);
+			case 3:
+				return store_planes<3>(pixels, count, y, x, step);
+			default:
+				return store_planes<4>(pixels, count, y, x, step);
+		}
+	}
+
+   private:
+	// Adam7 passes scatter every 2nd, 4th or 8th column, fixing the step lets the copies unroll.
+	template <std::size_t Channels>
+	static void store_strided(const T* pixels, T* out, std::size_t count, std::size_t step)
+	{
+		switch (step)
+		{
+			case 2:
+				return store_strided<Channels, 2>(pixels, out, count);
+			case 4:
+				return store_strided<Channels, 4>(pixels, out, count);
+			case 8:
+				return store_strided<Channels, 8>(pixels, out, count);
+			default:
+				for (size_t pixel = 0; pixel < count; ++pixel)
+				{
+					std::memcpy(out + pixel * step * Channels, pixels + pixel * Channels,
+					            Channels * sizeof(T));
+				}
+		}
+	}
+
+	template <std::size_t Channels, std::size_t Step>
+	static void store_strided(const T* pixels, T* out, std::size_t count)
+	{
+		for (size_t pixel = 0; pixel < count; ++pixel)
+		{
+			std::memcpy(out + pixel * Step * Channels, pixels + pixel * Channels,
+			            Channels * sizeof(T));
+		}
+	}
+
+	template <std::size_t Channels>
+	void store_planes(const T* pixels, std::size_t count, std::size_t y, std::size_t x,
+	                  std::size_t step) const
+	{
+		T* out = data + y * rowStride + x;
+
+		for (size_t channel = 0; channel < Channels; ++channel)
+		{
+			T* plane = out + channel * planePitch;
+
+			for (size_t pixel = 0; pixel < count; ++pixel)
+			{
+				plane[pixel * step] = pixels[pixel * Channels + channel];
+			}
+		}
+	}
+};
+
+// Reverses the filter of one scanline in place. curr and prev point at the filter type byte of
+// their scanlines, prev is null for the first scanline.
+void unfilter_row(std::uint8_t* curr, const std::uint8_t* prev, std::size_t byteWidth,
+                  std::size_t bpp);
+
+void do_unfilter(std::span<unsigned char> input, std::size_t offset, std::size_t scanlines,
                  std::size_t byteWidth, std::size_t bpp);
 
-template <std::integral InputType, std::integral OutputType>
-[[nodiscard]] inline OutputType convertBitDepth(InputType val, OutputType inputBitDepth)
+// Column block a wavefront lane advances by before publishing its progress to the lane below.
+inline constexpr std::size_t wavefrontBlockSize = 1024;
+
+// Unfilters scanlines on threadCount lanes, row r + 1 trails row r by one column block so that
+// Up, Average and Paeth rows can be processed in parallel. Falls back to do_unfilter when the
+// image is too small to pipeline. Lanes run on pool, ThreadPool::instance() when null.
+void do_unfilter_wavefront(std::span<unsigned char> input, std::size_t offset,
+                           std::size_t scanlines, std::size_t byteWidth, std::size_t bpp,
+                           std::size_t threadCount = std::thread::hardware_concurrency(),
+                           std::size_t blockSize   = wavefrontBlockSize,
+                           ThreadPool* pool        = nullptr);
+
+// Lanes and column block of a wavefront unfilter, a single lane unfilters serially.
+struct WavefrontPlan
+{
+	std::size_t lanes, blockSize;
+};
+
+// Times the unfilter kernels of every level this machine supports, run by ThreadPool when it
+// starts. See ThreadPool::unfilter_nanos_per_byte.
+[[nodiscard]] UnfilterCosts measure_unfilter_costs();
+
+// Chooses how to unfilter scanlines of byteWidth bytes with bpp bytes per pixel under policy. Auto
+// weighs the serial cost of the scanlines against the cost of handing lanes to the pool, both
+// measured by the pool when it started, so small images stay on the calling thread. Adam7 passes
+// are planned one at a time.
+[[nodiscard]] WavefrontPlan plan_wavefront(std::size_t scanlines, std::size_t byteWidth,
+                                           std::size_t bpp, const ParallelismPolicy& policy);
+
+// Unfilters scanlines serially or as a wavefront, as planned by plan_wavefront. Filter types and
+// time are added to stats when set.
+void unfilter_scanlines(std::span<unsigned char> input, std::size_t offset, std::size_t scanlines,
+                        std::size_t byteWidth, std::size_t bpp, const ParallelismPolicy& policy,
+                        DecodeStats* stats = nullptr);
+
+// Expands unfiltered scanlines and averages every scale x scale block of pixels into one output
+// pixel, blocks cut off by the image edge average the pixels they have.
+template <SampleType T>
+void expand_box_filtered(const std::uint8_t* input, std::size_t byteWidth, const IHDR& header,
+                         const RowExpander<T>& expander, const OutputView<T>& view,
+                         std::size_t scale, std::vector<T>& rowBuffer)
 {
-	assert(inputBitDepth <= sizeof(OutputType) * 8);
-	double scaled = (static_cast<double>(val) * std::numeric_limits<OutputType>::max()) /
-	                static_cast<double>((1ull << inputBitDepth) - 1ull);
-	return static_cast<OutputType>(scaled);
+	using Sum = std::conditional_t<std::floating_point<T>, double,
+	                               std::conditional_t<(sizeof(T) > 4), long double, std::uint64_t>>;
+
+	std::size_t channels = expander.channels();
+	std::size_t outWidth = scaled_dimension(header.width, static_cast<uint8_t>(scale));
+
+	std::vector<Sum> sums(outWidth * channels);
+	std::vector<T> outRow(outWidth * channels);
+
+	for (size_t outY = 0; outY * scale < header.height; ++outY)
+	{
+		std::size_t rows = std::min<std::size_t>(scale, header.height - outY * scale);
+
+		std::fill(sums.begin(), sums.end(), Sum {});
+
+		for (size_t row = 0; row < rows; ++row)
+		{
+			expander.expand(input + (outY * scale + row) * byteWidth + 1, rowBuffer.data(),
+			                header.width);
+
+			for (size_t x = 0; x < header.width; ++x)
+			{
+				Sum* sum = sums.data() + (x / scale) * channels;
+
+				for (size_t channel = 0; channel < channels; ++channel)
+				{
+					sum[channel] += static_cast<Sum>(rowBuffer[x * channels + channel]);
+				}
+			}
+		}
+
+		for (size_t outX = 0; outX < outWidth; ++outX)
+		{
+			std::size_t count = rows * std::min<std::size_t>(scale, header.width - outX * scale);
+
+			for (size_t channel = 0; channel < channels; ++channel)
+			{
+				Sum sum = sums[outX * channels + channel];
+
+				if constexpr (std::is_integral_v<Sum>)
+				{
+					outRow[outX * channels + channel] = static_cast<T>((sum + count / 2) / count);
+				}
+				else if constexpr (std::floating_point<T>)
+				{
+					outRow[outX * channels + channel] = static_cast<T>(sum / count);
+				}
+				else
+				{
+					outRow[outX * channels + channel] = static_cast<T>(sum / count + 0.5L);
+				}
+			}
+		}
+
+		view.store(outRow.data(), outWidth, outY, 0, 1);
+	}
 }
 
-template <std::integral T>
+template <SampleType T>
 void unfilter(FilterArgs<T>& args)
 {
 	const IHDR& header = *args.header;
 	InterlaceMethod method { header.interlaceMethod };
 
-	std::size_t channels = ((header.colorType & static_cast<uint8_t>(ColorType::Color)) + 1) +
-	                       ((header.colorType & static_cast<uint8_t>(ColorType::Alpha)) >> 2);
+	std::size_t fileChannels = ((header.colorType & static_cast<uint8_t>(ColorType::Color)) + 1) +
+	                           ((header.colorType & static_cast<uint8_t>(ColorType::Alpha)) >> 2);
+
+	bool usesPalette         = header.colorType & static_cast<uint8_t>(ColorType::Palette);
+	std::size_t bitsPerPixel = header.bitDepth * (usesPalette ? 1 : fileChannels);
+
+	RowExpander<T> expander(header, args.palette, args.transparency, args.options.format);
+	ParallelismPolicy parallelism = args.options.parallelism.value_or(ParallelismPolicy {});
+	std::size_t channels = expander.channels();
+
+	// Everything but unfiltering counts as expansion
+	DecodeStats* stats = collect_stats(args.options.stats);
+	StageTimer timer(stats ? &stats->expandNanos : nullptr,
+	                 stats ? &stats->unfilterNanos : nullptr);
 
 	assert(channels <= 4);
 
-	bool usesPalette         = header.colorType & static_cast<uint8_t>(ColorType::Palette);
-	std::size_t bitsPerPixel = header.bitDepth * (usesPalette ? 1 : channels);
-	channels                 = usesPalette ? 3 : channels;
+	// Also rejects unsupported scales and preview pass counts for non-interlaced images
+	std::size_t passes    = adam7_passes_needed(args.options);
+	std::size_t scale     = args.options.scale;
+	Region region         = decode_region(header, args.options);
+	std::size_t rowEnd    = region.y + region.height;
+	std::size_t outWidth  = scaled_dimension(region.width, args.options.scale);
+	std::size_t outHeight = scaled_dimension(region.height, args.options.scale);
+
+	bool planar = args.options.layout == Layout::Planar;
+	OutputView<T> view { args.output.data(), args.rowStride,
+		                 plane_pitch(args.options, outHeight, args.rowStride), channels, planar };
 
-	BitConsumer<std::endian::big> unfilteredConsumer(args.input);
+	assert(args.rowStride >= packed_row_stride(args.options, outWidth, channels));
+	assert(args.output.size() >=
+	       output_size(args.options, outWidth, outHeight, channels, args.rowStride));
+
+	// Planar rows and Adam7 pass rows are expanded here first and scattered while still in cache
+	std::vector<T> rowBuffer(header.width * channels);
+
+	// Expands count pixels of a scanline starting at pixel first, a sub-byte row is expanded from
+	// the start of the byte holding first.
+	auto expandColumns = [&](const std::uint8_t* scanline, std::size_t first, std::size_t count)
+	{
+		std::size_t bit  = first * bitsPerPixel;
+		std::size_t skip = (bit % 8) / bitsPerPixel;
+
+		expander.expand(scanline + bit / 8, rowBuffer.data(), skip + count);
+		return rowBuffer.data() + skip * channels;
+	};
 
 	if (method == InterlaceMethod::None)
 	{
-		args.output.reserve(header.width * header.height * channels);
 		std::size_t byteWidth = (header.width * bitsPerPixel + 7) / 8;
 
 		if (byteWidth)
@@ -65,141 +377,88 @@ void unfilter(FilterArgs<T>& args)
 			byteWidth += 1;
 		}
 
-#ifdef TRV_PNG_MULTITHREADED
-		// Multithreading support, tests show no speedup on large files, slowdown on small images
-		assert(header.height != 0);
-		WorkerPool workers(do_unfilter);
-		std::int64_t scanline  = 1;
-		std::size_t chunkStart = 0;
+		// Rows above the region are still needed as predictors, rows below it aren't
+		unfilter_scanlines(args.input, 0, rowEnd, byteWidth, (bitsPerPixel + 7) / 8, parallelism,
+		                   stats);
 
-		for (; scanline < header.height - 1; ++scanline)
-		{
-			FilterMethod currFilter = static_cast<FilterMethod>(args.input[scanline * byteWidth]);
-			FilterMethod prevFilter =
-			    static_cast<FilterMethod>(args.input[(scanline - 1) * byteWidth]);
+		TraceScope trace("expand", "rows", region.height);
 
-			bool isIndependent =
-			    currFilter == FilterMethod::None || currFilter == FilterMethod::Sub;
-			if (isIndependent)
-			{
-				workers.AddTask(args.input, chunkStart * byteWidth, scanline - chunkStart,
-				                byteWidth, (bitsPerPixel + 7) / 8);
-				chunkStart = scanline;
-			}
+		if (scale > 1)
+		{
+			expand_box_filtered(args.input.data(), byteWidth, header, expander, view, scale,
+			                    rowBuffer);
+			return;
 		}
 
-		// Last task will always escape out
-		workers.AddTask(args.input, chunkStart * byteWidth, header.height - chunkStart, byteWidth,
-		                (bitsPerPixel + 7) / 8);
-
-		workers.WaitUntilFinished();
-#else
-		do_unfilter(args.input, 0, header.height, byteWidth, (bitsPerPixel + 7) / 8);
-#endif
+		bool inPlace = !planar && region.x * bitsPerPixel % 8 == 0;
 
-		for (size_t scanline = 0; scanline < header.height; ++scanline)
+		for (size_t scanline = region.y; scanline < rowEnd; ++scanline)
 		{
-			unfilteredConsumer.flush_byte();
-			for (size_t component = 0; component < header.width * bitsPerPixel;
-			     component += header.bitDepth)
+			const std::uint8_t* src = args.input.data() + scanline * byteWidth + 1;
+			std::size_t outRow      = scanline - region.y;
+
+			if (inPlace)
 			{
-				if (header.bitDepth <= 8)
-				{
-					std::uint8_t val =
-					    unfilteredConsumer.consume_bits<uint8_t, std::endian::big>(header.bitDepth);
-					if (!usesPalette)
-					{
-						args.output.push_back(convertBitDepth<uint8_t, T>(val, header.bitDepth));
-					}
-					else
-					{
-						args.output.push_back(args.palette->data[val * 3]);
-						args.output.push_back(args.palette->data[val * 3 + 1]);
-						args.output.push_back(args.palette->data[val * 3 + 2]);
-					}
-				}
-				else
-				{
-					std::uint16_t val = unfilteredConsumer.consume_bits<uint16_t, std::endian::big>(
-					    header.bitDepth);
-					args.output.push_back(convertBitDepth<uint16_t, T>(val, header.bitDepth));
-				}
+				expander.expand(src + region.x * bitsPerPixel / 8,
+				                args.output.data() + outRow * args.rowStride, region.width);
+			}
+			else
+			{
+				view.store(expandColumns(src, region.x, region.width), region.width, outRow, 0, 1);
 			}
 		}
 	}
 	else if (method == InterlaceMethod::Adam7)
 	{
-		static constexpr std::size_t rowStart[7] { 0, 0, 4, 0, 2, 0, 1 };
-		static constexpr std::size_t colStart[7] { 0, 4, 0, 2, 0, 1, 0 };
-		static constexpr std::size_t rowStride[7] { 8, 8, 8, 4, 4, 2, 2 };
-		static constexpr std::size_t colStride[7] { 8, 8, 4, 4, 2, 2, 1 };
+		// Pixels are replicated over the area that the skipped passes would have filled
+		static constexpr std::size_t blockWidth[7] { 8, 4, 4, 2, 2, 1, 1 };
+		static constexpr std::size_t blockHeight[7] { 8, 8, 4, 4, 2, 2, 1 };
 
-		std::size_t offset = 0;
+		std::size_t repeatX = scale > 1 ? 1 : blockWidth[passes - 1];
+		std::size_t repeatY = scale > 1 ? 1 : blockHeight[passes - 1];
 
-		args.output.resize(header.width * header.height * channels);
-
-		for (int pass = 0; pass < 7; ++pass)
+		for (const Adam7Pass& pass : adam7_passes(header.width, header.height, bitsPerPixel) |
+		                                 std::views::take(passes))
 		{
-			std::size_t passWidth =
-			    (header.width + colStride[pass] - 1 - colStart[pass]) / colStride[pass];
-			std::size_t passHeight =
-			    (header.height + rowStride[pass] - 1 - rowStart[pass]) / rowStride[pass];
-			std::size_t byteWidth = (passWidth * bitsPerPixel + 7) / 8;
+			std::size_t rows = pass.rows_before(rowEnd);
 
-			if (!byteWidth) continue;
+			if (!pass.byteWidth || !rows) continue;
 
-			byteWidth += 1;
-			do_unfilter(args.input, offset, passHeight, byteWidth, (bitsPerPixel + 7) / 8);
+			unfilter_scanlines(args.input, pass.offset, rows, pass.byteWidth,
+			                   (bitsPerPixel + 7) / 8, parallelism, stats);
+
+			// Pass columns inside the region
+			std::size_t colBegin = pass.cols_before(region.x);
+			std::size_t colEnd   = pass.cols_before(region.x + region.width);
+
+			if (colBegin >= colEnd) continue;
 
-			for (size_t inRow = 0; inRow < passHeight; ++inRow)
+			TraceScope trace("expand", "rows", rows - pass.rows_before(region.y));
+
+			for (size_t inRow = pass.rows_before(region.y); inRow < rows; ++inRow)
 			{
-				unfilteredConsumer.flush_byte();
-				for (size_t inCol = 0; inCol < passWidth; ++inCol)
-				{
-					std::size_t outRow = (inRow * rowStride[pass] + rowStart[pass]);
-					std::size_t outCol = (inCol * colStride[pass] + colStart[pass]) * channels;
+				const T* pixels =
+				    expandColumns(args.input.data() + pass.offset + inRow * pass.byteWidth + 1,
+				                  colBegin, colEnd - colBegin);
 
-					if (!usesPalette)
-					{
-						for (size_t channel = 0; channel < channels; ++channel)
-						{
-							assert(
-							    args.output[outRow * header.width * channels + outCol + channel] ==
-							    0);
-							if (header.bitDepth <= 8)
-							{
-								std::uint8_t val =
-								    unfilteredConsumer.consume_bits<uint8_t, std::endian::big>(
-								        header.bitDepth);
-								args.output[outRow * header.width * channels + outCol + channel] =
-								    convertBitDepth<uint8_t, T>(val, header.bitDepth);
-							}
-							else
-							{
-								std::uint16_t val =
-								    unfilteredConsumer.consume_bits<uint16_t, std::endian::big>(
-								        header.bitDepth);
-								args.output[outRow * header.width * channels + outCol + channel] =
-								    convertBitDepth<uint16_t, T>(val, header.bitDepth);
-							}
-						}
-					}
-					else
+				// Every pass kept at a reduced scale starts and steps on multiples of scale
+				std::size_t outRow    = (inRow * pass.rowStride + pass.rowStart - region.y) / scale;
+				std::size_t outCol =
+				    (colBegin * pass.colStride + pass.colStart - region.x) / scale;
+				std::size_t outStride = pass.colStride / scale;
+
+				for (size_t dy = 0; dy < repeatY && outRow + dy < outHeight; ++dy)
+				{
+					for (size_t dx = 0; dx < repeatX && outCol + dx < outWidth; ++dx)
 					{
-						std::uint8_t val =
-						    unfilteredConsumer.consume_bits<uint8_t, std::endian::big>(
-						        header.bitDepth);
-						args.output[outRow * header.width * channels + outCol] =
-						    convertBitDepth<uint8_t, T>(args.palette->data[val * 3], 8);
-						args.output[outRow * header.width * channels + outCol + 1] =
-						    convertBitDepth<uint8_t, T>(args.palette->data[val * 3 + 1], 8);
-						args.output[outRow * header.width * channels + outCol + 2] =
-						    convertBitDepth<uint8_t, T>(args.palette->data[val * 3 + 2], 8);
+						std::size_t count = std::min(colEnd - colBegin,
+						                             (outWidth - outCol - dx + outStride - 1) /
+						                                 outStride);
+
+						view.store(pixels, count, outRow + dy, outCol + dx, outStride);
 					}
 				}
 			}
-
-			offset += byteWidth * passHeight;
 		}
 	}
 	else
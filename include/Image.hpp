@@ -5,14 +5,18 @@
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
+#include <span>
 #include <sstream>
 #include <string>
 #include <type_traits>
 #include <vector>
 
+#include "Allocation.hpp"
 #include "Chunk.hpp"
 #include "Common.hpp"
 #include "Filter.hpp"
+#include "Options.hpp"
 #include "Zlib.hpp"
 #include "utility/export.hpp"
 
@@ -21,14 +25,35 @@ namespace trv
 //Expected first 8 bytes of all PNG files
 inline constexpr std::uint64_t header_signature = 0x89504e470d0a1a0a;
 
-// Output type
-template <std::integral T>
+// Samples of an Image, allocated without being zeroed since decoding writes every one of them.
+template <SampleType T>
+using SampleBuffer = std::vector<T, DefaultInitAllocator<T>>;
+
+// Output type, row r starts at data[r * rowStride]
+template <SampleType T, typename Allocator = DefaultInitAllocator<T>>
 struct Image
 {
-	Image(std::vector<T> data, std::uint32_t width, std::uint32_t height, std::uint32_t channels) :
-	    data(std::move(data)), width(width), height(height), channels(channels) {};
+	Image(std::vector<T, Allocator> data, std::uint32_t width, std::uint32_t height,
+	      std::uint32_t channels, std::size_t rowStride = 0) :
+	    data(std::move(data)),
+	    width(width),
+	    height(height),
+	    channels(channels),
+	    rowStride(rowStride ? rowStride : std::size_t { width } * channels) {};
+
+	std::vector<T, Allocator> data;
+	std::uint32_t width, height, channels;
+	// In elements, planar images hold width samples per row of each plane
+	std::size_t rowStride;
+};
+
+// Image allocated according to an AllocationPolicy
+template <SampleType T>
+using PmrImage = Image<T, std::pmr::polymorphic_allocator<T>>;
 
-	std::vector<T> data;
+// Dimensions of the decoded output, channels is the number of samples per pixel.
+struct ImageInfo
+{
 	std::uint32_t width, height, channels;
 };
 
@@ -45,110 +70,287 @@ struct Image
 	}
 }
 
-// Read PNG file
-template <std::integral T>
-[[nodiscard]] DLL_PUBLIC Image<T> load_image(const std::string& path)
+// Reads and validates every chunk of a PNG file. Throws before reading image data that, along with
+// the scanlines it inflates to, would exceed options.memoryBudget.
+[[nodiscard]] DLL_PUBLIC Chunks read_chunks(const std::string& path,
+                                            const DecodeOptions& options = {});
+
+// As above, but reads into chunks and sequence so that the capacity of their IDAT data and of
+// sequence left over from an earlier image is reused.
+DLL_PUBLIC void read_chunks(const std::string& path, Chunks& chunks,
+                            std::vector<ChunkType>& sequence, const DecodeOptions& options = {});
+
+// Reads the chunks of a PNG file already in memory.
+[[nodiscard]] DLL_PUBLIC Chunks read_chunks(std::span<const unsigned char> buffer,
+                                            const DecodeOptions& options = {});
+
+DLL_PUBLIC void read_chunks(std::span<const unsigned char> buffer, Chunks& chunks,
+                            std::vector<ChunkType>& sequence, const DecodeOptions& options = {});
+
+// Contents of a whole file, for decoding later or on another thread.
+[[nodiscard]] DLL_PUBLIC std::vector<unsigned char> read_file(const std::string& path);
+
+// Reads the chunks preceding the image data, enough to size an output buffer for decode_into.
+[[nodiscard]] DLL_PUBLIC ImageInfo read_image_info(const std::string& path,
+                                                   const DecodeOptions& options = {});
+
+[[nodiscard]] DLL_PUBLIC ImageInfo image_info(const Chunks& chunks,
+                                              const DecodeOptions& options = {});
+
+// Inflates the concatenated IDAT chunks, stopping once the data options needs is available.
+[[nodiscard]] DLL_PUBLIC std::vector<unsigned char> decompress_image(
+    const Chunks& chunks, const DecodeOptions& options = {});
+
+// As above, but inflates into decompressed (keeping its capacity) and rebuilds dynamic Huffman
+// tables in tables when given.
+DLL_PUBLIC void decompress_image(const Chunks& chunks, const DecodeOptions& options,
+                                 std::vector<unsigned char>& decompressed,
+                                 InflateTables* tables = nullptr);
+
+DLL_PUBLIC void decompress_image(const Chunks& chunks, const DecodeOptions& options,
+                                 std::pmr::vector<unsigned char>& decompressed,
+                                 InflateTables* tables = nullptr);
+
+// Bytes of decompressed scanlines that options needs inflated.
+[[nodiscard]] DLL_PUBLIC std::size_t decompressed_size(const IHDR& header,
+                                                       const DecodeOptions& options);
+
+// Checks a decode of chunks allocating outputBytes of output against options.memoryBudget before
+// the scanlines and output are allocated, from the sizes in their headers.
+DLL_PUBLIC void reserve_memory(const Chunks& chunks, const DecodeOptions& options,
+                               std::size_t outputBytes);
+
+// Reports the capacity of the buffers a finished decode of chunks allocated to
+// options.memoryUsage.
+DLL_PUBLIC void report_memory(const Chunks& chunks, const DecodeOptions& options,
+                              std::size_t decompressedBytes, std::size_t outputBytes);
+
+// Throws when options.planePitch is too small for a plane of info's dimensions with rows rowStride
+// apart, so planar planes would overlap. Every entry point checks it before allocating.
+DLL_PUBLIC void check_plane_pitch(const ImageInfo& info, std::size_t rowStride,
+                                  const DecodeOptions& options);
+
+// Throws unless size elements with rows rowStride apart can receive an image of info's
+// dimensions, see decode_into.
+DLL_PUBLIC void check_destination(const ImageInfo& info, std::size_t size, std::size_t rowStride,
+                                  const DecodeOptions& options);
+
+// Unfilters and expands decompressed image data into output, row r (of each plane when planar)
+// starts at output[r * rowStride].
+template <SampleType T>
+void decode_chunks(Chunks& chunks, std::span<unsigned char> decompressed, std::span<T> output,
+                   std::size_t rowStride, const DecodeOptions& options)
+{
+	PLTE* palette      = chunks.palette ? &chunks.palette->data : nullptr;
+	TRNS* transparency = chunks.transparency ? &chunks.transparency->data : nullptr;
+
+	FilterArgs<T> unfilterArgs { decompressed, &chunks.header->data, palette, output, rowStride,
+		                         transparency, options };
+	unfilter<T>(unfilterArgs);
+}
+
+// Streams the unfiltered scanlines of a non-interlaced PNG file. Only the current and previous
+// scanline, the inflate window and one IDAT chunk are held in memory rather than the whole image.
+class DLL_PUBLIC ScanlineReader
 {
-	std::ifstream infile(path, std::ios_base::binary | std::ios_base::in);
-	if (infile.rdstate() & std::ios_base::failbit)
+   public:
+	explicit ScanlineReader(const std::string& path);
+
+	ScanlineReader(const ScanlineReader&)            = delete;
+	ScanlineReader& operator=(const ScanlineReader&) = delete;
+
+	[[nodiscard]] const IHDR& header() const { return m_chunks.header->data; }
+
+	[[nodiscard]] const PLTE* palette() const
 	{
-		throw std::runtime_error("TRV::IMAGE::LOAD_IMAGE - Unable to open Image.");
+		return m_chunks.palette ? &m_chunks.palette->data : nullptr;
 	}
-	// First thing's first
 
-	std::uint64_t file_header = extract_from_ifstream<uint64_t>(infile);
+	[[nodiscard]] const TRNS* transparency() const
+	{
+		return m_chunks.transparency ? &m_chunks.transparency->data : nullptr;
+	}
+
+	// Next unfiltered scanline without its filter type byte, null once every scanline was read.
+	[[nodiscard]] const std::uint8_t* next_scanline();
+
+   private:
+	bool read_image_data(std::vector<unsigned char>& input);
 
-	if (file_header != header_signature)
+	std::ifstream m_file;
+	Chunks m_chunks;
+	std::unique_ptr<Inflater> m_inflater;
+	std::vector<std::uint8_t> m_current, m_previous;
+	std::size_t m_bpp = 0;
+	std::size_t m_row = 0;
+	// Size of the next IDAT chunk, its header has already been read
+	std::uint32_t m_chunkSize = 0;
+	bool m_inImageData        = false;
+};
+
+// Pull-style decoder of non-interlaced images, every next_row call decodes one more row in memory
+// bounded by the row size rather than the image size. Only DecodeOptions::format applies.
+template <SampleType T>
+class RowReader
+{
+   public:
+	explicit RowReader(const std::string& path, const DecodeOptions& options = {}) :
+	    m_scanlines(path),
+	    m_expander(m_scanlines.header(), m_scanlines.palette(), m_scanlines.transparency(),
+	               options.format)
 	{
-		throw std::runtime_error("TRV::IMAGE::LOAD_IMAGE - Invalid PNG header.");
+		if (options.layout != Layout::Interleaved || options.scale != 1 ||
+		    options.previewPasses || options.region.width || options.region.height)
+		{
+			throw std::runtime_error(
+			    "TRV::IMAGE::ROW_READER - Only the pixel format applies to streamed rows.");
+		}
 	}
 
-	Chunks chunks;
-	std::vector<ChunkType> sequence;
+	[[nodiscard]] ImageInfo info() const
+	{
+		const IHDR& header = m_scanlines.header();
+		return { header.width, header.height, static_cast<uint32_t>(m_expander.channels()) };
+	}
 
-	while (infile.peek() != EOF)
+	// Decodes the next row into row, which must hold width * channels samples. Returns false once
+	// every row has been read.
+	bool next_row(std::span<T> row)
 	{
-		std::uint32_t size = extract_from_ifstream<uint32_t>(infile);
+		const IHDR& header = m_scanlines.header();
+
+		if (row.size() < header.width * m_expander.channels())
+		{
+			throw std::runtime_error("TRV::IMAGE::ROW_READER - Row is too small for the image.");
+		}
 
-		std::uint32_t type = extract_from_ifstream<uint32_t>(infile);
+		const std::uint8_t* scanline = m_scanlines.next_scanline();
 
-		switch (type)
+		if (!scanline)
 		{
-			case encode_type("IHDR"):
-				chunks.header = std::make_unique<Chunk<IHDR>>(infile, size, type);
-				sequence.push_back(ChunkType::IHDR);
-				break;
-			case encode_type("PLTE"):
-				chunks.palette = std::make_unique<Chunk<PLTE>>(infile, size, type);
-				sequence.push_back(ChunkType::PLTE);
-				break;
-			case encode_type("IDAT"):
-				if (chunks.image_data == nullptr)
-				{
-					chunks.image_data = std::make_unique<Chunk<IDAT>>(infile, size, type);
-				}
-				else
-				{
-					chunks.image_data->append(infile, size);
-				}
-				sequence.push_back(ChunkType::IDAT);
-				break;
-			case encode_type("IEND"):
-				chunks.end = std::make_unique<Chunk<IEND>>(infile, size, type);
-				sequence.push_back(ChunkType::IEND);
-				break;
-			default:
-				{
-					std::uint32_t temp_type = big_endian<uint32_t>(type);
-					char cType[5]           = { 0 };
-					memcpy(cType, &temp_type, 4);
-					infile.seekg(size + sizeof(uint32_t), std::ios_base::cur);
-					std::cout << "TRV::IMAGE::LOAD_IMAGE - Skipping unhandled type " << cType
-					          << "\n";
-					sequence.push_back(ChunkType::Unknown);
-				}
+			return false;
 		}
+
+		m_expander.expand(scanline, row.data(), header.width);
+		return true;
 	}
 
-	verifyOrdering(chunks.header.get(), sequence);
+   private:
+	ScanlineReader m_scanlines;
+	RowExpander<T> m_expander;
+};
 
-	IHDR& header         = chunks.header->data;
-	std::size_t channels = (header.colorType & static_cast<uint8_t>(ColorType::Color)) + 1 +
-	                       ((header.colorType & static_cast<uint8_t>(ColorType::Alpha)) >> 2);
-	bool usesPalette = header.colorType & static_cast<uint8_t>(ColorType::Palette);
-	channels         = usesPalette ? 3 : channels;
+// Sizes output for an image of info's dimensions with rows rowStride apart. Samples already there
+// or added by a DefaultInitAllocator are left as they are for decoding to overwrite, only the
+// elements between planes placed further apart than they need are zeroed.
+template <SampleType T, typename Allocator>
+void size_output(std::vector<T, Allocator>& output, const ImageInfo& info, std::size_t rowStride,
+                 const DecodeOptions& options)
+{
+	output.resize(output_size(options, info.width, info.height, info.channels, rowStride));
 
-	std::vector<unsigned char> decompressed;
-	std::size_t bitsPerPixel = header.bitDepth * (usesPalette ? 1 : channels);
-	std::size_t byteWidth    = (header.width * bitsPerPixel + 7) / 8;
+	if (options.layout != Layout::Planar || output.empty())
+	{
+		return;
+	}
+
+	std::size_t pitch = plane_pitch(options, info.height, rowStride);
+	std::size_t plane = (info.height - 1) * rowStride + info.width;
 
-	if (byteWidth)
+	for (size_t channel = 0; channel + 1 < info.channels; ++channel)
 	{
-		byteWidth += 1;
+		std::fill(output.begin() + channel * pitch + plane,
+		          output.begin() + (channel + 1) * pitch, T {});
 	}
+}
 
-	decompressed.reserve(header.height * byteWidth);
-	DeflateArgs decompressArgs { true, chunks.image_data->data.data, decompressed };
+// Decodes the chunks of a PNG file into a new image.
+template <SampleType T>
+[[nodiscard]] Image<T> load_chunks(Chunks chunks, const DecodeOptions& options)
+{
+	ImageInfo info = image_info(chunks, options);
 
-	decompress(decompressArgs);
+	std::size_t rowStride = packed_row_stride(options, info.width, info.channels);
+	std::size_t outputSize =
+	    output_size(options, info.width, info.height, info.channels, rowStride);
 
-	std::vector<T> output;
+	check_plane_pitch(info, rowStride, options);
+	reserve_memory(chunks, options, outputSize * sizeof(T));
 
-	Chunk<PLTE>* paletteChunk = chunks.palette.get();
+	std::vector<unsigned char> decompressed = decompress_image(chunks, options);
+	Image<T> image({}, info.width, info.height, info.channels, rowStride);
 
-	PLTE* palette = nullptr;
+	size_output(image.data, info, rowStride, options);
+	decode_chunks<T>(chunks, decompressed, image.data, rowStride, options);
+	report_memory(chunks, options, decompressed.capacity(), image.data.capacity() * sizeof(T));
 
-	if (paletteChunk)
-	{
-		palette = &paletteChunk->data;
-	}
+	return image;
+}
 
-	FilterArgs unfilterArgs { decompressed, &header, palette, output };
-	unfilter<T>(unfilterArgs);
+// Read PNG file
+template <SampleType T>
+[[nodiscard]] DLL_PUBLIC Image<T> load_image(const std::string& path,
+                                             const DecodeOptions& options = {})
+{
+	return load_chunks<T>(read_chunks(path, options), options);
+}
+
+// Decode a PNG file already in memory.
+template <SampleType T>
+[[nodiscard]] DLL_PUBLIC Image<T> load_image(std::span<const unsigned char> file,
+                                             const DecodeOptions& options = {})
+{
+	return load_chunks<T>(read_chunks(file, options), options);
+}
+
+// Read PNG file with both the output and the decompressed scanlines allocated from
+// policy.resource, output rows are padded to policy.rowAlignment.
+template <SampleType T>
+[[nodiscard]] DLL_PUBLIC PmrImage<T> load_image(const std::string& path,
+                                                const DecodeOptions& options,
+                                                const AllocationPolicy& policy)
+{
+	Chunks chunks  = read_chunks(path, options);
+	ImageInfo info = image_info(chunks, options);
+
+	std::size_t rowStride = aligned_row_stride(
+	    packed_row_stride(options, info.width, info.channels), sizeof(T), policy.rowAlignment);
+	std::size_t outputSize =
+	    output_size(options, info.width, info.height, info.channels, rowStride);
+
+	check_plane_pitch(info, rowStride, options);
+	reserve_memory(chunks, options, outputSize * sizeof(T));
+
+	std::pmr::vector<unsigned char> decompressed(policy.resource);
+	decompress_image(chunks, options, decompressed);
+
+	std::pmr::vector<T> output(outputSize, policy.resource);
+
+	decode_chunks<T>(chunks, decompressed, output, rowStride, options);
+	report_memory(chunks, options, decompressed.capacity(), output.capacity() * sizeof(T));
+
+	return PmrImage<T>(std::move(output), info.width, info.height, info.channels, rowStride);
+}
+
+// Read PNG file into caller owned memory, row r of the image starts at dst[r * rowStride].
+// rowStride is in elements and must be at least width * channels, see read_image_info. Planar
+// output places row r of plane c at dst[c * planePitch + r * rowStride], rowStride must be at least
+// width and planes may not overlap.
+template <SampleType T>
+DLL_PUBLIC ImageInfo decode_into(const std::string& path, std::span<T> dst, std::size_t rowStride,
+                                 const DecodeOptions& options = {})
+{
+	Chunks chunks  = read_chunks(path, options);
+	ImageInfo info = image_info(chunks, options);
+
+	check_destination(info, dst.size(), rowStride, options);
+	reserve_memory(chunks, options, 0);
+
+	std::vector<unsigned char> decompressed = decompress_image(chunks, options);
 
-	assert(output.size() == header.width * header.height * channels);
+	decode_chunks<T>(chunks, decompressed, dst, rowStride, options);
+	report_memory(chunks, options, decompressed.capacity(), 0);
 
-	return Image<T>(output, chunks.header->data.width, chunks.header->data.height,
-	                static_cast<uint32_t>(channels));
+	return info;
 }
 }
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+namespace trv
+{
+class ThreadPool;
+struct DecodeStats;
+
+// Receives the type and data size of every chunk the decoder doesn't handle, which it skips.
+typedef std::function<void(std::string_view type, std::uint32_t size)> UnknownChunkHandler;
+
+// Layout of each output pixel. Native keeps the layout of the file: gray, gray alpha, RGB or RGBA,
+// with palette images expanded to RGB and tRNS adding an alpha channel.
+enum class PixelFormat : std::uint8_t
+{
+	Native,
+	Gray,
+	GrayAlpha,
+	RGB,
+	RGBA,
+	BGRA,
+	PremultipliedRGBA
+};
+
+// Samples per pixel of format, nativeChannels is the channel count of the file's own layout.
+[[nodiscard]] constexpr std::size_t format_channels(PixelFormat format, std::size_t nativeChannels)
+{
+	switch (format)
+	{
+		case PixelFormat::Gray:
+			return 1;
+		case PixelFormat::GrayAlpha:
+			return 2;
+		case PixelFormat::RGB:
+			return 3;
+		case PixelFormat::RGBA:
+		case PixelFormat::BGRA:
+		case PixelFormat::PremultipliedRGBA:
+			return 4;
+		default:
+			return nativeChannels;
+	}
+}
+
+// Arrangement of samples in the output. Interleaved stores the samples of each pixel together,
+// Planar stores each channel in its own plane of width * height samples.
+enum class Layout : std::uint8_t
+{
+	Interleaved,
+	Planar
+};
+
+// Rectangle of an image in pixels.
+struct Region
+{
+	std::uint32_t x = 0, y = 0, width = 0, height = 0;
+};
+
+// Bytes allocated for each buffer of a decode, measured from the buffers once decoding finished.
+// Every buffer is alive at the end of a decode so peak is their sum.
+struct MemoryUsage
+{
+	// IDAT chunk data, decompressed scanlines and output samples, output is 0 for caller owned
+	// memory
+	std::size_t compressed = 0, decompressed = 0, output = 0;
+	std::size_t peak = 0;
+};
+
+// Serial never leaves the calling thread, Parallel always unfilters on the pool and Auto decides
+// per image from its size and the measured speed of the machine.
+enum class Parallelism : std::uint8_t
+{
+	Serial,
+	Parallel,
+	Auto
+};
+
+// How a decode spreads its work over threads.
+struct ParallelismPolicy
+{
+	Parallelism mode = Parallelism::Auto;
+	// Parallel only: lanes and the column block each lane advances by, 0 uses every thread of the
+	// pool and wavefrontBlockSize
+	std::size_t threads = 0, blockSize = 0;
+	// ThreadPool::instance() when null
+	ThreadPool* pool = nullptr;
+};
+
+// Optional behaviour of load_image and decode_into.
+struct DecodeOptions
+{
+	PixelFormat format = PixelFormat::Native;
+	Layout layout      = Layout::Interleaved;
+	// Elements from the start of one plane to the next, 0 packs planes as height * rowStride
+	std::size_t planePitch = 0;
+	// Interlaced images only: decode the first previewPasses Adam7 passes and replicate their
+	// pixels over the rest of the image, 0 decodes every pass
+	std::uint8_t previewPasses = 0;
+	// Divides both dimensions by 1, 2, 4 or 8. Interlaced images keep every scale-th pixel and
+	// skip the passes that aren't needed, other images average scale x scale blocks
+	std::uint8_t scale = 1;
+	// Decodes only this rectangle, rows below it are never inflated. Width and height 0 decode
+	// the whole image
+	Region region;
+	// Bytes a decode may allocate, checked from IHDR and each chunk header before anything is
+	// allocated. 0 is unlimited
+	std::size_t memoryBudget = 0;
+	// Receives the bytes each stage allocated when set, written after a successful decode
+	MemoryUsage* memoryUsage = nullptr;
+	// Unset uses the policy of the Decoder, or Auto
+	std::optional<ParallelismPolicy> parallelism;
+	// Counters and stage timings are added to this when set, see Stats.hpp
+	DecodeStats* stats = nullptr;
+	// Unhandled chunks are skipped silently when unset
+	UnknownChunkHandler unknownChunk;
+};
+
+// Output size of an image dimension of size pixels at scale, partial blocks round up.
+[[nodiscard]] constexpr std::size_t scaled_dimension(std::size_t size, std::uint8_t scale)
+{
+	return (size + scale - 1) / scale;
+}
+
+// Elements between consecutive planes of a planar output with the given row stride.
+[[nodiscard]] constexpr std::size_t plane_pitch(const DecodeOptions& options, std::size_t height,
+                                                std::size_t rowStride)
+{
+	return options.planePitch ? options.planePitch : height * rowStride;
+}
+
+// Row stride of a tightly packed output, in elements.
+[[nodiscard]] constexpr std::size_t packed_row_stride(const DecodeOptions& options,
+                                                      std::size_t width, std::size_t channels)
+{
+	return options.layout == Layout::Planar ? width : width * channels;
+}
+
+// Elements an output must hold to receive the image with the given row stride.
+[[nodiscard]] constexpr std::size_t output_size(const DecodeOptions& options, std::size_t width,
+                                                std::size_t height, std::size_t channels,
+                                                std::size_t rowStride)
+{
+	if (!width || !height || !channels)
+	{
+		return 0;
+	}
+
+	std::size_t plane = (height - 1) * rowStride + packed_row_stride(options, width, channels);
+
+	if (options.layout == Layout::Planar)
+	{
+		return (channels - 1) * plane_pitch(options, height, rowStride) + plane;
+	}
+
+	return plane;
+}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace trv
+{
+// Statistics are collected only when the library is built with TRV_STATS, otherwise every counter
+// and timer below compiles to nothing.
+#ifdef TRV_PNG_STATS
+inline constexpr bool statsEnabled = true;
+#else
+inline constexpr bool statsEnabled = false;
+#endif
+
+// Counters of one or more decodes, see DecodeOptions::stats. Every field is added to rather than
+// overwritten, so one DecodeStats can sum a whole set of images.
+struct DecodeStats
+{
+	// Bytes of the PNG stream parsed, including the signature and every chunk header and CRC
+	std::size_t bytesRead       = 0;
+	std::size_t imageDataChunks = 0, unknownChunks = 0;
+	// Deflate blocks by BTYPE: stored, fixed Huffman and dynamic Huffman
+	std::array<std::size_t, 3> blocks {};
+	// Huffman tables built for dynamic blocks, a literal/length and a distance table each
+	std::size_t huffmanTables = 0;
+	// Matches by length symbol - 257 and by distance code
+	std::array<std::size_t, 29> matchLengths {};
+	std::array<std::size_t, 30> matchDistances {};
+	// Scanlines by filter type, None to Paeth
+	std::array<std::size_t, 5> filters {};
+	// Wall time of each stage, none of them overlap
+	std::uint64_t parseNanos = 0, crcNanos = 0, inflateNanos = 0, unfilterNanos = 0,
+	              expandNanos = 0;
+};
+
+// Statistics to collect into, always null when they are compiled out so that the checks guarding
+// each counter fold away.
+[[nodiscard]] constexpr DecodeStats* collect_stats(DecodeStats* stats)
+{
+	return statsEnabled ? stats : nullptr;
+}
+
+// Adds the time it was alive to *nanos when nanos is set, minus whatever was added to *excluded
+// meanwhile by the timers of nested stages.
+class StageTimer
+{
+   public:
+	explicit StageTimer(std::uint64_t* nanos, const std::uint64_t* excluded = nullptr) :
+	    m_nanos(statsEnabled ? nanos : nullptr), m_excluded(excluded)
+	{
+		if (m_nanos)
+		{
+			m_excludedStart = m_excluded ? *m_excluded : 0;
+			m_start         = std::chrono::steady_clock::now();
+		}
+	}
+
+	StageTimer(const StageTimer&)            = delete;
+	StageTimer& operator=(const StageTimer&) = delete;
+
+	~StageTimer()
+	{
+		if (m_nanos)
+		{
+			auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			    std::chrono::steady_clock::now() - m_start);
+
+			*m_nanos += static_cast<std::uint64_t>(elapsed.count()) -
+			            (m_excluded ? *m_excluded - m_excludedStart : 0);
+		}
+	}
+
+   private:
+	std::uint64_t* m_nanos;
+	const std::uint64_t* m_excluded;
+	std::uint64_t m_excludedStart = 0;
+	std::chrono::steady_clock::time_point m_start;
+};
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Cpu.hpp"
+#include "utility/export.hpp"
+
+namespace trv
+{
+// Type erased unit of work, owned by whoever runs it.
+struct PoolTask
+{
+	virtual ~PoolTask() = default;
+	virtual void run()  = 0;
+};
+
+// Chase-Lev deque of a fixed capacity. The owning worker pushes and pops at the bottom without
+// locking, other threads steal from the top.
+class WorkStealingDeque
+{
+   public:
+	static constexpr std::int64_t capacity = 1024;
+
+	// Owner only, false when full.
+	bool push(PoolTask* task)
+	{
+		std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		std::int64_t top    = m_top.load(std::memory_order_acquire);
+
+		if (bottom - top >= capacity)
+		{
+			return false;
+		}
+
+		m_tasks[bottom & (capacity - 1)].store(task, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Owner only, newest task first.
+	PoolTask* pop()
+	{
+		std::int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::int64_t top = m_top.load(std::memory_order_relaxed);
+
+		if (top > bottom)
+		{
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		PoolTask* task = m_tasks[bottom & (capacity - 1)].load(std::memory_order_relaxed);
+
+		// Last task, a thief may be taking it at the same time
+		if (top == bottom)
+		{
+			if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+			                                   std::memory_order_relaxed))
+			{
+				task = nullptr;
+			}
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+
+		return task;
+	}
+
+	// Any thread, oldest task first.
+	PoolTask* steal()
+	{
+		std::int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+		if (top >= bottom)
+		{
+			return nullptr;
+		}
+
+		PoolTask* task = m_tasks[top & (capacity - 1)].load(std::memory_order_relaxed);
+
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+		                                   std::memory_order_relaxed))
+		{
+			return nullptr;
+		}
+
+		return task;
+	}
+
+   private:
+	std::array<std::atomic<PoolTask*>, capacity> m_tasks {};
+	std::atomic<std::int64_t> m_top { 0 };
+	std::atomic<std::int64_t> m_bottom { 0 };
+};
+
+// Nanoseconds per byte of unfiltering, by CpuLevel and bytes per pixel.
+using UnfilterCosts = std::array<std::array<double, 9>, cpuLevels>;
+
+// Work-stealing thread pool. Every worker owns a deque, tasks submitted from a worker go to its own
+// deque and idle workers steal from the others. Tasks from other threads enter through a shared
+// queue. Threads are started once, instance() is shared by every parallel part of the decoder.
+class DLL_PUBLIC ThreadPool
+{
+   public:
+	explicit ThreadPool(std::size_t threads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&)            = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Process-wide pool, started on first use with a worker per hardware thread but one, the
+	// thread calling parallel_for makes up the last.
+	[[nodiscard]] static ThreadPool& instance();
+
+	[[nodiscard]] std::size_t size() const { return m_workers.size(); }
+
+	// Nanoseconds it takes to hand one more range to a worker and wait for it, measured when the
+	// pool starts so callers sizing their work for this pool don't pay for it. 0 without workers.
+	[[nodiscard]] double nanos_per_lane() const { return m_nanosPerLane; }
+
+	// Nanoseconds a single thread takes to unfilter a byte of Paeth scanlines, the slowest filter,
+	// with bpp bytes per pixel on the kernels cpu_level() currently selects. Measured for every
+	// level and bpp when the pool starts, 0 without workers.
+	[[nodiscard]] double unfilter_nanos_per_byte(std::size_t bpp) const
+	{
+		std::size_t level = static_cast<std::size_t>(cpu_level());
+		return m_unfilterNanos[level][std::min<std::size_t>(bpp, 8)];
+	}
+
+	// Runs task() on a worker some time later, exceptions escaping task terminate.
+	template <typename F>
+	void submit(F&& task)
+	{
+		push(new CallableTask<std::decay_t<F>>(std::forward<F>(task)));
+	}
+
+	// Calls body(first, last) over [begin, end) in ranges of grain indices and returns once every
+	// range is done. The calling thread takes part, so a nested call from a worker can't stall the
+	// pool. The first exception thrown by body is rethrown, ranges not started yet are skipped.
+	template <typename F>
+	void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F&& body)
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+
+		grain              = std::max<std::size_t>(grain, 1);
+		std::size_t ranges = (end - begin + grain - 1) / grain;
+
+		if (ranges == 1 || m_workers.empty())
+		{
+			for (std::size_t first = begin; first < end; first += grain)
+			{
+				body(first, std::min(first + grain, end));
+			}
+			return;
+		}
+
+		ForJob<std::remove_reference_t<F>> job(begin, end, grain, body);
+		std::size_t helpers = std::min(ranges - 1, m_workers.size());
+
+		job.outstanding.store(helpers, std::memory_order_relaxed);
+
+		for (std::size_t helper = 0; helper < helpers; ++helper)
+		{
+			push(new ForHelper<std::remove_reference_t<F>>(&job));
+		}
+
+		job.work();
+
+		// Helpers still queued hold a pointer to job, run other tasks until they are done
+		while (job.outstanding.load(std::memory_order_acquire))
+		{
+			if (!run_one())
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		if (job.error)
+		{
+			std::rethrow_exception(job.error);
+		}
+	}
+
+   private:
+	template <typename F>
+	struct CallableTask : PoolTask
+	{
+		template <typename G>
+		explicit CallableTask(G&& callable) : callable(std::forward<G>(callable))
+		{
+		}
+
+		void run() override { callable(); }
+
+		F callable;
+	};
+
+	template <typename F>
+	struct ForJob
+	{
+		ForJob(std::size_t begin, std::size_t end, std::size_t grain, F& body) :
+		    next(begin), end(end), grain(grain), body(body)
+		{
+		}
+
+		// Claims ranges until none are left
+		void work()
+		{
+			while (!failed.load(std::memory_order_relaxed))
+			{
+				std::size_t first = next.fetch_add(grain, std::memory_order_relaxed);
+
+				if (first >= end)
+				{
+					return;
+				}
+
+				try
+				{
+					body(first, std::min(first + grain, end));
+				}
+				catch (...)
+				{
+					std::lock_guard lock(errorMutex);
+
+					if (!error)
+					{
+						error = std::current_exception();
+					}
+					failed.store(true, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		std::atomic<std::size_t> next;
+		std::size_t end;
+		std::size_t grain;
+		F& body;
+		std::atomic<bool> failed { false };
+		std::atomic<std::size_t> outstanding { 0 };
+		std::mutex errorMutex;
+		std::exception_ptr error;
+	};
+
+	template <typename F>
+	struct ForHelper : PoolTask
+	{
+		explicit ForHelper(ForJob<F>* job) : job(job) {}
+
+		void run() override
+		{
+			job->work();
+			job->outstanding.fetch_sub(1, std::memory_order_release);
+		}
+
+		ForJob<F>* job;
+	};
+
+	void push(PoolTask* task);
+	// Runs one queued task on the calling thread, false when none was found.
+	bool run_one();
+	PoolTask* find_task(std::size_t self);
+	void worker_loop(std::size_t index);
+	double measure_nanos_per_lane();
+
+	std::vector<std::unique_ptr<WorkStealingDeque>> m_deques;
+	std::vector<std::thread> m_workers;
+	double m_nanosPerLane = 0;
+	UnfilterCosts m_unfilterNanos {};
+
+	// Tasks from threads outside the pool, or from a worker whose deque is full
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<PoolTask*> m_injected;
+	std::atomic<std::size_t> m_queued { 0 };
+	// Workers waiting on m_wake, push only takes the lock to notify when there are any
+	std::atomic<std::size_t> m_sleepers { 0 };
+	bool m_stop = false;
+};
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "utility/export.hpp"
+
+namespace trv
+{
+// Records the decoder's stages as Chrome trace events, viewable in chrome://tracing or Perfetto.
+// Setting the TRV_TRACE environment variable to a path traces the whole process and writes the
+// file at exit. Each thread appends to a buffer of its own without locking.
+
+// Starts recording, events recorded since an earlier start that weren't written are dropped.
+DLL_PUBLIC void start_tracing(const std::string& path);
+
+// Stops recording and writes every event recorded since start_tracing to its path.
+DLL_PUBLIC void stop_tracing();
+
+[[nodiscard]] DLL_PUBLIC bool tracing();
+
+// Names the calling thread in the trace, copied so name may be temporary.
+DLL_PUBLIC void set_trace_thread_name(const std::string& name);
+
+// Nanoseconds on the clock trace events are timed with.
+[[nodiscard]] DLL_PUBLIC std::uint64_t trace_clock();
+
+// Appends a complete event to the calling thread's buffer. name and argName must outlive the
+// trace, string literals in practice, argName may be null.
+DLL_PUBLIC void record_trace(const char* name, std::uint64_t start, std::uint64_t end,
+                             const char* argName, std::uint64_t arg);
+
+// Records its lifetime as one event when tracing was on at construction.
+class TraceScope
+{
+   public:
+	explicit TraceScope(const char* name, const char* argName = nullptr, std::uint64_t arg = 0) :
+	    m_name(tracing() ? name : nullptr), m_argName(argName), m_arg(arg)
+	{
+		if (m_name)
+		{
+			m_start = trace_clock();
+		}
+	}
+
+	TraceScope(const TraceScope&)            = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+	~TraceScope()
+	{
+		if (m_name)
+		{
+			record_trace(m_name, m_start, trace_clock(), m_argName, m_arg);
+		}
+	}
+
+	// For arguments only known once the scope's work has started
+	void set_arg(const char* argName, std::uint64_t arg)
+	{
+		m_argName = argName;
+		m_arg     = arg;
+	}
+
+   private:
+	const char* m_name;
+	const char* m_argName;
+	std::uint64_t m_arg;
+	std::uint64_t m_start = 0;
+};
+}
@@ -4,11 +4,16 @@
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <vector>
 
 #include "Common.hpp"
+#include "Stats.hpp"
 
 namespace trv
 {
@@ -29,20 +34,34 @@ enum class BTYPES : std::uint8_t
 	Err         = 0x03
 };
 
-struct DeflateArgs
+struct InflateTables;
+
+// Output is a vector of any allocator, std::allocator and std::pmr::polymorphic_allocator are
+// instantiated.
+template <typename Allocator>
+struct BasicDeflateArgs
 {
 	typedef std::vector<unsigned char> Bytes;
+	typedef std::vector<unsigned char, Allocator> Output;
 	bool png;
 	const Bytes& input;
-	Bytes& output;
+	Output& output;
+	// Inflating stops early once output holds at least this many bytes
+	std::size_t outputLimit = SIZE_MAX;
+	// Dynamic block tables are rebuilt in here instead of being allocated per block when set
+	InflateTables* tables = nullptr;
+	// Receives the block, table and match counts when set
+	DecodeStats* stats = nullptr;
 
-	DeflateArgs(bool png, const Bytes& input, Bytes& output) :
+	BasicDeflateArgs(bool png, const Bytes& input, Output& output) :
 	    png(png), input(input), output(output) {};
-	DeflateArgs(bool png, const Bytes&& input, Bytes& output)  = delete;
-	DeflateArgs(bool png, const Bytes& input, Bytes&& output)  = delete;
-	DeflateArgs(bool png, const Bytes&& input, Bytes&& output) = delete;
+	BasicDeflateArgs(bool png, const Bytes&& input, Output& output)  = delete;
+	BasicDeflateArgs(bool png, const Bytes& input, Output&& output)  = delete;
+	BasicDeflateArgs(bool png, const Bytes&& input, Output&& output) = delete;
 };
 
+typedef BasicDeflateArgs<std::allocator<unsigned char>> DeflateArgs;
+
 inline constexpr std::array<uint16_t, 29 * 2> lengthExtraTable = {
 	//Initial ExtraBits
 	3,   0,  // 257 |  0
@@ -123,7 +142,7 @@ inline constexpr std::uint16_t FIXED_LIT_144_255_OFFSET = 144;
 inline constexpr std::uint16_t FIXED_LIT_144_255_LENGTH = 9;
 
 inline constexpr std::uint16_t FIXED_LIT_256_279_LOWER  = 0b000000000;
-inline constexpr std::uint16_t FIXED_LIT_256_279_UPPER  = 0b001011100;
+inline constexpr std::uint16_t FIXED_LIT_256_279_UPPER  = 0b001011111;
 inline constexpr std::uint16_t FIXED_LIT_256_279_ROOT   = 0b0000000;
 inline constexpr std::uint16_t FIXED_LIT_256_279_OFFSET = 256;
 inline constexpr std::uint16_t FIXED_LIT_256_279_LENGTH = 7;
@@ -149,24 +168,36 @@ struct Huffman
 		std::uint16_t bitsUsed;
 	};
 
-	Huffman(uint8_t maxCodeLengthInBits, std::uint32_t symbolCount, T* symbolCodeLength) :
-	    m_maxCodeLengthInBits(maxCodeLengthInBits), m_entries(1ull << maxCodeLengthInBits)
+	Huffman() = default;
+
+	Huffman(uint8_t maxCodeLengthInBits, std::uint32_t symbolCount, T* symbolCodeLength)
+	{
+		build(maxCodeLengthInBits, symbolCount, symbolCodeLength);
+	};
+
+	// Replaces the table, the entries keep their capacity so a rebuilt table doesn't allocate.
+	void build(uint8_t maxCodeLengthInBits, std::uint32_t symbolCount, T* symbolCodeLength)
 	{
-		std::vector<T> codeLengthHistogram(maxCodeLengthInBits);
+		assert(maxCodeLengthInBits <= maxCodeLength);
+
+		m_maxCodeLengthInBits = maxCodeLengthInBits;
+		m_entries.assign(1ull << maxCodeLengthInBits, Entry {});
+
+		std::array<T, maxCodeLength> codeLengthHistogram {};
 
 		for (uint32_t symbolIndex = 0; symbolIndex < symbolCount; ++symbolIndex)
 		{
 			assert(symbolCodeLength[symbolIndex] < maxCodeLengthInBits);
 			++codeLengthHistogram[symbolCodeLength[symbolIndex]];
 			assert((symbolCodeLength[symbolIndex] == 0) ||
-			       (codeLengthHistogram[symbolCodeLength[symbolIndex]] <
+			       (codeLengthHistogram[symbolCodeLength[symbolIndex]] <=
 			        (static_cast<T>(1) << symbolCodeLength[symbolIndex])));
 		}
 
-		std::vector<T> nextCode(codeLengthHistogram.size());
+		std::array<T, maxCodeLength> nextCode {};
 		codeLengthHistogram[0] = 0;
 
-		for (uint32_t bit = 1; bit < nextCode.size(); ++bit)
+		for (uint32_t bit = 1; bit < maxCodeLengthInBits; ++bit)
 		{
 			nextCode[bit] = (nextCode[bit - 1] + codeLengthHistogram[bit - 1]) << 1;
 		}
@@ -214,9 +245,79 @@ struct Huffman
 	};
 
    private:
-	std::uint32_t m_maxCodeLengthInBits;
+	static constexpr std::uint8_t maxCodeLength = 16;
+
+	std::uint32_t m_maxCodeLengthInBits = 0;
 	std::vector<Entry> m_entries;
 };
 
-void decompress(DeflateArgs& args);
+// Huffman tables of a dynamic block, reused by every block of a stream and by a Decoder across
+// streams.
+struct InflateTables
+{
+	Huffman<uint32_t> litLen, dist;
+};
+
+// Adds size bytes at data to the running checksum adler, which starts at 1.
+[[nodiscard]] std::uint32_t adler32(std::uint32_t adler, const std::uint8_t* data,
+                                    std::size_t size);
+
+// Inflates args.input into args.output and checks the ADLER32 trailer, unless outputLimit stopped
+// it early.
+template <typename Allocator>
+void decompress(BasicDeflateArgs<Allocator>& args);
+
+// Incremental zlib decoder for input that arrives in pieces, such as one IDAT chunk at a time.
+// Only the 32 KiB window of past output is kept, input is pulled from source whenever less than
+// a block header's worth of it is buffered.
+class Inflater
+{
+   public:
+	// Appends more compressed data to its argument, returns false once there is none left
+	typedef std::function<bool(std::vector<unsigned char>&)> Source;
+
+	Inflater(bool png, Source source);
+
+	Inflater(const Inflater&)            = delete;
+	Inflater& operator=(const Inflater&) = delete;
+
+	// Writes the next count bytes of output to dst, returns fewer only once the stream has ended.
+	[[nodiscard]] std::size_t read(std::uint8_t* dst, std::size_t count);
+
+   private:
+	enum class State : std::uint8_t
+	{
+		BlockHeader,
+		Stored,
+		Codes,
+		Done
+	};
+
+	static constexpr std::size_t windowSize = 1u << 15;
+
+	void fill(std::size_t bytes);
+
+	void put(std::uint8_t*& dst, std::uint8_t byte)
+	{
+		*dst++                                    = byte;
+		m_window[m_written++ & (windowSize - 1u)] = byte;
+	}
+
+	Source m_source;
+	std::vector<unsigned char> m_input;
+	BitConsumer<std::endian::little> m_consumer;
+	std::size_t m_inputEnd = 0;
+	bool m_exhausted       = false;
+
+	State m_state                   = State::BlockHeader;
+	bool m_final                    = false;
+	std::uint16_t m_storedRemaining = 0;
+	std::uint16_t m_matchRemaining  = 0;
+	std::uint16_t m_matchDistance   = 0;
+	bool m_dynamic                  = false;
+	InflateTables m_tables;
+
+	std::vector<std::uint8_t> m_window;
+	std::size_t m_written = 0;
+};
 }
@@ -0,0 +1,88 @@
+#include "Allocation.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace trv
+{
+AlignedResource::AlignedResource(std::size_t alignment,
+                                 std::size_t hugePageThreshold,
+                                 std::pmr::memory_resource* upstream) :
+    m_alignment(alignment), m_hugePageThreshold(hugePageThreshold), m_upstream(upstream)
+{
+	if (!alignment || (alignment & (alignment - 1)))
+	{
+		throw std::runtime_error(
+		    "TRV::ALLOCATION::ALIGNED_RESOURCE - Alignment must be a power of two.");
+	}
+}
+
+std::pair<std::size_t, std::size_t> AlignedResource::upstream_layout(std::size_t bytes,
+                                                                     std::size_t alignment) const
+{
+	alignment = std::max(alignment, m_alignment);
+
+	if (m_hugePageThreshold && bytes >= m_hugePageThreshold)
+	{
+		// Whole huge pages, so that advising them can't touch a neighbouring allocation
+		alignment = std::max(alignment, hugePageSize);
+		bytes     = (bytes + hugePageSize - 1) & ~(hugePageSize - 1);
+	}
+
+	return { bytes, alignment };
+}
+
+std::size_t AlignedResource::allocated() const noexcept
+{
+	return m_allocated.load(std::memory_order_relaxed);
+}
+
+std::size_t AlignedResource::peak() const noexcept
+{
+	return m_peak.load(std::memory_order_relaxed);
+}
+
+void AlignedResource::reset_peak() noexcept
+{
+	m_peak.store(allocated(), std::memory_order_relaxed);
+}
+
+void* AlignedResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+	auto [size, align] = upstream_layout(bytes, alignment);
+	void* ptr          = m_upstream->allocate(size, align);
+
+	std::size_t now  = m_allocated.fetch_add(size, std::memory_order_relaxed) + size;
+	std::size_t peak = m_peak.load(std::memory_order_relaxed);
+
+	while (now > peak && !m_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+	{
+	}
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	if (align >= hugePageSize)
+	{
+		// Only a hint, the allocation is still usable when transparent huge pages are disabled
+		madvise(ptr, size, MADV_HUGEPAGE);
+	}
+#endif
+
+	return ptr;
+}
+
+void AlignedResource::do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment)
+{
+	auto [size, align] = upstream_layout(bytes, alignment);
+	m_upstream->deallocate(ptr, size, align);
+	m_allocated.fetch_sub(size, std::memory_order_relaxed);
+}
+
+bool AlignedResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
+}
@@ -0,0 +1,26 @@
+#include "Async.hpp"
+
+#include "ThreadPool.hpp"
+
+namespace trv
+{
+void run_on(const Executor& executor, std::function<void()> work)
+{
+	if (executor)
+	{
+		executor(std::move(work));
+		return;
+	}
+
+	ThreadPool& pool = ThreadPool::instance();
+
+	if (pool.size())
+	{
+		pool.submit(std::move(work));
+	}
+	else
+	{
+		work();
+	}
+}
+}
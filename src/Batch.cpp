@@ -0,0 +1,225 @@
+#include "Batch.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+namespace trv
+{
+// Images between being read and delivered, reading waits for a slot before starting another.
+class InFlight
+{
+   public:
+	explicit InFlight(std::size_t limit) : m_limit(std::max<std::size_t>(limit, 1)) {}
+
+	void acquire()
+	{
+		std::unique_lock lock(m_mutex);
+		m_released.wait(lock, [this]() { return m_count < m_limit; });
+		++m_count;
+	}
+
+	// Notified under the lock, wait_idle can't return and destroy this any earlier.
+	void release()
+	{
+		std::lock_guard lock(m_mutex);
+		--m_count;
+		m_released.notify_all();
+	}
+
+	void wait_idle()
+	{
+		std::unique_lock lock(m_mutex);
+		m_released.wait(lock, [this]() { return m_count == 0; });
+	}
+
+   private:
+	std::size_t m_limit;
+	std::size_t m_count = 0;
+	std::mutex m_mutex;
+	std::condition_variable m_released;
+};
+
+typedef std::unique_ptr<BatchItem> ItemPtr;
+
+void run_batch(std::span<const ImageSource> sources, const DecodeOptions& options,
+               const BatchOptions& batch, std::size_t sampleSize,
+               const std::function<void(BatchItem&)>& finish)
+{
+	ThreadPool* named = options.parallelism ? options.parallelism->pool : nullptr;
+	ThreadPool& pool  = named ? *named : ThreadPool::instance();
+	InFlight inFlight(batch.maxInFlight ? batch.maxInFlight : 2 * (pool.size() + 1));
+
+	std::atomic<std::size_t> nextSource { 0 };
+	std::atomic<bool> cancelled { false };
+	std::mutex errorMutex;
+	std::exception_ptr batchError;
+
+	auto fail = [&](std::exception_ptr error)
+	{
+		std::lock_guard lock(errorMutex);
+
+		if (!batchError)
+		{
+			batchError = error;
+		}
+		cancelled.store(true, std::memory_order_relaxed);
+	};
+
+	// A stage records its exception on the item, later stages pass it on untouched. Nothing is
+	// started for an image once the batch is cancelled.
+	auto stage = [&](BatchItem& item, auto&& work)
+	{
+		if (item.error || cancelled.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+
+		try
+		{
+			work(item);
+		}
+		catch (...)
+		{
+			item.error = std::current_exception();
+		}
+	};
+
+	// Parses, inflates and decodes a read image, then frees it and its slot
+	auto process = [&](ItemPtr item)
+	{
+		stage(*item,
+		      [&](BatchItem& item)
+		      {
+			      std::vector<ChunkType> sequence;
+			      const auto* buffer =
+			          std::get_if<std::span<const unsigned char>>(&sources[item.index]);
+
+			      read_chunks(buffer ? *buffer : std::span<const unsigned char>(item.file),
+			                  item.chunks, sequence, options);
+			      item.file = {};
+		      });
+
+		stage(*item,
+		      [&](BatchItem& item)
+		      {
+			      ImageInfo info        = image_info(item.chunks, options);
+			      std::size_t rowStride = packed_row_stride(options, info.width, info.channels);
+
+			      check_plane_pitch(info, rowStride, options);
+			      reserve_memory(item.chunks, options,
+			                     output_size(options, info.width, info.height, info.channels,
+			                                 rowStride) *
+			                         sampleSize);
+
+			      decompress_image(item.chunks, options, item.decompressed);
+			      item.chunks.image_data.reset();
+		      });
+
+		if (!cancelled.load(std::memory_order_relaxed))
+		{
+			TraceScope trace("decode_image", "image", item->index);
+
+			try
+			{
+				finish(*item);
+			}
+			catch (...)
+			{
+				fail(std::current_exception());
+			}
+		}
+
+		item.reset();
+		inFlight.release();
+	};
+
+	// Runs on the calling thread and readThreads - 1 more, file I/O never blocks a pool worker
+	auto read = [&]()
+	{
+		for (std::size_t index = nextSource++;
+		     index < sources.size() && !cancelled.load(std::memory_order_relaxed);
+		     index = nextSource++)
+		{
+			inFlight.acquire();
+
+			try
+			{
+				ItemPtr item = std::make_unique<BatchItem>();
+				item->index  = index;
+
+				if (const std::string* path = std::get_if<std::string>(&sources[index]))
+				{
+					TraceScope trace("read_file", "image", index);
+
+					try
+					{
+						item->file = read_file(*path);
+					}
+					catch (...)
+					{
+						item->error = std::current_exception();
+					}
+				}
+
+				// Without workers nothing would run the task, the reading thread decodes instead
+				if (!pool.size())
+				{
+					process(std::move(item));
+					continue;
+				}
+
+				pool.submit([&process, item = std::move(item)]() mutable
+				            { process(std::move(item)); });
+			}
+			catch (...)
+			{
+				inFlight.release();
+				fail(std::current_exception());
+			}
+		}
+	};
+
+	std::vector<std::thread> readers;
+
+	try
+	{
+		for (size_t thread = 1; thread < batch.readThreads; ++thread)
+		{
+			readers.emplace_back(
+			    [&read, thread]()
+			    {
+				    if (tracing())
+				    {
+					    set_trace_thread_name("read " + std::to_string(thread));
+				    }
+
+				    read();
+			    });
+		}
+
+		read();
+	}
+	catch (...)
+	{
+		fail(std::current_exception());
+	}
+
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+
+	inFlight.wait_idle();
+
+	if (batchError)
+	{
+		std::rethrow_exception(batchError);
+	}
+}
+}
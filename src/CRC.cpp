@@ -0,0 +1,109 @@
+#include "CRC.hpp"
+
+#include "Cpu.hpp"
+
+#ifdef TRV_PNG_X86
+#include <immintrin.h>
+#endif
+
+namespace trv
+{
+static constexpr CRCTable scalarTable {};
+
+static std::uint32_t crc32_scalar(std::uint32_t crc, const void* buf, std::size_t len)
+{
+	return scalarTable.update_crc(crc, buf, len);
+}
+
+#ifdef TRV_PNG_X86
+// x^128 fold of acc, multiplied by the constants in k, into next.
+TRV_PNG_TARGET("sse4.1,pclmul")
+static __m128i fold(__m128i acc, __m128i k, __m128i next)
+{
+	__m128i lo = _mm_clmulepi64_si128(acc, k, 0x00);
+	__m128i hi = _mm_clmulepi64_si128(acc, k, 0x11);
+	return _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+}
+
+TRV_PNG_TARGET("sse4.1,pclmul")
+static __m128i load(const std::uint8_t* at)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(at));
+}
+
+// Folds four 128 bit lanes of the message with carry-less multiplies by x^(k) mod P and reduces
+// the last lane with Barrett reduction, as in Intel's "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ". Constants are for the bit reflected polynomial 0xEDB88320.
+TRV_PNG_TARGET("sse4.1,pclmul")
+static std::uint32_t crc32_pclmul(std::uint32_t crc, const void* buf, std::size_t len)
+{
+	const auto* data = static_cast<const std::uint8_t*>(buf);
+
+	if (len < 64)
+	{
+		return crc32_scalar(crc, data, len);
+	}
+
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+	const __m128i low  = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	__m128i x1 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(crc)));
+	__m128i x2 = load(data + 16);
+	__m128i x3 = load(data + 32);
+	__m128i x4 = load(data + 48);
+
+	data += 64;
+	len -= 64;
+
+	for (; len >= 64; data += 64, len -= 64)
+	{
+		x1 = fold(x1, k1k2, load(data));
+		x2 = fold(x2, k1k2, load(data + 16));
+		x3 = fold(x3, k1k2, load(data + 32));
+		x4 = fold(x4, k1k2, load(data + 48));
+	}
+
+	x1 = fold(x1, k3k4, x2);
+	x1 = fold(x1, k3k4, x3);
+	x1 = fold(x1, k3k4, x4);
+
+	for (; len >= 16; data += 16, len -= 16)
+	{
+		x1 = fold(x1, k3k4, load(data));
+	}
+
+	// 128 bits to 64
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, low), k5k0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, low), poly, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, low), poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	crc = static_cast<std::uint32_t>(_mm_extract_epi32(x1, 1));
+
+	return crc32_scalar(crc, data, len);
+}
+
+static constexpr KernelTable<std::uint32_t(std::uint32_t, const void*, std::size_t)> crcKernels {
+	crc32_scalar, crc32_scalar, crc32_pclmul, crc32_pclmul, crc32_pclmul
+};
+#else
+static constexpr KernelTable<std::uint32_t(std::uint32_t, const void*, std::size_t)> crcKernels {
+	crc32_scalar, crc32_scalar, crc32_scalar, crc32_scalar, crc32_scalar
+};
+#endif
+
+std::uint32_t crc32_update(std::uint32_t crc, const void* buf, std::size_t len)
+{
+	return select_kernel(crcKernels)(crc, buf, len);
+}
+}
@@ -38,6 +38,18 @@ void verifyOrdering(const Chunk<IHDR>* header, const std::vector<ChunkType>& seq
 			    "TRV::PNG::CHUNK PLTE must be provided before IDAT with color type 3.");
 		}
 
+		if (curr == ChunkType::tRNS &&
+		    previousPosition[static_cast<std::size_t>(ChunkType::IDAT)] != 0)
+		{
+			throw std::runtime_error("TRV::PNG::CHUNK tRNS must appear before IDAT.");
+		}
+
+		if (header->data.colorType == 3 && curr == ChunkType::tRNS &&
+		    previousPosition[static_cast<std::size_t>(ChunkType::PLTE)] == 0)
+		{
+			throw std::runtime_error("TRV::PNG::CHUNK tRNS must appear after PLTE.");
+		}
+
 		if (curr == ChunkType::IDAT && previousPosition[chunk] > 0 &&
 		    previousPosition[chunk] != i - 1)
 		{
@@ -0,0 +1,156 @@
+#include "Cpu.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+#ifdef TRV_PNG_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace trv
+{
+static constexpr std::array<const char*, cpuLevels> levelNames { "scalar", "sse2", "sse4", "avx2",
+	                                                             "avx512" };
+
+#ifdef TRV_PNG_X86
+struct CpuidRegisters
+{
+	std::uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+};
+
+static CpuidRegisters cpuid(std::uint32_t leaf, std::uint32_t subleaf)
+{
+	CpuidRegisters regs;
+#ifdef _MSC_VER
+	int values[4];
+	__cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+	regs = { static_cast<std::uint32_t>(values[0]), static_cast<std::uint32_t>(values[1]),
+		     static_cast<std::uint32_t>(values[2]), static_cast<std::uint32_t>(values[3]) };
+#else
+	__cpuid_count(leaf, subleaf, regs.eax, regs.ebx, regs.ecx, regs.edx);
+#endif
+	return regs;
+}
+
+// Register state the OS saves on context switches, only valid when OSXSAVE is set
+static std::uint64_t xgetbv()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	std::uint32_t eax, edx;
+	__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return static_cast<std::uint64_t>(edx) << 32 | eax;
+#endif
+}
+
+static bool has_bits(std::uint32_t reg, std::uint32_t bits)
+{
+	return (reg & bits) == bits;
+}
+#endif
+
+CpuLevel detected_cpu_level()
+{
+#ifdef TRV_PNG_X86
+	static const CpuLevel detected = []()
+	{
+		std::uint32_t maxLeaf     = cpuid(0, 0).eax;
+		std::uint32_t maxExtended = cpuid(0x80000000, 0).eax;
+		CpuidRegisters basic      = cpuid(1, 0);
+		CpuidRegisters ext        = maxLeaf >= 7 ? cpuid(7, 0) : CpuidRegisters {};
+		CpuidRegisters amd        = maxExtended >= 0x80000001 ? cpuid(0x80000001, 0)
+		                                                      : CpuidRegisters {};
+
+		// SSE2 in edx; PCLMULQDQ, SSSE3, SSE4.1, OSXSAVE and AVX in ecx
+		if (!has_bits(basic.edx, 1u << 26))
+		{
+			return CpuLevel::Scalar;
+		}
+
+		if (!has_bits(basic.ecx, 1u << 1 | 1u << 9 | 1u << 19))
+		{
+			return CpuLevel::SSE2;
+		}
+
+		// The OS has to save the YMM registers, and the ZMM and mask registers for AVX-512
+		std::uint64_t xcr0 = has_bits(basic.ecx, 1u << 27) ? xgetbv() : 0;
+
+		// AVX2, BMI1 and BMI2 in ebx, and LZCNT (ABM) in extended ecx, which older CPUs would run
+		// as BSR instead of faulting
+		if (!has_bits(basic.ecx, 1u << 28) || (xcr0 & 0x6) != 0x6 ||
+		    !has_bits(ext.ebx, 1u << 3 | 1u << 5 | 1u << 8) || !has_bits(amd.ecx, 1u << 5))
+		{
+			return CpuLevel::SSE4;
+		}
+
+		// AVX-512 F, BW and VL in ebx
+		if ((xcr0 & 0xE6) != 0xE6 || !has_bits(ext.ebx, 1u << 16 | 1u << 30 | 1u << 31))
+		{
+			return CpuLevel::AVX2;
+		}
+
+		return CpuLevel::AVX512;
+	}();
+
+	return detected;
+#else
+	return CpuLevel::Scalar;
+#endif
+}
+
+static std::atomic<CpuLevel>& current_level()
+{
+	static std::atomic<CpuLevel> level = []()
+	{
+		CpuLevel detected = detected_cpu_level();
+#ifdef _MSC_VER
+#pragma warning(suppress : 4996)
+#endif
+		const char* forced = std::getenv("TRV_CPU_LEVEL");
+
+		if (!forced)
+		{
+			return detected;
+		}
+
+		return std::min(parse_cpu_level(forced).value_or(detected), detected);
+	}();
+
+	return level;
+}
+
+CpuLevel cpu_level()
+{
+	return current_level().load(std::memory_order_relaxed);
+}
+
+CpuLevel set_cpu_level(CpuLevel level)
+{
+	level = std::min(level, detected_cpu_level());
+	current_level().store(level, std::memory_order_relaxed);
+	return level;
+}
+
+const char* cpu_level_name(CpuLevel level)
+{
+	return levelNames[static_cast<std::size_t>(level)];
+}
+
+std::optional<CpuLevel> parse_cpu_level(std::string_view name)
+{
+	auto found = std::find(levelNames.begin(), levelNames.end(), name);
+
+	if (found == levelNames.end())
+	{
+		return std::nullopt;
+	}
+
+	return static_cast<CpuLevel>(found - levelNames.begin());
+}
+}
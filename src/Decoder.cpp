@@ -0,0 +1,28 @@
+#include "Decoder.hpp"
+
+namespace trv
+{
+DecodeOptions Decoder::resolve(const DecodeOptions& options) const
+{
+	DecodeOptions resolved = options;
+
+	if (!resolved.parallelism)
+	{
+		resolved.parallelism = m_parallelism;
+	}
+
+	return resolved;
+}
+
+ImageInfo Decoder::read(const std::string& path, const DecodeOptions& options)
+{
+	read_chunks(path, m_chunks, m_sequence, options);
+
+	return image_info(m_chunks, options);
+}
+
+void Decoder::inflate(const DecodeOptions& options)
+{
+	decompress_image(m_chunks, options, m_decompressed, &m_tables);
+}
+}
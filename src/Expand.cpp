@@ -0,0 +1,242 @@
+#include "Expand.hpp"
+
+#include "Cpu.hpp"
+
+#ifdef TRV_PNG_X86
+#include <immintrin.h>
+#endif
+
+namespace trv
+{
+static void widen_8_to_16_scalar(const std::uint8_t* src, std::uint16_t* dst, std::size_t samples)
+{
+	for (std::size_t sample = 0; sample < samples; ++sample)
+	{
+		dst[sample] = convertBitDepth<8, uint16_t>(src[sample]);
+	}
+}
+
+static void byteswap_16_scalar(const std::uint8_t* src, std::uint16_t* dst, std::size_t samples)
+{
+	for (std::size_t sample = 0; sample < samples; ++sample)
+	{
+		dst[sample] = static_cast<uint16_t>(src[sample * 2] << 8 | src[sample * 2 + 1]);
+	}
+}
+
+static void narrow_16_to_8_scalar(const std::uint8_t* src, std::uint8_t* dst, std::size_t samples)
+{
+	for (std::size_t sample = 0; sample < samples; ++sample)
+	{
+		std::uint32_t val = static_cast<uint32_t>(src[sample * 2] << 8 | src[sample * 2 + 1]);
+		dst[sample]       = convertBitDepth<16, uint8_t>(val);
+	}
+}
+
+#ifdef TRV_PNG_X86
+// Bound by the stores, wider registers measured no faster.
+TRV_PNG_TARGET("sse2")
+static void widen_8_to_16_sse2(const std::uint8_t* src, std::uint16_t* dst, std::size_t samples)
+{
+	std::size_t sample = 0;
+
+	// Interleaving a byte with itself yields val << 8 | val, which is val * 257
+	for (; sample + 16 <= samples; sample += 16)
+	{
+		__m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + sample));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + sample), _mm_unpacklo_epi8(in, in));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + sample + 8), _mm_unpackhi_epi8(in, in));
+	}
+
+	widen_8_to_16_scalar(src + sample, dst + sample, samples - sample);
+}
+
+TRV_PNG_TARGET("sse2")
+static void byteswap_16_sse2(const std::uint8_t* src, std::uint16_t* dst, std::size_t samples)
+{
+	std::size_t sample = 0;
+
+	for (; sample + 16 <= samples; sample += 16)
+	{
+		__m128i in0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + sample * 2));
+		__m128i in1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + sample * 2 + 16));
+
+		in0 = _mm_or_si128(_mm_slli_epi16(in0, 8), _mm_srli_epi16(in0, 8));
+		in1 = _mm_or_si128(_mm_slli_epi16(in1, 8), _mm_srli_epi16(in1, 8));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + sample), in0);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + sample + 8), in1);
+	}
+
+	byteswap_16_scalar(src + sample * 2, dst + sample, samples - sample);
+}
+
+TRV_PNG_TARGET("ssse3")
+static void byteswap_16_ssse3(const std::uint8_t* src, std::uint16_t* dst, std::size_t samples)
+{
+	const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+	std::size_t sample = 0;
+
+	for (; sample + 8 <= samples; sample += 8)
+	{
+		__m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + sample * 2));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + sample), _mm_shuffle_epi8(in, swap));
+	}
+
+	byteswap_16_scalar(src + sample * 2, dst + sample, samples - sample);
+}
+
+TRV_PNG_TARGET("avx2")
+static void byteswap_16_avx2(const std::uint8_t* src, std::uint16_t* dst, std::size_t samples)
+{
+	const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1,
+	                                      0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+	std::size_t sample = 0;
+
+	for (; sample + 16 <= samples; sample += 16)
+	{
+		__m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + sample * 2));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + sample),
+		                    _mm256_shuffle_epi8(in, swap));
+	}
+
+	byteswap_16_ssse3(src + sample * 2, dst + sample, samples - sample);
+}
+
+TRV_PNG_TARGET("avx2,avx512f,avx512bw")
+static void byteswap_16_avx512(const std::uint8_t* src, std::uint16_t* dst, std::size_t samples)
+{
+	// 1, 0, 3, 2, ... 15, 14 in every 128 bit lane
+	const std::int64_t low  = 0x0607040502030001;
+	const std::int64_t high = 0x0E0F0C0D0A0B0809;
+	const __m512i swap      = _mm512_set_epi64(high, low, high, low, high, low, high, low);
+
+	std::size_t sample = 0;
+
+	for (; sample + 32 <= samples; sample += 32)
+	{
+		__m512i in = _mm512_loadu_si512(src + sample * 2);
+		_mm512_storeu_si512(dst + sample, _mm512_shuffle_epi8(in, swap));
+	}
+
+	byteswap_16_avx2(src + sample * 2, dst + sample, samples - sample);
+}
+
+// With val = 257 * hi + (lo - hi), round(val / 257) is hi corrected by one whenever
+// |lo - hi| > 128. hi and lo come straight from the big-endian byte pair.
+TRV_PNG_TARGET("sse2")
+static void narrow_16_to_8_sse2(const std::uint8_t* src, std::uint8_t* dst, std::size_t samples)
+{
+	const __m128i lowMask = _mm_set1_epi16(0x00FF);
+	const __m128i roundUp = _mm_set1_epi16(128);
+	const __m128i roundDn = _mm_set1_epi16(-128);
+
+	std::size_t sample = 0;
+
+	for (; sample + 16 <= samples; sample += 16)
+	{
+		__m128i in0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + sample * 2));
+		__m128i in1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + sample * 2 + 16));
+
+		__m128i hi0 = _mm_and_si128(in0, lowMask);
+		__m128i hi1 = _mm_and_si128(in1, lowMask);
+		__m128i lo0 = _mm_srli_epi16(in0, 8);
+		__m128i lo1 = _mm_srli_epi16(in1, 8);
+
+		__m128i diff0 = _mm_sub_epi16(lo0, hi0);
+		__m128i diff1 = _mm_sub_epi16(lo1, hi1);
+
+		// Comparison masks are -1 where true
+		hi0 = _mm_sub_epi16(hi0, _mm_cmpgt_epi16(diff0, roundUp));
+		hi1 = _mm_sub_epi16(hi1, _mm_cmpgt_epi16(diff1, roundUp));
+		hi0 = _mm_add_epi16(hi0, _mm_cmplt_epi16(diff0, roundDn));
+		hi1 = _mm_add_epi16(hi1, _mm_cmplt_epi16(diff1, roundDn));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + sample), _mm_packus_epi16(hi0, hi1));
+	}
+
+	narrow_16_to_8_scalar(src + sample * 2, dst + sample, samples - sample);
+}
+
+// narrow_16_to_8_sse2 on twice the samples, VPACKUSWB packs within 128 bit lanes so the quadwords
+// are put back in order afterwards.
+TRV_PNG_TARGET("avx2")
+static void narrow_16_to_8_avx2(const std::uint8_t* src, std::uint8_t* dst, std::size_t samples)
+{
+	const __m256i lowMask = _mm256_set1_epi16(0x00FF);
+	const __m256i roundUp = _mm256_set1_epi16(128);
+	const __m256i roundDn = _mm256_set1_epi16(-128);
+
+	std::size_t sample = 0;
+
+	for (; sample + 32 <= samples; sample += 32)
+	{
+		__m256i in0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + sample * 2));
+		__m256i in1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + sample * 2 + 32));
+
+		__m256i hi0 = _mm256_and_si256(in0, lowMask);
+		__m256i hi1 = _mm256_and_si256(in1, lowMask);
+
+		__m256i diff0 = _mm256_sub_epi16(_mm256_srli_epi16(in0, 8), hi0);
+		__m256i diff1 = _mm256_sub_epi16(_mm256_srli_epi16(in1, 8), hi1);
+
+		hi0 = _mm256_sub_epi16(hi0, _mm256_cmpgt_epi16(diff0, roundUp));
+		hi1 = _mm256_sub_epi16(hi1, _mm256_cmpgt_epi16(diff1, roundUp));
+		hi0 = _mm256_add_epi16(hi0, _mm256_cmpgt_epi16(roundDn, diff0));
+		hi1 = _mm256_add_epi16(hi1, _mm256_cmpgt_epi16(roundDn, diff1));
+
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(hi0, hi1),
+		                                          _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + sample), packed);
+	}
+
+	narrow_16_to_8_sse2(src + sample * 2, dst + sample, samples - sample);
+}
+
+static constexpr KernelTable<void(const std::uint8_t*, std::uint16_t*, std::size_t)> widenKernels {
+	widen_8_to_16_scalar, widen_8_to_16_sse2, widen_8_to_16_sse2, widen_8_to_16_sse2,
+	widen_8_to_16_sse2
+};
+
+static constexpr KernelTable<void(const std::uint8_t*, std::uint16_t*, std::size_t)> swapKernels {
+	byteswap_16_scalar, byteswap_16_sse2, byteswap_16_ssse3, byteswap_16_avx2, byteswap_16_avx512
+};
+
+static constexpr KernelTable<void(const std::uint8_t*, std::uint8_t*, std::size_t)> narrowKernels {
+	narrow_16_to_8_scalar, narrow_16_to_8_sse2, narrow_16_to_8_sse2, narrow_16_to_8_avx2,
+	narrow_16_to_8_avx2
+};
+#else
+static constexpr KernelTable<void(const std::uint8_t*, std::uint16_t*, std::size_t)> widenKernels {
+	widen_8_to_16_scalar, widen_8_to_16_scalar, widen_8_to_16_scalar, widen_8_to_16_scalar,
+	widen_8_to_16_scalar
+};
+
+static constexpr KernelTable<void(const std::uint8_t*, std::uint16_t*, std::size_t)> swapKernels {
+	byteswap_16_scalar, byteswap_16_scalar, byteswap_16_scalar, byteswap_16_scalar,
+	byteswap_16_scalar
+};
+
+static constexpr KernelTable<void(const std::uint8_t*, std::uint8_t*, std::size_t)> narrowKernels {
+	narrow_16_to_8_scalar, narrow_16_to_8_scalar, narrow_16_to_8_scalar, narrow_16_to_8_scalar,
+	narrow_16_to_8_scalar
+};
+#endif
+
+void widen_8_to_16(const std::uint8_t* src, std::uint16_t* dst, std::size_t samples)
+{
+	select_kernel(widenKernels)(src, dst, samples);
+}
+
+void byteswap_16(const std::uint8_t* src, std::uint16_t* dst, std::size_t samples)
+{
+	select_kernel(swapKernels)(src, dst, samples);
+}
+
+void narrow_16_to_8(const std::uint8_t* src, std::uint8_t* dst, std::size_t samples)
+{
+	select_kernel(narrowKernels)(src, dst, samples);
+}
+}
@@ -1,7 +1,18 @@
 #include "Filter.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+#include "Cpu.hpp"
 #include "Image.hpp"
 
+#ifdef TRV_PNG_X86
+#include <immintrin.h>
+#endif
+
 namespace trv
 {
 [[nodiscard]] static std::uint8_t paethPredictor(uint8_t left,
@@ -29,7 +40,399 @@ namespace trv
 	}
 };
 
-void do_unfilter(std::vector<uint8_t>& input,
+// Reverses the filter on bytes [begin, end) of a single scanline, the filter type byte sits at
+// index 0 of both rows. prev is null on the first scanline of an image or pass.
+static void unfilter_span_scalar(std::uint8_t* curr,
+                                 const std::uint8_t* prev,
+                                 FilterMethod filterType,
+                                 std::size_t begin,
+                                 std::size_t end,
+                                 std::size_t bpp)
+{
+	if (filterType == FilterMethod::None || (filterType == FilterMethod::Up && !prev))
+	{
+		return;
+	}
+
+	for (size_t byte = begin; byte < end; ++byte)
+	{
+		std::uint8_t value = 0;
+		switch (filterType)
+		{
+			case FilterMethod::Sub:
+				{
+					if (byte <= bpp) continue;
+					std::uint8_t left = curr[byte - bpp];
+					value             = left;
+					break;
+				}
+			case FilterMethod::Up:
+				{
+					std::uint8_t top = prev[byte];
+					value            = top;
+					break;
+				}
+			case FilterMethod::Average:
+				{
+					std::uint8_t top  = 0;
+					std::uint8_t left = 0;
+
+					if (prev) top = prev[byte];
+
+					if (byte > bpp) left = curr[byte - bpp];
+
+					value = static_cast<uint8_t>(static_cast<uint16_t>(top + left) >> 1);
+					break;
+				}
+			case FilterMethod::Paeth:
+				{
+					std::uint8_t top     = 0;
+					std::uint8_t left    = 0;
+					std::uint8_t topleft = 0;
+
+					if (prev && byte > bpp) topleft = prev[byte - bpp];
+
+					if (prev) top = prev[byte];
+
+					if (byte > bpp) left = curr[byte - bpp];
+
+					value = paethPredictor(left, top, topleft);
+					break;
+				}
+			default:
+				throw std::runtime_error(
+				    "TRV::IMAGE::LOAD_IMAGE Encountered unexpected filter "
+				    "type.");
+				break;
+		}
+
+		curr[byte] += value;
+	}
+}
+
+#ifdef TRV_PNG_X86
+// A pixel of Bpp bytes in the low bytes of a register, bytes past the pixel are never touched.
+// Pixels of 3 and 6 bytes are put together from 2 and 4 byte pieces in general purpose registers,
+// a round trip through memory would stall on store forwarding every pixel.
+template <std::size_t Bpp>
+TRV_PNG_TARGET("ssse3,sse4.1")
+static __m128i load_pixel(const std::uint8_t* at)
+{
+	std::uint32_t low  = 0;
+	std::uint16_t high = 0;
+
+	if constexpr (Bpp == 3)
+	{
+		std::memcpy(&high, at, 2);
+		return _mm_cvtsi32_si128(static_cast<int>(high | std::uint32_t { at[2] } << 16));
+	}
+	else if constexpr (Bpp == 4)
+	{
+		std::memcpy(&low, at, 4);
+		return _mm_cvtsi32_si128(static_cast<int>(low));
+	}
+	else if constexpr (Bpp == 6)
+	{
+		std::memcpy(&low, at, 4);
+		std::memcpy(&high, at + 4, 2);
+		return _mm_insert_epi16(_mm_cvtsi32_si128(static_cast<int>(low)), high, 2);
+	}
+	else
+	{
+		return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(at));
+	}
+}
+
+template <std::size_t Bpp>
+TRV_PNG_TARGET("ssse3,sse4.1")
+static void store_pixel(std::uint8_t* at, __m128i pixel)
+{
+	std::uint32_t low = static_cast<std::uint32_t>(_mm_cvtsi128_si32(pixel));
+
+	if constexpr (Bpp == 3)
+	{
+		std::memcpy(at, &low, 2);
+		at[2] = static_cast<std::uint8_t>(low >> 16);
+	}
+	else if constexpr (Bpp == 4)
+	{
+		std::memcpy(at, &low, 4);
+	}
+	else if constexpr (Bpp == 6)
+	{
+		std::uint16_t high = static_cast<std::uint16_t>(_mm_extract_epi16(pixel, 2));
+		std::memcpy(at, &low, 4);
+		std::memcpy(at + 4, &high, 2);
+	}
+	else
+	{
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(at), pixel);
+	}
+}
+
+// Unfilters the whole pixels from byte, which starts a pixel after the first, to end. Returns
+// where the last whole pixel ended. Paeth works in 16 bit lanes, where
+// |p - a| = |b - c|, |p - b| = |a - c| and |p - c| = |(b - c) + (a - c)|.
+template <std::size_t Bpp>
+TRV_PNG_TARGET("ssse3,sse4.1")
+static std::size_t unfilter_pixels_sse4(std::uint8_t* curr,
+                                        const std::uint8_t* prev,
+                                        FilterMethod filterType,
+                                        std::size_t byte,
+                                        std::size_t end)
+{
+	__m128i left = load_pixel<Bpp>(curr + byte - Bpp);
+
+	if (filterType == FilterMethod::Sub)
+	{
+		for (; byte + Bpp <= end; byte += Bpp)
+		{
+			left = _mm_add_epi8(load_pixel<Bpp>(curr + byte), left);
+			store_pixel<Bpp>(curr + byte, left);
+		}
+	}
+	else if (filterType == FilterMethod::Average)
+	{
+		const __m128i one = _mm_set1_epi8(1);
+
+		for (; byte + Bpp <= end; byte += Bpp)
+		{
+			__m128i top = load_pixel<Bpp>(prev + byte);
+			// PAVGB rounds up, the filter rounds down
+			__m128i average = _mm_sub_epi8(_mm_avg_epu8(left, top),
+			                               _mm_and_si128(_mm_xor_si128(left, top), one));
+			left = _mm_add_epi8(load_pixel<Bpp>(curr + byte), average);
+			store_pixel<Bpp>(curr + byte, left);
+		}
+	}
+	else if (filterType == FilterMethod::Paeth)
+	{
+		__m128i a = _mm_cvtepu8_epi16(left);
+		__m128i c = _mm_cvtepu8_epi16(load_pixel<Bpp>(prev + byte - Bpp));
+
+		for (; byte + Bpp <= end; byte += Bpp)
+		{
+			__m128i b = _mm_cvtepu8_epi16(load_pixel<Bpp>(prev + byte));
+
+			__m128i fromTop  = _mm_sub_epi16(b, c);
+			__m128i fromLeft = _mm_sub_epi16(a, c);
+			__m128i pa       = _mm_abs_epi16(fromTop);
+			__m128i pb       = _mm_abs_epi16(fromLeft);
+			__m128i pc       = _mm_abs_epi16(_mm_add_epi16(fromTop, fromLeft));
+			__m128i smallest = _mm_min_epi16(_mm_min_epi16(pa, pb), pc);
+
+			__m128i predictor = _mm_blendv_epi8(c, b, _mm_cmpeq_epi16(pb, smallest));
+			predictor         = _mm_blendv_epi8(predictor, a, _mm_cmpeq_epi16(pa, smallest));
+
+			__m128i pixel = _mm_add_epi8(load_pixel<Bpp>(curr + byte),
+			                             _mm_packus_epi16(predictor, predictor));
+			store_pixel<Bpp>(curr + byte, pixel);
+
+			a = _mm_cvtepu8_epi16(pixel);
+			c = b;
+		}
+	}
+
+	return byte;
+}
+
+// Up 16 bytes at a time. Sub, Average and Paeth a pixel at a time for 3, 4, 6 and 8 bytes per
+// pixel, where a pixel fits in a register. The first pixel, the partial pixels at either end of
+// the span and every other case go to unfilter_span_scalar.
+TRV_PNG_TARGET("ssse3,sse4.1")
+static void unfilter_span_sse4(std::uint8_t* curr,
+                               const std::uint8_t* prev,
+                               FilterMethod filterType,
+                               std::size_t begin,
+                               std::size_t end,
+                               std::size_t bpp)
+{
+	bool usesLeft = filterType == FilterMethod::Sub || filterType == FilterMethod::Average ||
+	                filterType == FilterMethod::Paeth;
+	bool byPixel  = usesLeft && (prev || filterType == FilterMethod::Sub);
+
+	if (filterType == FilterMethod::Up && prev)
+	{
+		for (; begin + 16 <= end; begin += 16)
+		{
+			__m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + begin));
+			__m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(curr + begin));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(curr + begin), _mm_add_epi8(row, top));
+		}
+	}
+	else if (byPixel && (bpp == 3 || bpp == 4 || bpp == 6 || bpp == 8))
+	{
+		std::size_t first = std::max(begin, bpp + 1);
+		first             = std::min(first + (bpp - (first - 1) % bpp) % bpp, end);
+		unfilter_span_scalar(curr, prev, filterType, begin, first, bpp);
+
+		switch (bpp)
+		{
+			case 3: begin = unfilter_pixels_sse4<3>(curr, prev, filterType, first, end); break;
+			case 4: begin = unfilter_pixels_sse4<4>(curr, prev, filterType, first, end); break;
+			case 6: begin = unfilter_pixels_sse4<6>(curr, prev, filterType, first, end); break;
+			default: begin = unfilter_pixels_sse4<8>(curr, prev, filterType, first, end); break;
+		}
+	}
+
+	unfilter_span_scalar(curr, prev, filterType, begin, end, bpp);
+}
+
+// Wider Up, the other filters are bound by the previous pixel and stay on unfilter_span_sse4.
+TRV_PNG_TARGET("avx2")
+static void unfilter_span_avx2(std::uint8_t* curr,
+                               const std::uint8_t* prev,
+                               FilterMethod filterType,
+                               std::size_t begin,
+                               std::size_t end,
+                               std::size_t bpp)
+{
+	if (filterType == FilterMethod::Up && prev)
+	{
+		for (; begin + 32 <= end; begin += 32)
+		{
+			__m256i top = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + begin));
+			__m256i row = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(curr + begin));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(curr + begin),
+			                    _mm256_add_epi8(row, top));
+		}
+	}
+
+	unfilter_span_sse4(curr, prev, filterType, begin, end, bpp);
+}
+
+TRV_PNG_TARGET("avx2,avx512f,avx512bw")
+static void unfilter_span_avx512(std::uint8_t* curr,
+                                 const std::uint8_t* prev,
+                                 FilterMethod filterType,
+                                 std::size_t begin,
+                                 std::size_t end,
+                                 std::size_t bpp)
+{
+	if (filterType == FilterMethod::Up && prev)
+	{
+		for (; begin + 64 <= end; begin += 64)
+		{
+			__m512i top = _mm512_loadu_si512(prev + begin);
+			__m512i row = _mm512_loadu_si512(curr + begin);
+			_mm512_storeu_si512(curr + begin, _mm512_add_epi8(row, top));
+		}
+	}
+
+	unfilter_span_avx2(curr, prev, filterType, begin, end, bpp);
+}
+
+static constexpr KernelTable<decltype(unfilter_span_scalar)> unfilterKernels {
+	unfilter_span_scalar, unfilter_span_scalar, unfilter_span_sse4, unfilter_span_avx2,
+	unfilter_span_avx512
+};
+#else
+static constexpr KernelTable<decltype(unfilter_span_scalar)> unfilterKernels {
+	unfilter_span_scalar, unfilter_span_scalar, unfilter_span_scalar, unfilter_span_scalar,
+	unfilter_span_scalar
+};
+#endif
+
+std::array<Adam7Pass, 7> adam7_passes(std::size_t width, std::size_t height,
+                                      std::size_t bitsPerPixel)
+{
+	static constexpr std::size_t rowStart[7] { 0, 0, 4, 0, 2, 0, 1 };
+	static constexpr std::size_t colStart[7] { 0, 4, 0, 2, 0, 1, 0 };
+	static constexpr std::size_t rowStride[7] { 8, 8, 8, 4, 4, 2, 2 };
+	static constexpr std::size_t colStride[7] { 8, 8, 4, 4, 2, 2, 1 };
+
+	std::array<Adam7Pass, 7> passes {};
+	std::size_t offset = 0;
+
+	for (size_t index = 0; index < 7; ++index)
+	{
+		Adam7Pass& pass = passes[index];
+
+		pass.rowStart  = rowStart[index];
+		pass.colStart  = colStart[index];
+		pass.rowStride = rowStride[index];
+		pass.colStride = colStride[index];
+		pass.width     = (width + colStride[index] - 1 - colStart[index]) / colStride[index];
+		pass.height    = (height + rowStride[index] - 1 - rowStart[index]) / rowStride[index];
+		pass.byteWidth = (pass.width * bitsPerPixel + 7) / 8;
+		pass.byteWidth = pass.byteWidth && pass.height ? pass.byteWidth + 1 : 0;
+		pass.offset    = offset;
+
+		offset += pass.byteWidth * pass.height;
+	}
+
+	return passes;
+}
+
+std::size_t adam7_passes_needed(const DecodeOptions& options)
+{
+	if (options.previewPasses > 7)
+	{
+		throw std::runtime_error("TRV::FILTER::UNFILTER - Preview passes must be 1 to 7.");
+	}
+
+	switch (options.scale)
+	{
+		case 1:
+			return options.previewPasses ? options.previewPasses : 7;
+		case 2:
+		case 4:
+		case 8:
+			if (options.previewPasses)
+			{
+				throw std::runtime_error(
+				    "TRV::FILTER::UNFILTER - A preview can't be decoded at a reduced scale.");
+			}
+			// Passes 1, 1 to 3 and 1 to 5 hold every 8th, 4th and 2nd pixel
+			return options.scale == 8 ? 1 : options.scale == 4 ? 3 : 5;
+		default:
+			throw std::runtime_error("TRV::FILTER::UNFILTER - Scale must be 1, 2, 4 or 8.");
+	}
+}
+
+Region decode_region(const IHDR& header, const DecodeOptions& options)
+{
+	const Region& region = options.region;
+
+	if (!region.width && !region.height)
+	{
+		return { 0, 0, header.width, header.height };
+	}
+
+	if (options.scale != 1 || options.previewPasses)
+	{
+		throw std::runtime_error(
+		    "TRV::FILTER::DECODE_REGION - A region can't be combined with a preview or scale.");
+	}
+
+	if (!region.width || !region.height || region.x >= header.width ||
+	    region.y >= header.height || region.width > header.width - region.x ||
+	    region.height > header.height - region.y)
+	{
+		throw std::runtime_error(
+		    "TRV::FILTER::DECODE_REGION - Region must be a non-empty rectangle inside the image.");
+	}
+
+	return region;
+}
+
+void unfilter_row(std::uint8_t* curr,
+                  const std::uint8_t* prev,
+                  std::size_t byteWidth,
+                  std::size_t bpp)
+{
+	if (curr[0] > static_cast<uint8_t>(FilterMethod::Paeth))
+	{
+		throw std::runtime_error(
+		    "TRV::IMAGE::LOAD_IMAGE Encountered unexpected filter "
+		    "type.");
+	}
+
+	auto* unfilter = select_kernel(unfilterKernels);
+	unfilter(curr, prev, static_cast<FilterMethod>(curr[0]), 1, byteWidth, bpp);
+}
+
+void do_unfilter(std::span<uint8_t> input,
                  std::size_t offset,
                  std::size_t scanlines,
                  std::size_t byteWidth,
@@ -37,68 +440,278 @@ void do_unfilter(std::vector<uint8_t>& input,
 {
 	for (size_t scanline = 0; scanline < scanlines; ++scanline)
 	{
-		FilterMethod filterType = static_cast<FilterMethod>(input[scanline * byteWidth + offset]);
+		std::uint8_t* curr = input.data() + scanline * byteWidth + offset;
+		std::uint8_t* prev = scanline ? curr - byteWidth : nullptr;
+
+		unfilter_row(curr, prev, byteWidth, bpp);
+	}
+}
+
+// Shared state of a wavefront unfilter, progress[row] holds how many bytes of row are final.
+struct WavefrontJob
+{
+	std::uint8_t* data;
+	std::size_t scanlines;
+	std::size_t byteWidth;
+	std::size_t bpp;
+	std::size_t blockSize;
+	std::vector<std::atomic<std::size_t>> progress;
+	std::atomic<std::size_t> nextScanline { 0 };
+};
+
+// Every lane claims the next scanline nobody has started and trails the scanline above it one
+// column block at a time. Scanlines are claimed in order by running lanes, so the one a lane waits
+// on is always being worked on, however many lanes the pool actually runs at once.
+static void unfilter_lane(WavefrontJob& job)
+{
+	auto* unfilter = select_kernel(unfilterKernels);
+
+	while (true)
+	{
+		std::size_t scanline = job.nextScanline.fetch_add(1, std::memory_order_relaxed);
 
-		if (filterType == FilterMethod::None || (filterType == FilterMethod::Up && scanline == 0))
+		if (scanline >= job.scanlines)
 		{
-			continue;
+			return;
 		}
 
-		for (size_t byte = 1; byte < byteWidth; ++byte)
+		std::uint8_t* curr  = job.data + scanline * job.byteWidth;
+		std::uint8_t* prev  = scanline ? curr - job.byteWidth : nullptr;
+		FilterMethod filter = static_cast<FilterMethod>(curr[0]);
+
+		bool dependsOnPrev = prev && filter != FilterMethod::None && filter != FilterMethod::Sub;
+
+		for (size_t begin = 1; begin < job.byteWidth; begin += job.blockSize)
 		{
-			std::uint8_t value = 0;
-			switch (static_cast<FilterMethod>(filterType))
+			std::size_t end = std::min(begin + job.blockSize, job.byteWidth);
+
+			if (dependsOnPrev)
 			{
-				case FilterMethod::Sub:
-					{
-						if (byte <= bpp) continue;
-						std::uint8_t left = input[scanline * byteWidth + byte - bpp + offset];
-						value             = left;
-						break;
-					}
-				case FilterMethod::Up:
-					{
-						std::uint8_t top = input[(scanline - 1) * byteWidth + byte + offset];
-						value            = top;
-						break;
-					}
-				case FilterMethod::Average:
-					{
-						std::uint8_t top  = 0;
-						std::uint8_t left = 0;
-
-						if (scanline != 0) top = input[(scanline - 1) * byteWidth + byte + offset];
-
-						if (byte > bpp) left = input[scanline * byteWidth + byte - bpp + offset];
-
-						value = static_cast<uint8_t>(static_cast<uint16_t>(top + left) >> 1);
-						break;
-					}
-				case FilterMethod::Paeth:
-					{
-						std::uint8_t top     = 0;
-						std::uint8_t left    = 0;
-						std::uint8_t topleft = 0;
-
-						if (scanline != 0 && byte > bpp)
-							topleft = input[(scanline - 1) * byteWidth + byte - bpp + offset];
-
-						if (scanline != 0) top = input[(scanline - 1) * byteWidth + byte + offset];
-
-						if (byte > bpp) left = input[scanline * byteWidth + byte - bpp + offset];
-
-						value = paethPredictor(left, top, topleft);
-						break;
-					}
-				default:
-					throw std::runtime_error(
-					    "TRV::IMAGE::LOAD_IMAGE Encountered unexpected filter "
-					    "type.");
-					break;
+				const std::atomic<std::size_t>& above = job.progress[scanline - 1];
+				while (above.load(std::memory_order_acquire) < end)
+				{
+					std::this_thread::yield();
+				}
 			}
 
-			input[scanline * byteWidth + byte + offset] += value;
+			unfilter(curr, prev, filter, begin, end, job.bpp);
+			job.progress[scanline].store(end, std::memory_order_release);
+		}
+	}
+}
+
+void do_unfilter_wavefront(std::span<uint8_t> input,
+                           std::size_t offset,
+                           std::size_t scanlines,
+                           std::size_t byteWidth,
+                           std::size_t bpp,
+                           std::size_t threadCount,
+                           std::size_t blockSize,
+                           ThreadPool* pool)
+{
+	// Filter types are validated up front, a lane stuck on a bad row would stall those below it.
+	for (size_t scanline = 0; scanline < scanlines; ++scanline)
+	{
+		if (input[scanline * byteWidth + offset] > static_cast<uint8_t>(FilterMethod::Paeth))
+		{
+			throw std::runtime_error(
+			    "TRV::IMAGE::LOAD_IMAGE Encountered unexpected filter "
+			    "type.");
 		}
 	}
+
+	std::size_t lanes = std::min(threadCount, scanlines);
+
+	if (lanes <= 1 || byteWidth <= blockSize)
+	{
+		do_unfilter(input, offset, scanlines, byteWidth, bpp);
+		return;
+	}
+
+	WavefrontJob job { input.data() + offset, scanlines, byteWidth, bpp, blockSize,
+		               std::vector<std::atomic<std::size_t>>(scanlines) };
+
+	(pool ? *pool : ThreadPool::instance())
+	    .parallel_for(0, lanes, 1,
+	                  [&job](std::size_t lane, std::size_t)
+	                  {
+		                  TraceScope trace("unfilter_lane", "lane", lane);
+		                  unfilter_lane(job);
+	                  });
+}
+
+// Smallest column block Auto gives a lane, below it lanes spend more time waiting than working.
+static constexpr std::size_t minimumAutoBlock = 256;
+
+// Serial unfiltering Auto never parallelizes, shorter than waking a sleeping worker.
+static constexpr double minimumParallelNanos = 50000.0;
+
+// Filtered bytes Auto keeps on the calling thread without consulting the pool, fewer than the
+// fastest kernel unfilters in minimumParallelNanos. Spares small images from starting the pool.
+static constexpr std::size_t minimumParallelBytes = 32768;
+
+// Fastest of a few runs of work, in nanoseconds.
+template <typename F>
+static double best_time(F&& work)
+{
+	double best = std::numeric_limits<double>::max();
+
+	for (int round = 0; round < 5; ++round)
+	{
+		auto start = std::chrono::steady_clock::now();
+		work();
+		best = std::min(
+		    best,
+		    std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+		        .count());
+	}
+
+	return best;
+}
+
+// Serial cost of unfiltering a byte of Paeth rows, the slowest filter, with unfilter.
+static double measure_nanos_per_byte(decltype(unfilter_span_scalar)* unfilter, std::size_t bpp)
+{
+	constexpr std::size_t byteWidth = 1025;
+	constexpr std::size_t scanlines = 4;
+
+	std::vector<unsigned char> rows(byteWidth * scanlines);
+
+	for (size_t i = 0; i < rows.size(); ++i)
+	{
+		rows[i] = static_cast<uint8_t>(i * 131);
+	}
+
+	auto unfilterRows = [&]()
+	{
+		for (size_t scanline = 0; scanline < scanlines; ++scanline)
+		{
+			std::uint8_t* curr = rows.data() + scanline * byteWidth;
+			unfilter(curr, scanline ? curr - byteWidth : nullptr, FilterMethod::Paeth, 1, byteWidth,
+			         bpp);
+		}
+	};
+
+	return best_time(unfilterRows) / static_cast<double>(rows.size());
+}
+
+UnfilterCosts measure_unfilter_costs()
+{
+	UnfilterCosts costs {};
+
+	// Levels above the detected one are never selected, those sharing the kernels of the level
+	// below cost the same
+	for (size_t level = 0; level <= static_cast<size_t>(detected_cpu_level()); ++level)
+	{
+		if (level && unfilterKernels[level] == unfilterKernels[level - 1])
+		{
+			costs[level] = costs[level - 1];
+			continue;
+		}
+
+		for (std::size_t bpp : { 1, 2, 3, 4, 6, 8 })
+		{
+			costs[level][bpp] = measure_nanos_per_byte(unfilterKernels[level], bpp);
+		}
+	}
+
+	return costs;
+}
+
+WavefrontPlan plan_wavefront(std::size_t scanlines, std::size_t byteWidth, std::size_t bpp,
+                             const ParallelismPolicy& policy)
+{
+	if (policy.mode == Parallelism::Serial)
+	{
+		return { 1, wavefrontBlockSize };
+	}
+
+	if (policy.mode == Parallelism::Parallel)
+	{
+		ThreadPool& pool = policy.pool ? *policy.pool : ThreadPool::instance();
+
+		return { policy.threads ? policy.threads : pool.size() + 1,
+			     policy.blockSize ? policy.blockSize : wavefrontBlockSize };
+	}
+
+	// Each lane trails the one above by a block, rows need several blocks to keep lanes busy
+	std::size_t blockSize = std::clamp(byteWidth / 8, minimumAutoBlock, wavefrontBlockSize);
+
+	// Decided before the pool is first touched, small images never start its threads
+	if (scanlines * byteWidth < minimumParallelBytes || byteWidth < 2 * blockSize || scanlines < 2)
+	{
+		return { 1, blockSize };
+	}
+
+	ThreadPool& pool     = policy.pool ? *policy.pool : ThreadPool::instance();
+	std::size_t maxLanes = std::min({ pool.size() + 1, scanlines, byteWidth / blockSize });
+
+	if (maxLanes <= 1)
+	{
+		return { 1, blockSize };
+	}
+
+	// Both measured by pool when it started, for the kernels and bpp this image unfilters with
+	double nanosPerByte = pool.unfilter_nanos_per_byte(bpp);
+	double nanosPerLane = pool.nanos_per_lane();
+	double serialNanos  = nanosPerByte * static_cast<double>(scanlines * byteWidth);
+
+	if (serialNanos < minimumParallelNanos)
+	{
+		return { 1, blockSize };
+	}
+
+	// Lanes share the rows, pay for their hand-off and for the rows above them filling up
+	WavefrontPlan best { 1, blockSize };
+	double bestNanos = serialNanos;
+
+	for (size_t lanes = 2; lanes <= maxLanes; ++lanes)
+	{
+		double nanos = serialNanos / static_cast<double>(lanes) +
+		               static_cast<double>(lanes - 1) * nanosPerLane +
+		               static_cast<double>(lanes * blockSize) * nanosPerByte;
+
+		if (nanos < bestNanos)
+		{
+			best      = { lanes, blockSize };
+			bestNanos = nanos;
+		}
+	}
+
+	return best;
+}
+
+void unfilter_scanlines(std::span<unsigned char> input, std::size_t offset, std::size_t scanlines,
+                        std::size_t byteWidth, std::size_t bpp, const ParallelismPolicy& policy,
+                        DecodeStats* stats)
+{
+	stats = collect_stats(stats);
+
+	if (stats)
+	{
+		// Counted before unfiltering, invalid types are rejected by do_unfilter
+		for (std::size_t row = 0; row < scanlines && byteWidth; ++row)
+		{
+			std::uint8_t type = input[offset + row * byteWidth];
+
+			if (type < stats->filters.size())
+			{
+				++stats->filters[type];
+			}
+		}
+	}
+
+	StageTimer timer(stats ? &stats->unfilterNanos : nullptr);
+	TraceScope trace("unfilter", "rows", scanlines);
+	WavefrontPlan plan = plan_wavefront(scanlines, byteWidth, bpp, policy);
+
+	if (plan.lanes <= 1)
+	{
+		do_unfilter(input, offset, scanlines, byteWidth, bpp);
+		return;
+	}
+
+	do_unfilter_wavefront(input, offset, scanlines, byteWidth, bpp, plan.lanes, plan.blockSize,
+	                      policy.pool);
 }
 }
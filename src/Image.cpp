@@ -0,0 +1,539 @@
+#include "Image.hpp"
+
+#include <spanstream>
+
+namespace trv
+{
+static void check_signature(std::istream& input)
+{
+	std::uint64_t file_header = extract_from_ifstream<uint64_t>(input);
+
+	if (!input || file_header != header_signature)
+	{
+		throw std::runtime_error("TRV::IMAGE::LOAD_IMAGE - Invalid PNG header.");
+	}
+}
+
+static std::ifstream open_png(const std::string& path)
+{
+	std::ifstream infile(path, std::ios_base::binary | std::ios_base::in);
+	if (infile.rdstate() & std::ios_base::failbit)
+	{
+		throw std::runtime_error("TRV::IMAGE::LOAD_IMAGE - Unable to open Image.");
+	}
+	// First thing's first
+
+	check_signature(infile);
+
+	return infile;
+}
+
+std::vector<unsigned char> read_file(const std::string& path)
+{
+	std::ifstream infile(path, std::ios_base::binary | std::ios_base::ate);
+
+	if (!infile)
+	{
+		throw std::runtime_error("TRV::IMAGE::READ_FILE - Unable to open Image.");
+	}
+
+	std::vector<unsigned char> file(static_cast<std::size_t>(infile.tellg()));
+	infile.seekg(0);
+	infile.read(reinterpret_cast<char*>(file.data()), static_cast<std::streamsize>(file.size()));
+
+	return file;
+}
+
+static void skip_chunk(std::istream& infile, std::uint32_t size, std::uint32_t type,
+                       const DecodeOptions& options)
+{
+	infile.seekg(size + sizeof(uint32_t), std::ios_base::cur);
+
+	if (DecodeStats* stats = collect_stats(options.stats))
+	{
+		++stats->unknownChunks;
+	}
+
+	if (options.unknownChunk)
+	{
+		std::uint32_t temp_type = big_endian<uint32_t>(type);
+		char cType[4];
+		memcpy(cType, &temp_type, 4);
+		options.unknownChunk(std::string_view(cType, 4), size);
+	}
+}
+
+static std::runtime_error budget_exceeded(std::size_t needed, std::size_t budget)
+{
+	std::stringstream msg;
+	msg << "TRV::IMAGE::LOAD_IMAGE - Decoding needs " << needed
+	    << " bytes, more than the memory budget of " << budget << " bytes.";
+	return std::runtime_error(msg.str());
+}
+
+// Checked before more image data is read, so neither a huge IHDR nor a long run of IDAT chunks
+// is allocated before the decode is known to fit.
+static void check_image_data_budget(const Chunks& chunks, std::uint32_t size,
+                                    const DecodeOptions& options)
+{
+	if (!options.memoryBudget || !chunks.header)
+	{
+		return;
+	}
+
+	std::size_t compressed = (chunks.image_data ? chunks.image_data->data.data.size() : 0) + size;
+	std::size_t needed     = compressed + decompressed_size(chunks.header->data, options);
+
+	if (needed > options.memoryBudget)
+	{
+		throw budget_exceeded(needed, options.memoryBudget);
+	}
+}
+
+Chunks read_chunks(const std::string& path, const DecodeOptions& options)
+{
+	Chunks chunks;
+	std::vector<ChunkType> sequence;
+
+	read_chunks(path, chunks, sequence, options);
+
+	return chunks;
+}
+
+Chunks read_chunks(std::span<const unsigned char> buffer, const DecodeOptions& options)
+{
+	Chunks chunks;
+	std::vector<ChunkType> sequence;
+
+	read_chunks(buffer, chunks, sequence, options);
+
+	return chunks;
+}
+
+// Reads the chunks following the signature of input.
+static void parse_chunks(std::istream& infile, Chunks& chunks, std::vector<ChunkType>& sequence,
+                         const DecodeOptions& options);
+
+void read_chunks(const std::string& path, Chunks& chunks, std::vector<ChunkType>& sequence,
+                 const DecodeOptions& options)
+{
+	std::ifstream infile = open_png(path);
+	parse_chunks(infile, chunks, sequence, options);
+}
+
+void read_chunks(std::span<const unsigned char> buffer, Chunks& chunks,
+                 std::vector<ChunkType>& sequence, const DecodeOptions& options)
+{
+	std::ispanstream input(
+	    std::span<const char>(reinterpret_cast<const char*>(buffer.data()), buffer.size()));
+
+	check_signature(input);
+	parse_chunks(input, chunks, sequence, options);
+}
+
+static void parse_chunks(std::istream& infile, Chunks& chunks, std::vector<ChunkType>& sequence,
+                         const DecodeOptions& options)
+{
+	// The previous image's IDAT chunk is refilled rather than reallocated
+	std::unique_ptr<Chunk<IDAT>> spareImageData = std::move(chunks.image_data);
+	chunks                                      = Chunks();
+	sequence.clear();
+
+	DecodeStats* stats      = collect_stats(options.stats);
+	std::uint64_t* crcNanos = stats ? &stats->crcNanos : nullptr;
+	StageTimer timer(stats ? &stats->parseNanos : nullptr, crcNanos);
+	TraceScope trace("parse");
+
+	if (stats)
+	{
+		stats->bytesRead += sizeof(header_signature);
+	}
+
+	while (infile.peek() != EOF)
+	{
+		std::uint32_t size = extract_from_ifstream<uint32_t>(infile);
+
+		std::uint32_t type = extract_from_ifstream<uint32_t>(infile);
+		TraceScope chunkTrace("read_chunk", "bytes", size);
+
+		if (stats)
+		{
+			// Length, type and CRC surround the data of every chunk
+			stats->bytesRead += std::size_t { size } + 3 * sizeof(std::uint32_t);
+		}
+
+		// Chunks allocate the size they declare before their CRC is checked
+		if (options.memoryBudget && size > options.memoryBudget)
+		{
+			throw budget_exceeded(size, options.memoryBudget);
+		}
+
+		// The budget of image data depends on IHDR, and so does the meaning of PLTE and tRNS
+		bool needsHeader = type == encode_type("IDAT") || type == encode_type("PLTE") ||
+		                   type == encode_type("tRNS");
+
+		if (needsHeader && !chunks.header)
+		{
+			throw std::runtime_error(
+			    "TRV::PNG::CHUNK Invalid chunk sequence IDHR must appear first.");
+		}
+
+		switch (type)
+		{
+			case encode_type("IHDR"):
+				chunks.header = std::make_unique<Chunk<IHDR>>(infile, size, type, crcNanos);
+				sequence.push_back(ChunkType::IHDR);
+				check_image_data_budget(chunks, 0, options);
+				break;
+			case encode_type("PLTE"):
+				chunks.palette = std::make_unique<Chunk<PLTE>>(infile, size, type, crcNanos);
+				sequence.push_back(ChunkType::PLTE);
+				break;
+			case encode_type("tRNS"):
+				chunks.transparency = std::make_unique<Chunk<TRNS>>(infile, size, type, crcNanos);
+				sequence.push_back(ChunkType::tRNS);
+				break;
+			case encode_type("IDAT"):
+				check_image_data_budget(chunks, size, options);
+
+				if (chunks.image_data == nullptr && spareImageData)
+				{
+					spareImageData->data.data.clear();
+					spareImageData->append(infile, size, crcNanos);
+					chunks.image_data = std::move(spareImageData);
+				}
+				else if (chunks.image_data == nullptr)
+				{
+					chunks.image_data = std::make_unique<Chunk<IDAT>>(infile, size, type, crcNanos);
+				}
+				else
+				{
+					chunks.image_data->append(infile, size, crcNanos);
+				}
+				sequence.push_back(ChunkType::IDAT);
+
+				if (stats)
+				{
+					++stats->imageDataChunks;
+				}
+				break;
+			case encode_type("IEND"):
+				chunks.end = std::make_unique<Chunk<IEND>>(infile, size, type, crcNanos);
+				sequence.push_back(ChunkType::IEND);
+				break;
+			default:
+				skip_chunk(infile, size, type, options);
+				sequence.push_back(ChunkType::Unknown);
+		}
+	}
+
+	verifyOrdering(chunks.header.get(), sequence);
+
+	if (chunks.transparency)
+	{
+		PLTE* palette = chunks.palette ? &chunks.palette->data : nullptr;
+		chunks.transparency->data.verify(chunks.header->data, palette);
+	}
+}
+
+ImageInfo read_image_info(const std::string& path, const DecodeOptions& options)
+{
+	std::ifstream infile = open_png(path);
+
+	std::uint32_t size = extract_from_ifstream<uint32_t>(infile);
+	std::uint32_t type = extract_from_ifstream<uint32_t>(infile);
+
+	if (type != encode_type("IHDR"))
+	{
+		throw std::runtime_error("TRV::PNG::CHUNK Invalid chunk sequence IDHR must appear first.");
+	}
+
+	Chunk<IHDR> header(infile, size, type);
+	bool hasTransparency = false;
+
+	// Only tRNS changes the output layout, it has to appear before the first IDAT
+	while (infile.peek() != EOF)
+	{
+		size = extract_from_ifstream<uint32_t>(infile);
+		type = extract_from_ifstream<uint32_t>(infile);
+
+		if (type == encode_type("IDAT") || !infile)
+		{
+			break;
+		}
+
+		hasTransparency |= type == encode_type("tRNS");
+		infile.seekg(size + sizeof(uint32_t), std::ios_base::cur);
+	}
+
+	Region region = decode_region(header.data, options);
+
+	return { static_cast<uint32_t>(scaled_dimension(region.width, options.scale)),
+		     static_cast<uint32_t>(scaled_dimension(region.height, options.scale)),
+		     static_cast<uint32_t>(output_channels(header.data, hasTransparency, options.format)) };
+}
+
+ImageInfo image_info(const Chunks& chunks, const DecodeOptions& options)
+{
+	const IHDR& header   = chunks.header->data;
+	std::size_t channels = output_channels(header, chunks.transparency != nullptr, options.format);
+
+	Region region        = decode_region(header, options);
+
+	return { static_cast<uint32_t>(scaled_dimension(region.width, options.scale)),
+		     static_cast<uint32_t>(scaled_dimension(region.height, options.scale)),
+		     static_cast<uint32_t>(channels) };
+}
+
+std::vector<unsigned char> decompress_image(const Chunks& chunks, const DecodeOptions& options)
+{
+	std::vector<unsigned char> decompressed;
+	decompress_image(chunks, options, decompressed);
+	return decompressed;
+}
+
+std::size_t decompressed_size(const IHDR& header, const DecodeOptions& options)
+{
+	std::size_t channels = (header.colorType & static_cast<uint8_t>(ColorType::Color)) + 1 +
+	                       ((header.colorType & static_cast<uint8_t>(ColorType::Alpha)) >> 2);
+	bool usesPalette = header.colorType & static_cast<uint8_t>(ColorType::Palette);
+
+	std::size_t bitsPerPixel = header.bitDepth * (usesPalette ? 1 : channels);
+	std::size_t byteWidth    = (header.width * bitsPerPixel + 7) / 8;
+
+	if (byteWidth)
+	{
+		byteWidth += 1;
+	}
+
+	// Inflating stops after the last scanline needed, of the last Adam7 pass needed
+	Region region      = decode_region(header, options);
+	std::size_t rowEnd = region.y + region.height;
+
+	if (static_cast<InterlaceMethod>(header.interlaceMethod) == InterlaceMethod::Adam7)
+	{
+		std::size_t passes = adam7_passes_needed(options);
+		Adam7Pass last     = adam7_passes(header.width, header.height, bitsPerPixel)[passes - 1];
+
+		return last.offset + last.byteWidth * last.rows_before(rowEnd);
+	}
+
+	return rowEnd * byteWidth;
+}
+
+void reserve_memory(const Chunks& chunks, const DecodeOptions& options, std::size_t outputBytes)
+{
+	if (!options.memoryBudget)
+	{
+		return;
+	}
+
+	std::size_t compressed = chunks.image_data ? chunks.image_data->data.data.size() : 0;
+	std::size_t needed =
+	    compressed + decompressed_size(chunks.header->data, options) + outputBytes;
+
+	if (needed > options.memoryBudget)
+	{
+		throw budget_exceeded(needed, options.memoryBudget);
+	}
+}
+
+void report_memory(const Chunks& chunks, const DecodeOptions& options,
+                   std::size_t decompressedBytes, std::size_t outputBytes)
+{
+	if (!options.memoryUsage)
+	{
+		return;
+	}
+
+	MemoryUsage& usage = *options.memoryUsage;
+	usage.compressed   = chunks.image_data ? chunks.image_data->data.data.capacity() : 0;
+	usage.decompressed = decompressedBytes;
+	usage.output       = outputBytes;
+	usage.peak         = usage.compressed + usage.decompressed + usage.output;
+}
+
+// Shared by the std::vector and std::pmr::vector overloads of decompress_image.
+template <typename Allocator>
+static void inflate_image(const Chunks& chunks, const DecodeOptions& options,
+                          std::vector<unsigned char, Allocator>& decompressed,
+                          InflateTables* tables)
+{
+	if (!chunks.image_data)
+	{
+		throw std::runtime_error("TRV::IMAGE::LOAD_IMAGE - Image has no IDAT chunk.");
+	}
+
+	// Never more than this is inflated, however much the compressed data expands to
+	std::size_t size = decompressed_size(chunks.header->data, options);
+
+	decompressed.clear();
+	decompressed.reserve(size);
+	BasicDeflateArgs<Allocator> decompressArgs { true, chunks.image_data->data.data, decompressed };
+	decompressArgs.tables      = tables;
+	decompressArgs.outputLimit = size;
+	decompressArgs.stats       = collect_stats(options.stats);
+
+	StageTimer timer(decompressArgs.stats ? &decompressArgs.stats->inflateNanos : nullptr);
+	TraceScope trace("inflate", "bytes", size);
+	decompress(decompressArgs);
+
+	// Missing scanlines would be unfiltered from whatever the buffer held before
+	if (decompressed.size() < size)
+	{
+		throw std::runtime_error(
+		    "TRV::IMAGE::LOAD_IMAGE - Image data ends before the last scanline.");
+	}
+}
+
+void decompress_image(const Chunks& chunks, const DecodeOptions& options,
+                      std::vector<unsigned char>& decompressed, InflateTables* tables)
+{
+	inflate_image(chunks, options, decompressed, tables);
+}
+
+void decompress_image(const Chunks& chunks, const DecodeOptions& options,
+                      std::pmr::vector<unsigned char>& decompressed, InflateTables* tables)
+{
+	inflate_image(chunks, options, decompressed, tables);
+}
+
+void check_plane_pitch(const ImageInfo& info, std::size_t rowStride, const DecodeOptions& options)
+{
+	if (options.layout != Layout::Planar || !info.height)
+	{
+		return;
+	}
+
+	std::size_t planeSize = (info.height - 1) * rowStride + info.width;
+
+	if (plane_pitch(options, info.height, rowStride) < planeSize)
+	{
+		throw std::runtime_error("TRV::IMAGE::LOAD_IMAGE - planePitch makes the planes overlap.");
+	}
+}
+
+void check_destination(const ImageInfo& info, std::size_t size, std::size_t rowStride,
+                       const DecodeOptions& options)
+{
+	std::size_t rowElements = packed_row_stride(options, info.width, info.channels);
+
+	check_plane_pitch(info, rowStride, options);
+
+	if (rowStride < rowElements ||
+	    size < output_size(options, info.width, info.height, info.channels, rowStride))
+	{
+		throw std::runtime_error(
+		    "TRV::IMAGE::DECODE_INTO - Destination is too small for the image.");
+	}
+}
+
+ScanlineReader::ScanlineReader(const std::string& path) : m_file(open_png(path))
+{
+	// Reads up to the header of the first IDAT chunk
+	while (m_file.peek() != EOF)
+	{
+		std::uint32_t size = extract_from_ifstream<uint32_t>(m_file);
+		std::uint32_t type = extract_from_ifstream<uint32_t>(m_file);
+
+		if (!m_chunks.header && type != encode_type("IHDR"))
+		{
+			throw std::runtime_error(
+			    "TRV::PNG::CHUNK Invalid chunk sequence IDHR must appear first.");
+		}
+
+		if (type == encode_type("IDAT"))
+		{
+			m_chunkSize   = size;
+			m_inImageData = true;
+			break;
+		}
+
+		switch (type)
+		{
+			case encode_type("IHDR"):
+				m_chunks.header = std::make_unique<Chunk<IHDR>>(m_file, size, type);
+				break;
+			case encode_type("PLTE"):
+				m_chunks.palette = std::make_unique<Chunk<PLTE>>(m_file, size, type);
+				break;
+			case encode_type("tRNS"):
+				m_chunks.transparency = std::make_unique<Chunk<TRNS>>(m_file, size, type);
+				break;
+			default:
+				skip_chunk(m_file, size, type, DecodeOptions {});
+		}
+	}
+
+	if (!m_inImageData)
+	{
+		throw std::runtime_error("TRV::IMAGE::LOAD_IMAGE - Image has no IDAT chunk.");
+	}
+
+	const IHDR& header = m_chunks.header->data;
+
+	if (static_cast<InterlaceMethod>(header.interlaceMethod) != InterlaceMethod::None)
+	{
+		throw std::runtime_error(
+		    "TRV::IMAGE::SCANLINE_READER - Interlaced images can't be streamed by row.");
+	}
+
+	if (m_chunks.transparency)
+	{
+		m_chunks.transparency->data.verify(header, palette());
+	}
+
+	std::size_t channels = (header.colorType & static_cast<uint8_t>(ColorType::Color)) + 1 +
+	                       ((header.colorType & static_cast<uint8_t>(ColorType::Alpha)) >> 2);
+	bool usesPalette = header.colorType & static_cast<uint8_t>(ColorType::Palette);
+
+	std::size_t bitsPerPixel = header.bitDepth * (usesPalette ? 1 : channels);
+	std::size_t byteWidth    = (header.width * bitsPerPixel + 7) / 8 + 1;
+
+	m_bpp = (bitsPerPixel + 7) / 8;
+	m_current.resize(byteWidth);
+	m_previous.resize(byteWidth);
+
+	m_inflater = std::make_unique<Inflater>(
+	    true, [this](std::vector<unsigned char>& input) { return read_image_data(input); });
+}
+
+bool ScanlineReader::read_image_data(std::vector<unsigned char>& input)
+{
+	if (!m_inImageData)
+	{
+		return false;
+	}
+
+	Chunk<IDAT> chunk(m_file, m_chunkSize, encode_type("IDAT"));
+	input.insert(input.end(), chunk.data.data.begin(), chunk.data.data.end());
+
+	// Image data ends at the first chunk that isn't an IDAT
+	m_chunkSize        = extract_from_ifstream<uint32_t>(m_file);
+	std::uint32_t type = extract_from_ifstream<uint32_t>(m_file);
+	m_inImageData      = m_file && type == encode_type("IDAT");
+
+	return true;
+}
+
+const std::uint8_t* ScanlineReader::next_scanline()
+{
+	if (m_row == header().height)
+	{
+		return nullptr;
+	}
+
+	std::swap(m_current, m_previous);
+
+	if (m_inflater->read(m_current.data(), m_current.size()) != m_current.size())
+	{
+		throw std::runtime_error(
+		    "TRV::IMAGE::SCANLINE_READER - Image data ended before the last scanline.");
+	}
+
+	unfilter_row(m_current.data(), m_row ? m_previous.data() : nullptr, m_current.size(), m_bpp);
+	++m_row;
+
+	return m_current.data() + 1;
+}
+}
@@ -0,0 +1,191 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <string>
+
+#include "Filter.hpp"
+#include "Trace.hpp"
+
+namespace trv
+{
+// Pool and deque of the worker running on this thread, null outside of any pool
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local std::size_t currentIndex = 0;
+
+// Tasks own themselves once taken off a queue, an exception escaping one terminates.
+static void execute(PoolTask* task) noexcept
+{
+	std::unique_ptr<PoolTask> owned(task);
+	owned->run();
+}
+
+ThreadPool::ThreadPool(std::size_t threads)
+{
+	for (size_t index = 0; index < threads; ++index)
+	{
+		m_deques.push_back(std::make_unique<WorkStealingDeque>());
+	}
+
+	for (size_t index = 0; index < threads; ++index)
+	{
+		m_workers.emplace_back(&ThreadPool::worker_loop, this, index);
+	}
+
+	// Planning a wavefront is the only use, a pool without workers never runs one
+	if (threads)
+	{
+		m_nanosPerLane  = measure_nanos_per_lane();
+		m_unfilterNanos = measure_unfilter_costs();
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+
+	// Submitted tasks that never ran
+	for (PoolTask* task : m_injected)
+	{
+		delete task;
+	}
+
+	for (auto& deque : m_deques)
+	{
+		while (PoolTask* task = deque->steal())
+		{
+			delete task;
+		}
+	}
+}
+
+ThreadPool& ThreadPool::instance()
+{
+	static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+	return pool;
+}
+
+// Fastest of a few empty parallel_for calls giving every worker and the caller a range.
+double ThreadPool::measure_nanos_per_lane()
+{
+	double best = std::numeric_limits<double>::max();
+
+	for (int round = 0; round < 5; ++round)
+	{
+		auto start = std::chrono::steady_clock::now();
+		parallel_for(0, m_workers.size() + 1, 1, [](std::size_t, std::size_t) {});
+		best = std::min(
+		    best,
+		    std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+		        .count());
+	}
+
+	return best / static_cast<double>(m_workers.size());
+}
+
+void ThreadPool::push(PoolTask* task)
+{
+	// Counted before the task is visible, so a thief taking it never sees the count below zero
+	m_queued.fetch_add(1, std::memory_order_seq_cst);
+
+	if (currentPool != this || !m_deques[currentIndex]->push(task))
+	{
+		std::lock_guard lock(m_mutex);
+		m_injected.push_back(task);
+	}
+
+	// A worker counts itself as a sleeper before it checks m_queued, so either it sees the task or
+	// this sees it. Taking the lock keeps the notify from landing between its check and its wait.
+	if (m_sleepers.load(std::memory_order_seq_cst))
+	{
+		{
+			std::lock_guard lock(m_mutex);
+		}
+		m_wake.notify_one();
+	}
+}
+
+PoolTask* ThreadPool::find_task(std::size_t self)
+{
+	PoolTask* task = nullptr;
+
+	if (self < m_deques.size())
+	{
+		task = m_deques[self]->pop();
+	}
+
+	if (!task && m_queued.load(std::memory_order_acquire))
+	{
+		std::lock_guard lock(m_mutex);
+
+		if (!m_injected.empty())
+		{
+			task = m_injected.front();
+			m_injected.pop_front();
+		}
+	}
+
+	for (size_t offset = 1; !task && offset <= m_deques.size(); ++offset)
+	{
+		task = m_deques[(self + offset) % m_deques.size()]->steal();
+	}
+
+	if (task)
+	{
+		m_queued.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	return task;
+}
+
+bool ThreadPool::run_one()
+{
+	PoolTask* task = find_task(currentPool == this ? currentIndex : m_deques.size());
+
+	if (!task)
+	{
+		return false;
+	}
+
+	execute(task);
+	return true;
+}
+
+void ThreadPool::worker_loop(std::size_t index)
+{
+	currentPool  = this;
+	currentIndex = index;
+
+	// Workers outlive most traces, so they are named whether or not one is running
+	set_trace_thread_name("pool worker " + std::to_string(index));
+
+	while (true)
+	{
+		if (run_one())
+		{
+			continue;
+		}
+
+		std::unique_lock lock(m_mutex);
+		m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+		m_wake.wait(lock,
+		            [this]() { return m_stop || m_queued.load(std::memory_order_seq_cst); });
+		m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+
+		if (m_stop)
+		{
+			return;
+		}
+	}
+}
+}
@@ -0,0 +1,325 @@
+#include "Trace.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace trv
+{
+struct TraceEvent
+{
+	const char* name;
+	const char* argName;
+	std::uint64_t start, end, arg;
+};
+
+// Events are appended by the owning thread and published through count, a full block is never
+// written again once next links its successor.
+struct TraceBlock
+{
+	static constexpr std::size_t capacity = 1024;
+
+	std::array<TraceEvent, capacity> events;
+	std::atomic<std::size_t> count { 0 };
+	std::atomic<TraceBlock*> next { nullptr };
+};
+
+// Events of one thread. tail belongs to the thread, everything else to the registry's mutex.
+struct ThreadTrace
+{
+	~ThreadTrace()
+	{
+		TraceBlock* block = head ? head : first.load(std::memory_order_relaxed);
+
+		while (block)
+		{
+			delete std::exchange(block, block->next.load(std::memory_order_relaxed));
+		}
+	}
+
+	std::uint32_t id = 0;
+	std::string name;
+	// Blocks are allocated by the first event, naming a thread costs none
+	TraceBlock* head = nullptr;
+	// Events of head already written or dropped
+	std::size_t consumed = 0;
+	std::atomic<TraceBlock*> first { nullptr };
+	TraceBlock* tail = nullptr;
+	// Set once the thread has exited, its trace is freed after the last event is consumed
+	std::atomic<bool> retired { false };
+};
+
+struct TraceRegistry
+{
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadTrace>> threads;
+	std::uint32_t nextId = 1;
+	std::string path;
+	std::atomic<bool> active { false };
+};
+
+// Never destroyed, threads may still record after static destruction began
+static TraceRegistry& registry()
+{
+	static TraceRegistry* instance = new TraceRegistry;
+	return *instance;
+}
+
+// Retires the trace of the thread as it exits
+struct LocalTrace
+{
+	~LocalTrace()
+	{
+		if (trace)
+		{
+			trace->retired.store(true, std::memory_order_release);
+		}
+	}
+
+	ThreadTrace* trace = nullptr;
+};
+
+static thread_local LocalTrace localTrace;
+
+static ThreadTrace& local_trace()
+{
+	if (!localTrace.trace)
+	{
+		TraceRegistry& traces = registry();
+		auto trace            = std::make_unique<ThreadTrace>();
+
+		std::lock_guard lock(traces.mutex);
+		trace->id        = traces.nextId++;
+		localTrace.trace = trace.get();
+		traces.threads.push_back(std::move(trace));
+	}
+
+	return *localTrace.trace;
+}
+
+// Passes every event of trace not consumed yet to emit, freeing blocks once they are full and
+// consumed. Returns true when the thread is gone and nothing is left.
+template <typename F>
+static bool drain(ThreadTrace& trace, F&& emit)
+{
+	bool retired = trace.retired.load(std::memory_order_acquire);
+
+	if (!trace.head)
+	{
+		trace.head = trace.first.load(std::memory_order_acquire);
+
+		if (!trace.head)
+		{
+			return retired;
+		}
+	}
+
+	while (true)
+	{
+		TraceBlock* block = trace.head;
+		TraceBlock* next  = block->next.load(std::memory_order_acquire);
+		// The whole block when next is set
+		std::size_t count = block->count.load(std::memory_order_acquire);
+
+		for (; trace.consumed < count; ++trace.consumed)
+		{
+			emit(block->events[trace.consumed]);
+		}
+
+		if (!next)
+		{
+			return retired;
+		}
+
+		delete block;
+		trace.head     = next;
+		trace.consumed = 0;
+	}
+}
+
+// Drains every thread, dropping the traces of threads that exited.
+template <typename F>
+static void drain_all(TraceRegistry& traces, F&& emit)
+{
+	std::erase_if(traces.threads, [&](const std::unique_ptr<ThreadTrace>& trace)
+	              { return drain(*trace, [&](const TraceEvent& event) { emit(*trace, event); }); });
+}
+
+static void write_string(std::ostream& out, const char* str)
+{
+	out << '"';
+
+	for (; *str; ++str)
+	{
+		if (*str == '"' || *str == '\\')
+		{
+			out << '\\' << *str;
+		}
+		else if (static_cast<unsigned char>(*str) < 0x20)
+		{
+			out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+			    << static_cast<int>(*str) << std::dec << std::setfill(' ');
+		}
+		else
+		{
+			out << *str;
+		}
+	}
+
+	out << '"';
+}
+
+void start_tracing(const std::string& path)
+{
+	TraceRegistry& traces = registry();
+	std::lock_guard lock(traces.mutex);
+
+	drain_all(traces, [](const ThreadTrace&, const TraceEvent&) {});
+	traces.path = path;
+	traces.active.store(true, std::memory_order_relaxed);
+}
+
+void stop_tracing()
+{
+	TraceRegistry& traces = registry();
+	std::lock_guard lock(traces.mutex);
+
+	if (!traces.active.exchange(false, std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	std::ofstream out(traces.path, std::ios_base::binary | std::ios_base::trunc);
+
+	if (!out)
+	{
+		throw std::runtime_error("TRV::TRACE::STOP_TRACING - Unable to open " + traces.path);
+	}
+
+	// Timestamps are in microseconds
+	out << "{\"traceEvents\":[\n" << std::fixed << std::setprecision(3);
+	bool first = true;
+
+	auto separate = [&]()
+	{
+		out << (first ? "" : ",\n");
+		first = false;
+	};
+
+	for (const auto& trace : traces.threads)
+	{
+		if (!trace->name.empty())
+		{
+			separate();
+			out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << trace->id
+			    << ",\"args\":{\"name\":";
+			write_string(out, trace->name.c_str());
+			out << "}}";
+		}
+	}
+
+	drain_all(traces,
+	          [&](const ThreadTrace& trace, const TraceEvent& event)
+	          {
+		          separate();
+		          out << "{\"name\":";
+		          write_string(out, event.name);
+		          out << ",\"cat\":\"trv\",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace.id
+		              << ",\"ts\":" << static_cast<double>(event.start) / 1000.0
+		              << ",\"dur\":" << static_cast<double>(event.end - event.start) / 1000.0;
+
+		          if (event.argName)
+		          {
+			          out << ",\"args\":{";
+			          write_string(out, event.argName);
+			          out << ':' << event.arg << '}';
+		          }
+
+		          out << '}';
+	          });
+
+	out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+bool tracing()
+{
+	return registry().active.load(std::memory_order_relaxed);
+}
+
+void set_trace_thread_name(const std::string& name)
+{
+	ThreadTrace& trace = local_trace();
+
+	std::lock_guard lock(registry().mutex);
+	trace.name = name;
+}
+
+std::uint64_t trace_clock()
+{
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+	                                      std::chrono::steady_clock::now().time_since_epoch())
+	                                      .count());
+}
+
+void record_trace(const char* name, std::uint64_t start, std::uint64_t end, const char* argName,
+                  std::uint64_t arg)
+{
+	ThreadTrace& trace = local_trace();
+	TraceBlock* block  = trace.tail;
+
+	if (!block)
+	{
+		block = trace.tail = new TraceBlock;
+		trace.first.store(block, std::memory_order_release);
+	}
+
+	std::size_t count = block->count.load(std::memory_order_relaxed);
+
+	if (count == TraceBlock::capacity)
+	{
+		TraceBlock* next = new TraceBlock;
+		block->next.store(next, std::memory_order_release);
+		block = trace.tail = next;
+		count              = 0;
+	}
+
+	block->events[count] = { name, argName, start, end, arg };
+	block->count.store(count + 1, std::memory_order_release);
+}
+
+// Traces the whole process when TRV_TRACE names a file, which is written at exit
+static struct EnvironmentTrace
+{
+	EnvironmentTrace()
+	{
+#ifdef _MSC_VER
+#pragma warning(suppress : 4996)
+#endif
+		const char* path = std::getenv("TRV_TRACE");
+
+		if (path && *path)
+		{
+			start_tracing(path);
+		}
+	}
+
+	~EnvironmentTrace()
+	{
+		try
+		{
+			stop_tracing();
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+} environmentTrace;
+}
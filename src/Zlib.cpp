@@ -1,15 +1,20 @@
 #include "Zlib.hpp"
 
 #include <memory>
+#include <optional>
+
+#include "Cpu.hpp"
+#include "Trace.hpp"
+
+#ifdef TRV_PNG_X86
+#include <immintrin.h>
+#endif
 
 namespace trv
 {
-void decompress(DeflateArgs& args)
+// Validates the two byte zlib header.
+static void check_header(std::uint8_t CMF, std::uint8_t FLG, bool png)
 {
-	BitConsumer<std::endian::big> zlibConsumer(args.input);
-
-	std::uint8_t CMF = zlibConsumer.consume_bits<uint8_t, std::endian::big>(8);
-
 	if ((CMF & CMFilter) != CM)
 	{
 		throw std::runtime_error("TRV::ZLIB::DECOMPRESS CM must be 8");
@@ -22,12 +27,6 @@ void decompress(DeflateArgs& args)
 		throw std::runtime_error("TRV::ZLIB::DECOMPRESS CINFO cannot be larger than 7");
 	}
 
-#ifdef DEBUG
-	unsigned long window = 1L << (CINFO + 8);
-#endif
-
-	std::uint8_t FLG = zlibConsumer.consume_bits<uint8_t, std::endian::big>(8);
-
 	std::uint16_t check = ((uint16_t)CMF * 256) + static_cast<uint16_t>(FLG);
 
 	if (check % 31 != 0)
@@ -35,28 +34,359 @@ void decompress(DeflateArgs& args)
 		throw std::runtime_error("TRV::ZLIB::DECOMPRESS FLGCHECK failed");
 	}
 
-	if (FLG & FDICTFilter && args.png)
+	if (FLG & FDICTFilter && png)
 	{
 		throw std::runtime_error("TRV::ZLIB::DECOMPRESS FDICT cannot be set in PNG files.");
 	}
-	else if (FLG & FDICTFilter)
+}
+
+// Reads the code lengths of a dynamic Huffman block and builds its tables.
+static void read_dynamic_tables(BitConsumer<std::endian::little>& deflateConsumer,
+                                InflateTables& tables)
+{
+	std::uint16_t HLIT  = deflateConsumer.consume_bits<uint16_t, std::endian::little>(5) + 257;
+	std::uint16_t HDIST = deflateConsumer.consume_bits<uint16_t, std::endian::little>(5) + 1;
+	std::uint16_t HCLEN = deflateConsumer.consume_bits<uint16_t, std::endian::little>(4) + 4;
+
+	std::array<size_t, 19> HCLENSwizzle = { 16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+		                                    11, 4,  12, 3, 13, 2, 14, 1, 15 };
+
+	std::array<uint16_t, 19> HCLENTable {};
+
+	for (uint32_t i = 0; i < HCLEN; ++i)
 	{
-		[[maybe_unused]] std::uint32_t FDICT =
-		    zlibConsumer.consume_bits<uint32_t, std::endian::big>(32);
+		HCLENTable[HCLENSwizzle[i]] =
+		    deflateConsumer.consume_bits<uint16_t, std::endian::little>(3);
+	}
 
-		// TODO: Understand what to use this for.
+	Huffman<uint16_t> dictHuffman(8, 19, HCLENTable.data());
+	std::uint16_t litLenCount = 0;
+	std::uint16_t lenCount    = HLIT + HDIST;
+	// At most 288 literal/length and 32 distance code lengths
+	std::array<uint32_t, 288 + 32> litLenDistTable {};
+
+	while (litLenCount < lenCount)
+	{
+		std::uint16_t repetitions = 1;
+		std::uint16_t repeated    = 0;
+		std::uint16_t encodedLen  = dictHuffman.decode(deflateConsumer);
+
+		if (encodedLen <= 15)
+		{
+			repeated = encodedLen;
+		}
+		else if (encodedLen == 16)
+		{
+			if (!litLenCount)
+			{
+				throw std::runtime_error(
+				    "TRV::ZLIB::DECOMPRESS Repeat code found on "
+				    "first pass, therefore nothing can be repeated.");
+			}
+			repetitions = deflateConsumer.consume_bits<uint16_t, std::endian::little>(2) + 3;
+
+#ifdef MSVC
+#pragma warning( \
+    suppress : 6385)  // 16 cannot appear before <= 15 according to the deflate specificaition ^ I check above in case of corrupt data.
+#endif
+			repeated = static_cast<uint16_t>(litLenDistTable[litLenCount - 1]);
+		}
+		else if (encodedLen == 17)
+		{
+			repetitions = deflateConsumer.consume_bits<uint16_t, std::endian::little>(3) + 3;
+		}
+		else if (encodedLen == 18)
+		{
+			repetitions = deflateConsumer.consume_bits<uint16_t, std::endian::little>(7) + 11;
+		}
+		else
+		{
+			throw std::runtime_error(
+			    "TRV::ZLIB::DECOMPRESS Unexpected encoded length.");
+		}
+
+		if (repetitions > lenCount - litLenCount)
+		{
+			throw std::runtime_error("TRV::ZLIB::DECOMPRESS Code lengths overflow the table.");
+		}
+
+		while (repetitions--)
+		{
+			litLenDistTable[litLenCount++] = repeated;
+		}
 	}
 
-	std::vector<unsigned char>& output = args.output;
+	tables.litLen.build(static_cast<std::uint8_t>(16), HLIT, litLenDistTable.data());
+	tables.dist.build(static_cast<std::uint8_t>(16), HDIST, litLenDistTable.data() + HLIT);
+}
 
-	BitConsumer<std::endian::little> deflateConsumer(zlibConsumer);
+// Decodes a literal/length symbol of a fixed Huffman block.
+static TRV_PNG_INLINE std::uint32_t decode_fixed_lit_len(
+    BitConsumer<std::endian::little>& deflateConsumer)
+{
+	std::uint32_t litLen;
+	std::uint16_t code = deflateConsumer.peek_bits<uint16_t, std::endian::big>(9);
+	std::uint16_t bits = 0;
+
+	if (code >= FIXED_LIT_0_143_LOWER && code <= FIXED_LIT_0_143_UPPER)
+	{
+		litLen = (code >> (9 - FIXED_LIT_0_143_LENGTH)) - FIXED_LIT_0_143_ROOT +
+		         FIXED_LIT_0_143_OFFSET;
+		bits = FIXED_LIT_0_143_LENGTH;
+	}
+	else if (code >= FIXED_LIT_144_255_LOWER && code <= FIXED_LIT_144_255_UPPER)
+	{
+		litLen = (code >> (9 - FIXED_LIT_144_255_LENGTH)) - FIXED_LIT_144_255_ROOT +
+		         FIXED_LIT_144_255_OFFSET;
+		bits = FIXED_LIT_144_255_LENGTH;
+	}
+	else if (code >= FIXED_LIT_256_279_LOWER && code <= FIXED_LIT_256_279_UPPER)
+	{
+		litLen = (code >> (9 - FIXED_LIT_256_279_LENGTH)) - FIXED_LIT_256_279_ROOT +
+		         FIXED_LIT_256_279_OFFSET;
+		bits = FIXED_LIT_256_279_LENGTH;
+	}
+	else if (code >= FIXED_LIT_280_287_LOWER && code <= FIXED_LIT_280_287_UPPER)
+	{
+		litLen = (code >> (9 - FIXED_LIT_280_287_LENGTH)) - FIXED_LIT_280_287_ROOT +
+		         FIXED_LIT_280_287_OFFSET;
+		bits = FIXED_LIT_280_287_LENGTH;
+	}
+	else
+	{
+		throw std::runtime_error(
+		    "TRV::ZLIB::DECOMPRES Invalid code encountered in "
+		    "fixed huffman.");
+	}
+
+	deflateConsumer.discard_bits(bits);
+
+	return litLen;
+}
+
+// Reads the length and distance of a match introduced by length symbol litLen, distances use
+// the fixed code when DistHuffman is null. Both symbols are counted in stats when set.
+static TRV_PNG_INLINE std::pair<std::uint16_t, std::uint16_t> read_match(
+    BitConsumer<std::endian::little>& deflateConsumer, std::uint32_t litLen,
+    Huffman<uint32_t>* DistHuffman, DecodeStats* stats = nullptr)
+{
+	if (litLen > 285)
+	{
+		throw std::runtime_error("TRV::ZLIB::DECOMPRESS Encountered invalid length symbol.");
+	}
+
+	std::uint8_t lenIndex       = static_cast<uint8_t>(litLen - 257);
+	std::uint16_t length        = lengthExtraTable[lenIndex * 2];
+	std::size_t extraLengthBits = lengthExtraTable[lenIndex * 2 + 1];
+	length += deflateConsumer.consume_bits<uint16_t, std::endian::little>(extraLengthBits);
+
+	std::uint32_t distIndex;
+
+	if (DistHuffman)
+	{
+		distIndex = DistHuffman->decode(deflateConsumer);
+	}
+	else
+	{
+		distIndex = deflateConsumer.consume_bits<uint32_t, std::endian::big>(5);
+	}
+
+	if (distIndex >= 30)
+	{
+		throw std::runtime_error("TRV::ZLIB::DECOMPRESS Encountered invalid distance symbol.");
+	}
+
+	if (stats)
+	{
+		++stats->matchLengths[lenIndex];
+		++stats->matchDistances[distIndex];
+	}
+
+	std::uint16_t distance        = distanceExtraTable[distIndex * 2];
+	std::size_t extraDistanceBits = distanceExtraTable[distIndex * 2 + 1];
+	distance += deflateConsumer.consume_bits<uint16_t, std::endian::little>(extraDistanceBits);
+
+	return { length, distance };
+}
+
+static constexpr std::uint32_t adlerBase = 65521;
+// Most bytes summed before the sums have to be reduced, 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1
+static constexpr std::size_t adlerMax = 5552;
+
+static std::uint32_t adler32_scalar(std::uint32_t adler, const std::uint8_t* data,
+                                    std::size_t size)
+{
+	std::uint32_t a = adler & 0xFFFFu;
+	std::uint32_t b = adler >> 16;
+
+	while (size)
+	{
+		std::size_t count = std::min(size, adlerMax);
+		size -= count;
+
+		for (; count; --count)
+		{
+			a += *data++;
+			b += a;
+		}
+
+		a %= adlerBase;
+		b %= adlerBase;
+	}
+
+	return b << 16 | a;
+}
+
+#ifdef TRV_PNG_X86
+TRV_PNG_TARGET("ssse3")
+static std::uint32_t horizontal_sum(__m128i sums)
+{
+	sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+	sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+	return static_cast<std::uint32_t>(_mm_cvtsi128_si32(sums));
+}
+
+// Sums blocks of 32 bytes. Each block adds 32 times the previous a to b, collected in previous,
+// and every byte weighted by its distance from the end of the block, PMADDUBSW with descending
+// taps.
+TRV_PNG_TARGET("ssse3")
+static std::uint32_t adler32_ssse3(std::uint32_t adler, const std::uint8_t* data,
+                                   std::size_t size)
+{
+	const __m128i tapsHigh = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19,
+	                                       18, 17);
+	const __m128i tapsLow  = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	const __m128i zero     = _mm_setzero_si128();
+	const __m128i ones     = _mm_set1_epi16(1);
+
+	std::uint32_t a = adler & 0xFFFFu;
+	std::uint32_t b = adler >> 16;
+
+	std::size_t blocks = size / 32;
+	size -= blocks * 32;
+
+	while (blocks)
+	{
+		std::size_t count = std::min(blocks, adlerMax / 32);
+		blocks -= count;
+
+		__m128i previous = _mm_cvtsi32_si128(static_cast<int>(a * count));
+		__m128i sumA     = zero;
+		__m128i sumB     = _mm_cvtsi32_si128(static_cast<int>(b));
+
+		for (; count; --count, data += 32)
+		{
+			__m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+			__m128i low  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+
+			previous = _mm_add_epi32(previous, sumA);
+
+			sumA = _mm_add_epi32(sumA, _mm_sad_epu8(high, zero));
+			sumB = _mm_add_epi32(sumB, _mm_madd_epi16(_mm_maddubs_epi16(high, tapsHigh), ones));
+			sumA = _mm_add_epi32(sumA, _mm_sad_epu8(low, zero));
+			sumB = _mm_add_epi32(sumB, _mm_madd_epi16(_mm_maddubs_epi16(low, tapsLow), ones));
+		}
+
+		sumB = _mm_add_epi32(sumB, _mm_slli_epi32(previous, 5));
+
+		a = (a + horizontal_sum(sumA)) % adlerBase;
+		b = horizontal_sum(sumB) % adlerBase;
+	}
+
+	return adler32_scalar(b << 16 | a, data, size);
+}
+
+TRV_PNG_TARGET("avx2")
+static std::uint32_t horizontal_sum(__m256i sums)
+{
+	__m128i half = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+	return horizontal_sum(half);
+}
+
+// adler32_ssse3 with a whole block in one register.
+TRV_PNG_TARGET("avx2")
+static std::uint32_t adler32_avx2(std::uint32_t adler, const std::uint8_t* data, std::size_t size)
+{
+	const __m256i taps = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19,
+	                                      18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3,
+	                                      2, 1);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(1);
+
+	std::uint32_t a = adler & 0xFFFFu;
+	std::uint32_t b = adler >> 16;
+
+	std::size_t blocks = size / 32;
+	size -= blocks * 32;
+
+	while (blocks)
+	{
+		std::size_t count = std::min(blocks, adlerMax / 32);
+		blocks -= count;
+
+		__m256i previous = _mm256_zextsi128_si256(_mm_cvtsi32_si128(static_cast<int>(a * count)));
+		__m256i sumA     = zero;
+		__m256i sumB     = _mm256_zextsi128_si256(_mm_cvtsi32_si128(static_cast<int>(b)));
+
+		for (; count; --count, data += 32)
+		{
+			__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+
+			previous = _mm256_add_epi32(previous, sumA);
+
+			sumA = _mm256_add_epi32(sumA, _mm256_sad_epu8(block, zero));
+			sumB = _mm256_add_epi32(sumB,
+			                        _mm256_madd_epi16(_mm256_maddubs_epi16(block, taps), ones));
+		}
+
+		sumB = _mm256_add_epi32(sumB, _mm256_slli_epi32(previous, 5));
+
+		a = (a + horizontal_sum(sumA)) % adlerBase;
+		b = horizontal_sum(sumB) % adlerBase;
+	}
+
+	return adler32_scalar(b << 16 | a, data, size);
+}
+
+static constexpr KernelTable<std::uint32_t(std::uint32_t, const std::uint8_t*, std::size_t)>
+    adlerKernels { adler32_scalar, adler32_scalar, adler32_ssse3, adler32_avx2, adler32_avx2 };
+#else
+static constexpr KernelTable<std::uint32_t(std::uint32_t, const std::uint8_t*, std::size_t)>
+    adlerKernels { adler32_scalar, adler32_scalar, adler32_scalar, adler32_scalar,
+	               adler32_scalar };
+#endif
+
+std::uint32_t adler32(std::uint32_t adler, const std::uint8_t* data, std::size_t size)
+{
+	return select_kernel(adlerKernels)(adler, data, size);
+}
+
+// Inflates the deflate blocks of args.input into args.output. Returns the offset of the adler32
+// trailer once the final block has ended, nothing when outputLimit stopped inflating before that.
+// Inlined into every inflate kernel so each copy of the bit reader is compiled for its level.
+template <typename Allocator>
+static TRV_PNG_INLINE std::optional<std::size_t> inflate_blocks(
+    BasicDeflateArgs<Allocator>& args, BitConsumer<std::endian::little>& deflateConsumer,
+    InflateTables& tables, [[maybe_unused]] unsigned long window)
+{
+	typename BasicDeflateArgs<Allocator>::Output& output = args.output;
+
+	DecodeStats* stats = collect_stats(args.stats);
 
 	bool is_final = false;
 	while (!is_final)
 	{
+		TraceScope trace("inflate_block");
+
 		is_final = deflateConsumer.consume_bits<uint8_t, std::endian::little>(1);
 		enum BTYPES type =
 		    static_cast<BTYPES>(deflateConsumer.consume_bits<uint8_t, std::endian::little>(2));
+		trace.set_arg("type", static_cast<std::uint64_t>(type));
+
+		if (stats && type != BTYPES::Err)
+		{
+			++stats->blocks[static_cast<std::size_t>(type)];
+		}
 
 		if (type == BTYPES::None)
 		{
@@ -73,6 +403,11 @@ void decompress(DeflateArgs& args)
 
 			for (int i = 0; i < len; ++i)
 			{
+				if (output.size() == args.outputLimit)
+				{
+					return std::nullopt;
+				}
+
 				output.push_back(deflateConsumer.consume_bits<uint8_t, std::endian::little>(8));
 			}
 		}
@@ -84,178 +419,332 @@ void decompress(DeflateArgs& args)
 		}
 		else
 		{
-			std::unique_ptr<Huffman<uint32_t>> LitLenHuffman, DistHuffman;
-			if (type == BTYPES::DynamicHuff)
+			bool dynamic = type == BTYPES::DynamicHuff;
+			if (dynamic)
 			{
-				std::uint16_t HLIT =
-				    deflateConsumer.consume_bits<uint16_t, std::endian::little>(5) + 257;
-				std::uint16_t HDIST =
-				    deflateConsumer.consume_bits<uint16_t, std::endian::little>(5) + 1;
-				std::uint16_t HCLEN =
-				    deflateConsumer.consume_bits<uint16_t, std::endian::little>(4) + 4;
+				read_dynamic_tables(deflateConsumer, tables);
 
-				std::array<size_t, 19> HCLENSwizzle = { 16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
-					                                    11, 4,  12, 3, 13, 2, 14, 1, 15 };
+				if (stats)
+				{
+					stats->huffmanTables += 2;
+				}
+			}
 
-				std::array<uint16_t, 19> HCLENTable {};
+			// One symbol past outputLimit is decoded, so that a stream ending right at the limit
+			// still reaches its end of block and trailer
+			while (true)
+			{
+				std::uint32_t litLen;
+				if (dynamic)
+				{
+					litLen = tables.litLen.decode(deflateConsumer);
+				}
+				else
+				{
+					litLen = decode_fixed_lit_len(deflateConsumer);
+				}
 
-				for (uint32_t i = 0; i < HCLEN; ++i)
+				if (litLen == 256)  // End of block
 				{
-					HCLENTable[HCLENSwizzle[i]] =
-					    deflateConsumer.consume_bits<uint16_t, std::endian::little>(3);
+					break;
 				}
 
-				Huffman<uint16_t> dictHuffman(8, 19, HCLENTable.data());
-				std::uint16_t litLenCount = 0;
-				std::uint16_t lenCount    = HLIT + HDIST;
-				std::vector<uint32_t> litLenDistTable(lenCount);
+				if (output.size() == args.outputLimit)
+				{
+					return std::nullopt;
+				}
 
-				while (litLenCount < lenCount)
+				if (litLen < 256)  // Literal
+				{
+					output.push_back(static_cast<uint8_t>(litLen));
+				}
+				else  // Length
 				{
-					std::uint16_t repetitions = 1;
-					std::uint16_t repeated    = 0;
-					std::uint16_t encodedLen  = dictHuffman.decode(deflateConsumer);
+					auto [length, distance] = read_match(
+					    deflateConsumer, litLen, dynamic ? &tables.dist : nullptr, stats);
 
-					if (encodedLen <= 15)
+					if (distance > output.size())
 					{
-						repeated = encodedLen;
+						throw std::runtime_error(
+						    "TRV::ZLIB::DECOMPRESS Match distance reaches before the stream.");
 					}
-					else if (encodedLen == 16)
-					{
-						if (!litLenCount)
-						{
-							throw std::runtime_error(
-							    "TRV::ZLIB::DECOMPRESS Repeat code found on "
-							    "first pass, therefore nothing can be repeated.");
-						}
-						repetitions =
-						    deflateConsumer.consume_bits<uint16_t, std::endian::little>(2) + 3;
 
-#ifdef MSVC
-#pragma warning( \
-    suppress : 6385)  // 16 cannot appear before <= 15 according to the deflate specificaition ^ I check above in case of corrupt data.
-#endif
-						repeated = static_cast<uint16_t>(litLenDistTable[litLenCount - 1]);
-					}
-					else if (encodedLen == 17)
-					{
-						repetitions =
-						    deflateConsumer.consume_bits<uint16_t, std::endian::little>(3) + 3;
-					}
-					else if (encodedLen == 18)
-					{
-						repetitions =
-						    deflateConsumer.consume_bits<uint16_t, std::endian::little>(7) + 11;
-					}
-					else
+					assert(distance <= window);
+					std::size_t offset = output.size() - distance;
+					std::size_t count =
+					    std::min<std::size_t>(length, args.outputLimit - output.size());
+					//output.reserve(output.size() + length);
+					for (size_t from = offset; from < offset + count; ++from)
 					{
-						throw std::runtime_error(
-						    "TRV::ZLIB::DECOMPRESS Unexpected encoded length.");
+						output.emplace_back(output[from]);
 					}
 
-					while (repetitions--)
+					if (count < length)
 					{
-						litLenDistTable[litLenCount++] = repeated;
+						return std::nullopt;
 					}
 				}
-
-				LitLenHuffman = std::make_unique<Huffman<uint32_t>>(
-				    static_cast<std::uint8_t>(16), HLIT, litLenDistTable.data());
-				DistHuffman = std::make_unique<Huffman<uint32_t>>(
-				    static_cast<std::uint8_t>(16), HDIST, litLenDistTable.data() + HLIT);
 			}
+		}
+	}
 
-			while (true)
+	deflateConsumer.flush_byte();
+
+	return deflateConsumer.bytes_consumed();
+}
+
+template <typename Allocator>
+static std::optional<std::size_t> inflate_scalar(BasicDeflateArgs<Allocator>& args,
+                                                 BitConsumer<std::endian::little>& consumer,
+                                                 InflateTables& tables, unsigned long window)
+{
+	return inflate_blocks(args, consumer, tables, window);
+}
+
+// The bit reader's variable shifts and masks become SHRX and BZHI. Dispatched per stream rather
+// than per read, an indirect call for every symbol would cost more than the instructions save.
+template <typename Allocator>
+TRV_PNG_TARGET("bmi,bmi2,lzcnt")
+static std::optional<std::size_t> inflate_bmi2(BasicDeflateArgs<Allocator>& args,
+                                               BitConsumer<std::endian::little>& consumer,
+                                               InflateTables& tables, unsigned long window)
+{
+	return inflate_blocks(args, consumer, tables, window);
+}
+
+template <typename Allocator>
+using InflateKernel = std::optional<std::size_t>(BasicDeflateArgs<Allocator>&,
+                                                 BitConsumer<std::endian::little>&,
+                                                 InflateTables&, unsigned long);
+
+#ifdef TRV_PNG_X86
+template <typename Allocator>
+static constexpr KernelTable<InflateKernel<Allocator>> inflateKernels {
+	inflate_scalar<Allocator>, inflate_scalar<Allocator>, inflate_scalar<Allocator>,
+	inflate_bmi2<Allocator>, inflate_bmi2<Allocator>
+};
+#else
+template <typename Allocator>
+static constexpr KernelTable<InflateKernel<Allocator>> inflateKernels {
+	inflate_scalar<Allocator>, inflate_scalar<Allocator>, inflate_scalar<Allocator>,
+	inflate_scalar<Allocator>, inflate_scalar<Allocator>
+};
+#endif
+
+template <typename Allocator>
+void decompress(BasicDeflateArgs<Allocator>& args)
+{
+	BitConsumer<std::endian::big> zlibConsumer(args.input);
+
+	std::uint8_t CMF = zlibConsumer.consume_bits<uint8_t, std::endian::big>(8);
+	std::uint8_t FLG = zlibConsumer.consume_bits<uint8_t, std::endian::big>(8);
+
+	check_header(CMF, FLG, args.png);
+
+	unsigned long window = 1L << (((CMF & CINFOFilter) >> CINFOOffset) + 8);
+
+	if (FLG & FDICTFilter)
+	{
+		[[maybe_unused]] std::uint32_t FDICT =
+		    zlibConsumer.consume_bits<uint32_t, std::endian::big>(32);
+
+		// TODO: Understand what to use this for.
+	}
+
+	InflateTables localTables;
+	InflateTables& tables = args.tables ? *args.tables : localTables;
+
+	BitConsumer<std::endian::little> deflateConsumer(zlibConsumer);
+
+	std::optional<std::size_t> trailer =
+	    select_kernel(inflateKernels<Allocator>)(args, deflateConsumer, tables, window);
+
+	// Output cut short by outputLimit can't be checked
+	if (!trailer)
+	{
+		return;
+	}
+
+	if (args.input.size() < *trailer + 4)
+	{
+		throw std::runtime_error("TRV::ZLIB::DECOMPRESS Stream ends before its ADLER32.");
+	}
+
+	std::uint32_t expected = 0;
+
+	for (std::size_t byte = 0; byte < 4; ++byte)
+	{
+		expected = expected << 8 | args.input[*trailer + byte];
+	}
+
+	if (adler32(1, args.output.data(), args.output.size()) != expected)
+	{
+		throw std::runtime_error("TRV::ZLIB::DECOMPRESS ADLER32 doesn't match the output.");
+	}
+}
+
+template void decompress(DeflateArgs& args);
+template void decompress(BasicDeflateArgs<std::pmr::polymorphic_allocator<unsigned char>>& args);
+
+// Zero bytes appended once the source runs dry, enough for any read between two fills so that a
+// truncated stream is caught by fill instead of reading past the buffer.
+static constexpr std::size_t inflaterPadding = 1024;
+
+Inflater::Inflater(bool png, Source source) :
+    m_source(std::move(source)), m_consumer(m_input), m_window(windowSize)
+{
+	fill(6);
+
+	std::uint8_t CMF = m_consumer.consume_bits<uint8_t, std::endian::little>(8);
+	std::uint8_t FLG = m_consumer.consume_bits<uint8_t, std::endian::little>(8);
+
+	check_header(CMF, FLG, png);
+
+	if (FLG & FDICTFilter)
+	{
+		m_consumer.discard_bits(32);
+	}
+}
+
+void Inflater::fill(std::size_t bytes)
+{
+	while (!m_exhausted && m_input.size() - m_consumer.bytes_consumed() < bytes)
+	{
+		// Consumed input is dropped first, the buffer never holds much more than one chunk
+		std::size_t consumed = m_consumer.bytes_consumed();
+		m_input.erase(m_input.begin(), m_input.begin() + static_cast<std::ptrdiff_t>(consumed));
+		m_consumer.drop_bytes(consumed);
+
+		if (!m_source(m_input))
+		{
+			m_exhausted = true;
+			m_inputEnd  = m_input.size();
+			m_input.resize(m_inputEnd + inflaterPadding);
+		}
+	}
+
+	if (m_exhausted && m_consumer.bytes_consumed() > m_inputEnd)
+	{
+		throw std::runtime_error("TRV::ZLIB::INFLATER Compressed data ended unexpectedly.");
+	}
+}
+
+std::size_t Inflater::read(std::uint8_t* dst, std::size_t count)
+{
+	std::uint8_t* begin = dst;
+	std::uint8_t* end   = dst + count;
+
+	while (dst < end)
+	{
+		if (m_matchRemaining)
+		{
+			for (; m_matchRemaining && dst < end; --m_matchRemaining)
 			{
-				std::uint32_t litLen;
-				if (type == BTYPES::DynamicHuff)
-				{
-					litLen = LitLenHuffman->decode(deflateConsumer);
-				}
-				else
-				{
-					std::uint16_t code = deflateConsumer.peek_bits<uint16_t, std::endian::big>(9);
-					std::uint16_t bits = 0;
+				put(dst, m_window[(m_written - m_matchDistance) & (windowSize - 1u)]);
+			}
+			continue;
+		}
 
-					if (code >= FIXED_LIT_0_143_LOWER && code <= FIXED_LIT_0_143_UPPER)
-					{
-						litLen = (code >> (9 - FIXED_LIT_0_143_LENGTH)) - FIXED_LIT_0_143_ROOT +
-						         FIXED_LIT_0_143_OFFSET;
-						bits = FIXED_LIT_0_143_LENGTH;
-					}
-					else if (code >= FIXED_LIT_144_255_LOWER && code <= FIXED_LIT_144_255_UPPER)
+		switch (m_state)
+		{
+			case State::BlockHeader:
+				{
+					if (m_final)
 					{
-						litLen = (code >> (9 - FIXED_LIT_144_255_LENGTH)) - FIXED_LIT_144_255_ROOT +
-						         FIXED_LIT_144_255_OFFSET;
-						bits = FIXED_LIT_144_255_LENGTH;
+						m_state = State::Done;
+						break;
 					}
-					else if (code >= FIXED_LIT_256_279_LOWER && code <= FIXED_LIT_256_279_UPPER)
+
+					fill(inflaterPadding);
+
+					m_final = m_consumer.consume_bits<uint8_t, std::endian::little>(1);
+					enum BTYPES type = static_cast<BTYPES>(
+					    m_consumer.consume_bits<uint8_t, std::endian::little>(2));
+
+					if (type == BTYPES::None)
 					{
-						litLen = (code >> (9 - FIXED_LIT_256_279_LENGTH)) - FIXED_LIT_256_279_ROOT +
-						         FIXED_LIT_256_279_OFFSET;
-						bits = FIXED_LIT_256_279_LENGTH;
+						m_consumer.flush_byte();
+						std::uint16_t len =
+						    m_consumer.consume_bits<uint16_t, std::endian::little>(16);
+						std::uint16_t nlen =
+						    m_consumer.consume_bits<uint16_t, std::endian::little>(16);
+
+						if ((len ^ 0xFFFF) != nlen)
+						{
+							throw std::runtime_error(
+							    "TRV::ZLIB::INFLATER Unable to read properly, LEN and NLEN "
+							    "don't line up.");
+						}
+
+						m_storedRemaining = len;
+						m_state           = State::Stored;
 					}
-					else if (code >= FIXED_LIT_280_287_LOWER && code <= FIXED_LIT_280_287_UPPER)
+					else if (type == BTYPES::Err)
 					{
-						litLen = (code >> (9 - FIXED_LIT_280_287_LENGTH)) - FIXED_LIT_280_287_ROOT +
-						         FIXED_LIT_280_287_OFFSET;
-						bits = FIXED_LIT_280_287_LENGTH;
+						throw std::runtime_error(
+						    "TRV::ZLIB::INFLATER Encountered unexpected block type 3(Err).");
 					}
 					else
 					{
-						throw std::runtime_error(
-						    "TRV::ZLIB::DECOMPRES Invalid code encountered in "
-						    "fixed huffman.");
-					}
+						m_dynamic = type == BTYPES::DynamicHuff;
 
-					deflateConsumer.discard_bits(bits);
-				}
+						if (m_dynamic)
+						{
+							read_dynamic_tables(m_consumer, m_tables);
+						}
 
-				if (litLen < 256)  // Literal
+						m_state = State::Codes;
+					}
+					break;
+				}
+			case State::Stored:
+				if (!m_storedRemaining)
 				{
-					output.push_back(static_cast<uint8_t>(litLen));
+					m_state = State::BlockHeader;
+					break;
 				}
-				else if (litLen >= 257)  // Length
+
+				fill(1);
+				put(dst, m_consumer.consume_bits<uint8_t, std::endian::little>(8));
+				--m_storedRemaining;
+				break;
+			case State::Codes:
 				{
-					assert(litLen <= 285);
-					std::uint8_t lenIndex       = static_cast<uint8_t>(litLen - 257);
-					std::uint16_t length        = lengthExtraTable[lenIndex * 2];
-					std::size_t extraLengthBits = lengthExtraTable[lenIndex * 2 + 1];
-					length += deflateConsumer.consume_bits<uint16_t, std::endian::little>(
-					    extraLengthBits);
+					fill(8);
 
-					std::uint32_t distIndex;
+					std::uint32_t litLen = m_dynamic ? m_tables.litLen.decode(m_consumer)
+					                                 : decode_fixed_lit_len(m_consumer);
 
-					if (type == BTYPES::DynamicHuff)
+					if (litLen < 256)
 					{
-						distIndex = DistHuffman->decode(deflateConsumer);
+						put(dst, static_cast<uint8_t>(litLen));
 					}
-					else
+					else if (litLen == 256)
 					{
-						distIndex = deflateConsumer.consume_bits<uint32_t, std::endian::big>(5);
+						m_state = State::BlockHeader;
 					}
+					else
+					{
+						auto [length, distance] =
+						    read_match(m_consumer, litLen, m_dynamic ? &m_tables.dist : nullptr);
 
-					assert(distIndex < 30);
-					std::uint16_t distance        = distanceExtraTable[distIndex * 2];
-					std::size_t extraDistanceBits = distanceExtraTable[distIndex * 2 + 1];
-					distance += deflateConsumer.consume_bits<uint16_t, std::endian::little>(
-					    extraDistanceBits);
+						if (distance > m_written || distance > windowSize)
+						{
+							throw std::runtime_error(
+							    "TRV::ZLIB::INFLATER Match distance reaches before the "
+							    "stream.");
+						}
 
-					assert(output.size() > distance);
-					assert(distance < window);
-					std::size_t offset = output.size() - distance;
-					//output.reserve(output.size() + length);
-					for (size_t from = offset; from < offset + length; ++from)
-					{
-						output.emplace_back(output[from]);
+						m_matchRemaining = length;
+						m_matchDistance  = distance;
 					}
-				}
-				else  // End of block
-				{
 					break;
 				}
-			}
+			case State::Done:
+				return static_cast<std::size_t>(dst - begin);
 		}
 	}
+
+	return static_cast<std::size_t>(dst - begin);
 }
 }
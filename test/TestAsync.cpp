@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Async.hpp"
+#include "ThreadPool.hpp"
+
+static const std::vector<std::string> files = { "rgba_bit_depth_16.png",
+	                                            "gray_bit_depth_1.png",
+	                                            "ga_bit_depth_16_adam7.png",
+	                                            "plte_bit_depth_4_trns.png",
+	                                            "rgb_bit_depth_16_trns_adam7.png" };
+
+TEST(TestAsync, TestLoadImageAsync)
+{
+	trv::ThreadPool pool(3);
+	trv::Executor executor = [&pool](std::function<void()> work) { pool.submit(std::move(work)); };
+
+	for (const auto& file : files)
+	{
+		const std::string path { "./samples/" + file };
+
+		trv::Image<std::uint16_t> expected { trv::load_image<std::uint16_t>(path) };
+
+		// The default executor and an injected one
+		for (const trv::Executor& chosen : { trv::Executor {}, executor })
+		{
+			trv::Image<std::uint16_t> img {
+				trv::sync_wait(trv::load_image_async<std::uint16_t>(path, {}, chosen))
+			};
+			EXPECT_EQ(img.data, expected.data) << file;
+
+			std::future<trv::Image<std::uint16_t>> future =
+			    trv::load_image_future<std::uint16_t>(path, {}, chosen);
+			EXPECT_EQ(future.get().data, expected.data) << file;
+		}
+	}
+
+	EXPECT_THROW(std::ignore = trv::sync_wait(
+	                 trv::load_image_async<std::uint8_t>("./samples/missing.png", {}, executor)),
+	             std::runtime_error);
+	EXPECT_THROW(std::ignore =
+	                 trv::load_image_future<std::uint8_t>("./samples/missing.png", {}, executor)
+	                     .get(),
+	             std::runtime_error);
+}
+
+TEST(TestAsync, TestReadOnCaller)
+{
+	// Holds on to the decodes it is given, reading has to happen before them
+	std::vector<std::function<void()>> deferred;
+	trv::Executor executor = [&deferred](std::function<void()> work)
+	{ deferred.push_back(std::move(work)); };
+
+	EXPECT_THROW(std::ignore = trv::sync_wait(
+	                 trv::load_image_async<std::uint8_t>("./samples/missing.png", {}, executor)),
+	             std::runtime_error);
+	EXPECT_THROW(std::ignore =
+	                 trv::load_image_future<std::uint8_t>("./samples/missing.png", {}, executor)
+	                     .get(),
+	             std::runtime_error);
+	EXPECT_TRUE(deferred.empty());
+
+	const std::string path { "./samples/" + files[0] };
+	std::future<trv::Image<std::uint8_t>> future =
+	    trv::load_image_future<std::uint8_t>(path, {}, executor);
+
+	ASSERT_EQ(deferred.size(), 1);
+	deferred[0]();
+	EXPECT_EQ(future.get().data, trv::load_image<std::uint8_t>(path).data);
+
+	trv::Task<trv::Image<std::uint8_t>> task = trv::load_image_async<std::uint8_t>(path);
+	trv::Task<trv::Image<std::uint8_t>> moved = std::move(task);
+
+	EXPECT_THROW(std::ignore = trv::sync_wait(std::move(task)), std::runtime_error);
+	EXPECT_EQ(trv::sync_wait(std::move(moved)).data, trv::load_image<std::uint8_t>(path).data);
+}
+
+// Parameters rather than lambda captures, a coroutine outlives the lambda object that started it.
+static trv::DetachedTask decode_and_count(std::string path, const trv::Executor& executor,
+                                          const trv::SampleBuffer<std::uint8_t>& expected,
+                                          std::atomic<std::size_t>& mismatches,
+                                          std::size_t& completed, std::mutex& mutex,
+                                          std::condition_variable& finished)
+{
+	trv::Image<std::uint8_t> img = co_await trv::load_image_async<std::uint8_t>(path, {}, executor);
+
+	if (img.data != expected)
+	{
+		++mismatches;
+	}
+
+	std::lock_guard lock(mutex);
+	++completed;
+	finished.notify_one();
+}
+
+TEST(TestAsync, TestManyInFlight)
+{
+	trv::ThreadPool pool(3);
+	trv::Executor executor = [&pool](std::function<void()> work) { pool.submit(std::move(work)); };
+
+	constexpr std::size_t decodes = 200;
+
+	std::mutex mutex;
+	std::condition_variable finished;
+	std::size_t completed = 0;
+	std::atomic<std::size_t> mismatches = 0;
+
+	std::vector<trv::SampleBuffer<std::uint8_t>> expected;
+
+	for (const auto& file : files)
+	{
+		expected.push_back(trv::load_image<std::uint8_t>("./samples/" + file).data);
+	}
+
+	// Every coroutine is suspended in its decode before the first completes
+	for (std::size_t index = 0; index < decodes; ++index)
+	{
+		decode_and_count("./samples/" + files[index % files.size()], executor,
+		                 expected[index % files.size()], mismatches, completed, mutex, finished);
+	}
+
+	std::unique_lock lock(mutex);
+	finished.wait(lock, [&]() { return completed == decodes; });
+
+	EXPECT_EQ(mismatches.load(), 0);
+}
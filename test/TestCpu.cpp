@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CRC.hpp"
+#include "Cpu.hpp"
+#include "Expand.hpp"
+#include "Filter.hpp"
+#include "Image.hpp"
+#include "ThreadPool.hpp"
+#include "Zlib.hpp"
+
+// Runs a test body once per level this machine supports, then restores the level it started at.
+class TestCpu : public testing::Test
+{
+   protected:
+	void TearDown() override { trv::set_cpu_level(m_level); }
+
+	template <typename F>
+	void for_each_level(F&& body)
+	{
+		for (std::size_t level = 0; level <= static_cast<std::size_t>(trv::detected_cpu_level());
+		     ++level)
+		{
+			trv::CpuLevel cpuLevel = trv::set_cpu_level(static_cast<trv::CpuLevel>(level));
+			SCOPED_TRACE(trv::cpu_level_name(cpuLevel));
+			body();
+		}
+	}
+
+   private:
+	trv::CpuLevel m_level = trv::cpu_level();
+};
+
+static std::vector<unsigned char> random_bytes(std::size_t size, std::uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> byte(0, 255);
+	std::vector<unsigned char> bytes(size);
+
+	for (unsigned char& value : bytes)
+	{
+		value = static_cast<unsigned char>(byte(rng));
+	}
+
+	return bytes;
+}
+
+TEST_F(TestCpu, TestLevels)
+{
+	EXPECT_EQ(trv::set_cpu_level(trv::CpuLevel::AVX512), trv::detected_cpu_level());
+	EXPECT_EQ(trv::cpu_level(), trv::detected_cpu_level());
+	EXPECT_EQ(trv::set_cpu_level(trv::CpuLevel::Scalar), trv::CpuLevel::Scalar);
+	EXPECT_EQ(trv::cpu_level(), trv::CpuLevel::Scalar);
+
+	for (std::size_t level = 0; level < trv::cpuLevels; ++level)
+	{
+		trv::CpuLevel cpuLevel = static_cast<trv::CpuLevel>(level);
+		EXPECT_EQ(trv::parse_cpu_level(trv::cpu_level_name(cpuLevel)), cpuLevel);
+	}
+
+	EXPECT_EQ(trv::parse_cpu_level("avx3"), std::nullopt);
+}
+
+TEST_F(TestCpu, TestChecksums)
+{
+	// Room for the largest size at the largest offset
+	std::vector<unsigned char> data = random_bytes(20008, 1);
+	// Runs of 255 reach the largest sums adler32 has to hold before reducing them
+	std::vector<unsigned char> ones(20008, 255);
+
+	for (std::size_t size : { 0, 1, 15, 16, 31, 32, 63, 64, 65, 127, 300, 5552, 5553, 19999 })
+	{
+		for (std::size_t offset : { 0, 1, 7 })
+		{
+			trv::set_cpu_level(trv::CpuLevel::Scalar);
+			std::uint32_t crc       = trv::crc32_update(0xFFFFFFFFu, data.data() + offset, size);
+			std::uint32_t adler     = trv::adler32(1, data.data() + offset, size);
+			std::uint32_t adlerOnes = trv::adler32(1, ones.data() + offset, size);
+
+			for_each_level(
+			    [&]()
+			    {
+				    EXPECT_EQ(trv::crc32_update(0xFFFFFFFFu, data.data() + offset, size), crc)
+				        << size;
+				    EXPECT_EQ(trv::adler32(1, data.data() + offset, size), adler) << size;
+				    EXPECT_EQ(trv::adler32(1, ones.data() + offset, size), adlerOnes) << size;
+			    });
+		}
+	}
+
+	// Known values of "123456789"
+	const std::string check = "123456789";
+	const auto* bytes       = reinterpret_cast<const std::uint8_t*>(check.data());
+
+	for_each_level(
+	    [&]()
+	    {
+		    EXPECT_EQ(trv::crc32_update(0xFFFFFFFFu, bytes, check.size()) ^ 0xFFFFFFFFu,
+		              0xCBF43926u);
+		    EXPECT_EQ(trv::adler32(1, bytes, check.size()), 0x091E01DEu);
+	    });
+}
+
+TEST_F(TestCpu, TestUnfilter)
+{
+	trv::ThreadPool pool(2);
+	const std::size_t scanlines = 12;
+
+	for (std::size_t bpp = 1; bpp <= 8; ++bpp)
+	{
+		// Rows of an uneven number of pixels, with every filter type in turn
+		const std::size_t byteWidth = 1 + bpp * 37 + (bpp > 1 ? 1 : 0);
+		std::vector<unsigned char> filtered =
+		    random_bytes(scanlines * byteWidth, static_cast<std::uint32_t>(bpp));
+
+		for (std::size_t scanline = 0; scanline < scanlines; ++scanline)
+		{
+			filtered[scanline * byteWidth] = static_cast<unsigned char>(scanline % 5);
+		}
+
+		trv::set_cpu_level(trv::CpuLevel::Scalar);
+		std::vector<unsigned char> expected = filtered;
+		trv::do_unfilter(expected, 0, scanlines, byteWidth, bpp);
+
+		for_each_level(
+		    [&]()
+		    {
+			    SCOPED_TRACE(bpp);
+
+			    std::vector<unsigned char> serial = filtered;
+			    trv::do_unfilter(serial, 0, scanlines, byteWidth, bpp);
+			    EXPECT_EQ(serial, expected);
+
+			    // Column blocks that start and end inside pixels
+			    std::vector<unsigned char> wavefront = filtered;
+			    trv::do_unfilter_wavefront(wavefront, 0, scanlines, byteWidth, bpp, 2, 13, &pool);
+			    EXPECT_EQ(wavefront, expected);
+		    });
+	}
+}
+
+TEST_F(TestCpu, TestExpand)
+{
+	const std::size_t samples        = 200;
+	std::vector<unsigned char> input = random_bytes(samples * 2 + 1, 3);
+	const std::uint8_t* bytes        = input.data() + 1;
+
+	trv::set_cpu_level(trv::CpuLevel::Scalar);
+	std::vector<std::uint16_t> widened(samples), swapped(samples);
+	std::vector<std::uint8_t> narrowed(samples);
+	trv::widen_8_to_16(bytes, widened.data(), samples);
+	trv::byteswap_16(bytes, swapped.data(), samples);
+	trv::narrow_16_to_8(bytes, narrowed.data(), samples);
+
+	for_each_level(
+	    [&]()
+	    {
+		    for (std::size_t count : { std::size_t { 0 }, std::size_t { 7 }, std::size_t { 33 },
+		                               samples })
+		    {
+			    std::vector<std::uint16_t> wide(count), swap(count);
+			    std::vector<std::uint8_t> narrow(count);
+			    trv::widen_8_to_16(bytes, wide.data(), count);
+			    trv::byteswap_16(bytes, swap.data(), count);
+			    trv::narrow_16_to_8(bytes, narrow.data(), count);
+
+			    EXPECT_TRUE(std::equal(wide.begin(), wide.end(), widened.begin())) << count;
+			    EXPECT_TRUE(std::equal(swap.begin(), swap.end(), swapped.begin())) << count;
+			    EXPECT_TRUE(std::equal(narrow.begin(), narrow.end(), narrowed.begin())) << count;
+		    }
+	    });
+}
+
+TEST_F(TestCpu, TestDecode)
+{
+	for (const char* path : { "./samples/rgba_bit_depth_16.png", "./samples/rgb_bit_depth_16.png",
+	                          "./samples/ga_bit_depth_16_adam7.png",
+	                          "./samples/plte_bit_depth_8.png", "./samples/gray_bit_depth_16.png" })
+	{
+		trv::set_cpu_level(trv::CpuLevel::Scalar);
+		auto narrow = trv::load_image<std::uint8_t>(path);
+		auto wide   = trv::load_image<std::uint16_t>(path);
+
+		for_each_level(
+		    [&]()
+		    {
+			    SCOPED_TRACE(path);
+			    EXPECT_EQ(trv::load_image<std::uint8_t>(path).data, narrow.data);
+			    EXPECT_EQ(trv::load_image<std::uint16_t>(path).data, wide.data);
+		    });
+	}
+}
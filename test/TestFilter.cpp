@@ -1,10 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <cmath>
 #include <limits>
-
-#ifndef TRV_TEST_MULTITHREADED
-#undef TRV_PNG_MULTITHREADED
-#endif
+#include <random>
 
 #include "Filter.hpp"
 
@@ -124,3 +122,237 @@ TEST(TestFilter, TestNoFilterI32)
 		EXPECT_EQ(val, std::numeric_limits<std::int32_t>::max());
 	}
 }
+
+TEST(TestFilter, TestWavefrontMatchesSerial)
+{
+	static constexpr std::size_t scanlines = 37;
+	static constexpr std::size_t byteWidth = 1 + 3 * 101;
+	static constexpr std::size_t bpp       = 3;
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> byteDist(0, 255);
+	std::uniform_int_distribution<int> filterDist(0, 4);
+
+	std::vector<unsigned char> serial(scanlines * byteWidth);
+
+	for (std::size_t i = 0; i < serial.size(); ++i)
+	{
+		serial[i] = static_cast<unsigned char>(i % byteWidth ? byteDist(rng) : filterDist(rng));
+	}
+
+	std::vector<unsigned char> wavefront = serial;
+	std::vector<unsigned char> reused    = serial;
+
+	trv::do_unfilter(serial, 0, scanlines, byteWidth, bpp);
+	trv::do_unfilter_wavefront(wavefront, 0, scanlines, byteWidth, bpp, 4, 16);
+
+	EXPECT_EQ(serial, wavefront);
+
+	// More lanes than pool threads, or fewer, still finish every row
+	trv::ThreadPool pool(3);
+	std::vector<unsigned char> again = reused;
+
+	trv::do_unfilter_wavefront(reused, 0, scanlines, byteWidth, bpp, 2, 16, &pool);
+	trv::do_unfilter_wavefront(again, 0, scanlines, byteWidth, bpp, 8, 16, &pool);
+
+	EXPECT_EQ(serial, reused);
+	EXPECT_EQ(serial, again);
+}
+
+TEST(TestFilter, TestWavefrontRejectsInvalidFilter)
+{
+	std::vector<unsigned char> input(4 * 65, 0);
+	input[2 * 65] = 5;
+
+	EXPECT_THROW(trv::do_unfilter_wavefront(input, 0, 4, 65, 1, 2, 8), std::runtime_error);
+}
+
+TEST(TestFilter, TestWavefrontPlan)
+{
+	trv::ThreadPool pool(3);
+
+	trv::ParallelismPolicy serial { trv::Parallelism::Serial, 0, 0, &pool };
+	EXPECT_EQ(trv::plan_wavefront(100000, 100001, 4, serial).lanes, 1);
+
+	trv::ParallelismPolicy parallel { trv::Parallelism::Parallel, 0, 0, &pool };
+	trv::WavefrontPlan plan = trv::plan_wavefront(11, 40, 4, parallel);
+	EXPECT_EQ(plan.lanes, 4);
+	EXPECT_EQ(plan.blockSize, trv::wavefrontBlockSize);
+
+	parallel.threads   = 2;
+	parallel.blockSize = 16;
+	plan               = trv::plan_wavefront(11, 40, 4, parallel);
+	EXPECT_EQ(plan.lanes, 2);
+	EXPECT_EQ(plan.blockSize, 16);
+
+	// An icon stays on the calling thread, a huge image uses every thread
+	trv::ParallelismPolicy automatic { trv::Parallelism::Auto, 0, 0, &pool };
+	EXPECT_EQ(trv::plan_wavefront(16, 65, 4, automatic).lanes, 1);
+	EXPECT_EQ(trv::plan_wavefront(16384, 65537, 4, automatic).lanes, 4);
+}
+
+TEST(TestFilter, TestSubByteTable)
+{
+	constexpr auto& table = trv::subByteTable<std::uint8_t, 2, true>;
+
+	static_assert(table.entries[0b00011011][0] == 0);
+	static_assert(table.entries[0b00011011][1] == 85);
+	static_assert(table.entries[0b00011011][2] == 170);
+	static_assert(table.entries[0b00011011][3] == 255);
+
+	std::vector<unsigned char> packed { 0b10110000, 0b01000000 };
+	std::vector<std::uint8_t> unpacked(9, 0xAA);
+
+	trv::unpack_sub_byte_row<std::uint8_t, 1>(packed.data(), unpacked.data(), 8);
+
+	EXPECT_EQ(unpacked, (std::vector<std::uint8_t> { 255, 0, 255, 255, 0, 0, 0, 0, 0xAA }));
+}
+
+// Reference rounding of convertBitDepth, round(val * max(T) / max(input))
+template <std::uint8_t BitDepth, std::integral T>
+static void expect_exact_scaling()
+{
+	long double inputMax  = static_cast<long double>((1ull << BitDepth) - 1ull);
+	long double outputMax = static_cast<long double>(std::numeric_limits<T>::max());
+
+	for (std::uint32_t val = 0; val < (1u << BitDepth); val += 1 + (BitDepth == 16) * 250)
+	{
+		long double expected = std::floor(val * outputMax / inputMax + 0.5L);
+		EXPECT_EQ(static_cast<long double>(trv::convertBitDepth<BitDepth, T>(val)), expected)
+		    << +BitDepth << " bits, value " << val;
+	}
+}
+
+TEST(TestFilter, TestConvertBitDepth)
+{
+	expect_exact_scaling<1, std::uint8_t>();
+	expect_exact_scaling<2, std::int8_t>();
+	expect_exact_scaling<4, std::int16_t>();
+	expect_exact_scaling<8, std::uint16_t>();
+	expect_exact_scaling<8, std::int16_t>();
+	expect_exact_scaling<8, std::int32_t>();
+	expect_exact_scaling<8, std::uint32_t>();
+	expect_exact_scaling<16, std::int8_t>();
+	expect_exact_scaling<16, std::uint32_t>();
+	expect_exact_scaling<16, std::int32_t>();
+
+	static_assert(trv::convertBitDepth<16, std::uint64_t>(65535) ==
+	              std::numeric_limits<std::uint64_t>::max());
+	static_assert(trv::convertBitDepth<16, std::int64_t>(65535) ==
+	              std::numeric_limits<std::int64_t>::max());
+	static_assert(trv::convertBitDepth<8, std::int64_t>(0) == 0);
+}
+
+TEST(TestFilter, TestNarrow16To8)
+{
+	std::vector<unsigned char> input(65536 * 2);
+	std::vector<std::uint8_t> output(65536);
+
+	for (std::uint32_t val = 0; val < 65536; ++val)
+	{
+		input[val * 2]     = static_cast<unsigned char>(val >> 8);
+		input[val * 2 + 1] = static_cast<unsigned char>(val);
+	}
+
+	trv::narrow_16_to_8(input.data(), output.data(), output.size());
+
+	for (std::uint32_t val = 0; val < 65536; ++val)
+	{
+		std::uint32_t expected = (val * 255 * 2 + 65535) / (65535 * 2);
+		ASSERT_EQ(output[val], expected) << val;
+	}
+}
+
+TEST(TestFilter, TestWiden8To16)
+{
+	std::vector<unsigned char> input(256 + 7);
+	std::vector<std::uint16_t> output(input.size());
+
+	for (std::size_t i = 0; i < input.size(); ++i)
+	{
+		input[i] = static_cast<unsigned char>(i * 7);
+	}
+
+	trv::widen_8_to_16(input.data(), output.data(), output.size());
+
+	for (std::size_t i = 0; i < input.size(); ++i)
+	{
+		EXPECT_EQ(output[i], input[i] * 257);
+	}
+}
+
+TEST(TestFilter, TestPaletteExpansion)
+{
+	std::vector<std::uint16_t> output;
+	std::vector<unsigned char> input { 0, 0b00011011, 0b01000000 };
+
+	TestIHDR header { 5, 1, 2, 3, 0, 0, 0 };
+	TestPLTE palette { { 1, 2, 3, 4, 5, 6, 7, 8, 9 } };
+
+	trv::FilterArgs<std::uint16_t> args { input, &header, &palette, output };
+
+	trv::unfilter(args);
+
+	// Index 3 is past the end of PLTE and expands to black
+	std::vector<std::uint16_t> expected { 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 0, 0, 4, 5, 6 };
+
+	for (auto& val : expected)
+	{
+		val *= 257;
+	}
+
+	EXPECT_EQ(output, expected);
+}
+
+TEST(TestFilter, TestTransparencyValidation)
+{
+	TestIHDR header { 1, 1, 8, 6, 0, 0, 0 };
+	trv::TRNS transparency;
+	transparency.data = { 0, 0 };
+
+	EXPECT_THROW(transparency.verify(header, nullptr), std::runtime_error);
+
+	header.colorType = 0;
+	EXPECT_NO_THROW(transparency.verify(header, nullptr));
+
+	header.colorType = 2;
+	EXPECT_THROW(transparency.verify(header, nullptr), std::runtime_error);
+}
+
+TEST(TestFilter, TestByteswap16)
+{
+	std::vector<unsigned char> input(2 * 37);
+	std::vector<std::uint16_t> output(37);
+
+	for (std::size_t i = 0; i < input.size(); ++i)
+	{
+		input[i] = static_cast<unsigned char>(i * 13 + 1);
+	}
+
+	trv::byteswap_16(input.data(), output.data(), output.size());
+
+	for (std::size_t i = 0; i < output.size(); ++i)
+	{
+		EXPECT_EQ(output[i], input[i * 2] << 8 | input[i * 2 + 1]);
+	}
+}
+
+TEST(TestFilter, TestLuminanceAndPremultiply)
+{
+	EXPECT_EQ(trv::luminance<std::uint8_t>(255, 255, 255), 255);
+	EXPECT_EQ(trv::luminance<std::uint16_t>(65535, 65535, 65535), 65535);
+	EXPECT_EQ(trv::luminance<std::uint64_t>(~0ull, ~0ull, ~0ull), ~0ull);
+	EXPECT_EQ(trv::luminance<std::int32_t>(1000, 0, 0), (1000 * 77 + 128) >> 8);
+
+	for (std::uint32_t color = 0; color < 256; color += 5)
+	{
+		for (std::uint32_t alpha = 0; alpha < 256; alpha += 3)
+		{
+			EXPECT_EQ(trv::premultiply<std::uint8_t>(static_cast<std::uint8_t>(color),
+			                                         static_cast<std::uint8_t>(alpha)),
+			          (color * alpha * 2 + 255) / 510);
+		}
+	}
+
+	EXPECT_EQ(trv::premultiply<std::uint16_t>(65535, 65535), 65535);
+}
@@ -1,21 +1,84 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory_resource>
 #include <iostream>
 #include <string>
+#include <tuple>
 #include <vector>
 
-#ifndef TRV_TEST_MULTITHREADED
-#undef TRV_PNG_MULTITHREADED
-#endif
-
+#include "Batch.hpp"
+#include "CRC.hpp"
+#include "Decoder.hpp"
 #include "Image.hpp"
+#include "Zlib.hpp"
+
+// Mirrors the generator used for the samples, sample values are a hash of their position.
+static std::uint32_t sample(std::uint32_t x, std::uint32_t y, std::uint32_t c, std::uint32_t depth)
+{
+	std::uint32_t val = ((x + 1) * 2654435761u) ^ ((y + 1) * 40503u) ^ ((c + 1) * 2246822519u);
+	return val >> (32 - depth);
+}
+
+static std::array<std::uint8_t, 3> palette_entry(std::uint32_t index)
+{
+	return { static_cast<uint8_t>(index * 67 + 11), static_cast<uint8_t>(index * 151 + 23),
+		     static_cast<uint8_t>(index * 199 + 37) };
+}
+
+// An 8 bit grayscale PNG of width x height whose single stored deflate block holds the unfiltered
+// scanlines rows, which may be fewer than height.
+static std::vector<unsigned char> gray_png(std::uint32_t width, std::uint32_t height,
+                                           const std::vector<unsigned char>& rows)
+{
+	std::vector<unsigned char> png { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	auto put32 = [](std::vector<unsigned char>& out, std::uint32_t value)
+	{
+		for (int shift = 24; shift >= 0; shift -= 8)
+		{
+			out.push_back(static_cast<unsigned char>(value >> shift));
+		}
+	};
+
+	auto chunk = [&](const char* type, const std::vector<unsigned char>& data)
+	{
+		std::vector<unsigned char> body(type, type + 4);
+		body.insert(body.end(), data.begin(), data.end());
+
+		put32(png, static_cast<std::uint32_t>(data.size()));
+		png.insert(png.end(), body.begin(), body.end());
+		put32(png, trv::CRC32Table.crc(body.data(), body.size()));
+	};
+
+	std::vector<unsigned char> header;
+	put32(header, width);
+	put32(header, height);
+	header.insert(header.end(), { 8, 0, 0, 0, 0 });
+
+	std::uint16_t len = static_cast<std::uint16_t>(rows.size());
+	std::vector<unsigned char> zlib { 0x78, 0x01, 0x01, static_cast<unsigned char>(len),
+		                              static_cast<unsigned char>(len >> 8),
+		                              static_cast<unsigned char>(~len),
+		                              static_cast<unsigned char>(~len >> 8) };
+	zlib.insert(zlib.end(), rows.begin(), rows.end());
+	put32(zlib, trv::adler32(1, rows.data(), rows.size()));
+
+	chunk("IHDR", header);
+	chunk("IDAT", zlib);
+	chunk("IEND", {});
+
+	return png;
+}
 
 TEST(TestImage, TestLoadImages)
 {
-#ifdef TRV_PNG_MULTITHREADED
-	std::cout << "NOOO\n";
-#endif
 	static const std::vector<std::string> files = { "plte_bit_depth_1.png" };
 
 	for (const auto& file : files)
@@ -25,3 +88,1138 @@ TEST(TestImage, TestLoadImages)
 		trv::Image<std::uint8_t> img { trv::load_image<std::uint8_t>(path) };
 	}
 }
+
+TEST(TestImage, TestSubByteGray)
+{
+	static const std::vector<std::pair<std::string, std::uint32_t>> files = {
+		{ "gray_bit_depth_1.png", 1 },
+		{ "gray_bit_depth_2_adam7.png", 2 },
+		{ "gray_bit_depth_4.png", 4 }
+	};
+
+	for (const auto& [file, depth] : files)
+	{
+		trv::Image<std::uint8_t> img { trv::load_image<std::uint8_t>("./samples/" + file) };
+
+		ASSERT_EQ(img.width, 13);
+		ASSERT_EQ(img.height, 11);
+		ASSERT_EQ(img.channels, 1);
+
+		for (std::uint32_t y = 0; y < img.height; ++y)
+		{
+			for (std::uint32_t x = 0; x < img.width; ++x)
+			{
+				std::uint32_t expected = sample(x, y, 0, depth) * 255 / ((1u << depth) - 1);
+				EXPECT_EQ(img.data[y * img.width + x], expected) << file << " " << x << "," << y;
+			}
+		}
+	}
+}
+
+TEST(TestImage, TestPalette)
+{
+	static const std::vector<std::tuple<std::string, std::uint32_t, std::uint32_t>> files = {
+		{ "plte_bit_depth_2.png", 2, 4 },
+		{ "plte_bit_depth_4_adam7.png", 4, 16 },
+		{ "plte_bit_depth_8.png", 8, 200 }
+	};
+
+	for (const auto& [file, depth, entries] : files)
+	{
+		trv::Image<std::uint16_t> img { trv::load_image<std::uint16_t>("./samples/" + file) };
+
+		ASSERT_EQ(img.channels, 3);
+
+		for (std::uint32_t y = 0; y < img.height; ++y)
+		{
+			for (std::uint32_t x = 0; x < img.width; ++x)
+			{
+				auto entry = palette_entry(sample(x, y, 0, depth) % entries);
+
+				for (std::uint32_t c = 0; c < 3; ++c)
+				{
+					EXPECT_EQ(img.data[(y * img.width + x) * 3 + c], entry[c] * 257)
+					    << file << " " << x << "," << y;
+				}
+			}
+		}
+	}
+}
+
+TEST(TestImage, TestPaletteTransparency)
+{
+	trv::Image<std::uint8_t> img { trv::load_image<std::uint8_t>(
+		"./samples/plte_bit_depth_4_trns.png") };
+
+	ASSERT_EQ(img.channels, 4);
+
+	for (std::uint32_t y = 0; y < img.height; ++y)
+	{
+		for (std::uint32_t x = 0; x < img.width; ++x)
+		{
+			std::uint32_t index = sample(x, y, 0, 4);
+			auto entry          = palette_entry(index);
+			std::uint32_t alpha = index < 10 ? (index * 37) & 0xFF : 255;
+			const auto* pixel   = &img.data[(y * img.width + x) * 4];
+
+			EXPECT_EQ(pixel[0], entry[0]);
+			EXPECT_EQ(pixel[1], entry[1]);
+			EXPECT_EQ(pixel[2], entry[2]);
+			EXPECT_EQ(pixel[3], alpha) << x << "," << y;
+		}
+	}
+}
+
+TEST(TestImage, TestColorKeyTransparency)
+{
+	static const std::vector<std::tuple<std::string, std::uint32_t, std::uint32_t>> files = {
+		{ "gray_bit_depth_2_trns.png", 2, 1 },
+		{ "gray_bit_depth_16_trns.png", 16, 1 },
+		{ "rgb_bit_depth_8_trns.png", 8, 3 },
+		{ "rgb_bit_depth_16_trns_adam7.png", 16, 3 }
+	};
+
+	for (const auto& [file, depth, fileChannels] : files)
+	{
+		trv::Image<std::uint8_t> img { trv::load_image<std::uint8_t>("./samples/" + file) };
+
+		ASSERT_EQ(img.channels, fileChannels + 1);
+
+		std::uint32_t maxVal    = (1u << depth) - 1;
+		std::size_t transparent = 0;
+
+		for (std::uint32_t y = 0; y < img.height; ++y)
+		{
+			for (std::uint32_t x = 0; x < img.width; ++x)
+			{
+				const auto* pixel = &img.data[(y * img.width + x) * img.channels];
+				bool matches      = true;
+
+				for (std::uint32_t c = 0; c < fileChannels; ++c)
+				{
+					std::uint32_t val = sample(x, y, c, depth);
+					matches &= val == sample(3, 2, c, depth);
+					EXPECT_EQ(pixel[c], (val * 255 * 2 + maxVal) / (maxVal * 2));
+				}
+
+				EXPECT_EQ(pixel[fileChannels], matches ? 0 : 255) << file << " " << x << "," << y;
+				transparent += matches;
+			}
+		}
+
+		EXPECT_GE(transparent, 1u) << file;
+	}
+}
+
+TEST(TestImage, TestSixteenBit)
+{
+	static const std::vector<std::pair<std::string, std::uint32_t>> files = {
+		{ "gray_bit_depth_16.png", 1 },
+		{ "ga_bit_depth_16_adam7.png", 2 },
+		{ "rgb_bit_depth_16.png", 3 },
+		{ "rgba_bit_depth_16.png", 4 }
+	};
+
+	for (const auto& [file, channels] : files)
+	{
+		trv::Image<std::uint16_t> wide { trv::load_image<std::uint16_t>("./samples/" + file) };
+		trv::Image<std::uint8_t> narrow { trv::load_image<std::uint8_t>("./samples/" + file) };
+
+		ASSERT_EQ(wide.channels, channels);
+		ASSERT_EQ(narrow.channels, channels);
+
+		for (std::uint32_t y = 0; y < wide.height; ++y)
+		{
+			for (std::uint32_t x = 0; x < wide.width; ++x)
+			{
+				for (std::uint32_t c = 0; c < channels; ++c)
+				{
+					std::size_t index = (y * wide.width + x) * channels + c;
+					std::uint32_t val = sample(x, y, c, 16);
+
+					EXPECT_EQ(wide.data[index], val) << file;
+					EXPECT_EQ(narrow.data[index], (val * 255 * 2 + 65535) / (65535 * 2)) << file;
+				}
+			}
+		}
+	}
+}
+
+TEST(TestImage, TestDecodeInto)
+{
+	const std::string path { "./samples/rgb_bit_depth_8_trns.png" };
+
+	trv::ImageInfo info = trv::read_image_info(path);
+
+	ASSERT_EQ(info.width, 13);
+	ASSERT_EQ(info.height, 11);
+	ASSERT_EQ(info.channels, 4);
+
+	std::size_t rowStride = info.width * info.channels + 5;
+	std::vector<std::uint8_t> buffer(rowStride * info.height, 0xCD);
+
+	trv::ImageInfo decoded = trv::decode_into<std::uint8_t>(path, buffer, rowStride);
+	trv::Image<std::uint8_t> img { trv::load_image<std::uint8_t>(path) };
+
+	EXPECT_EQ(decoded.channels, info.channels);
+
+	for (std::uint32_t y = 0; y < info.height; ++y)
+	{
+		std::size_t rowElements = info.width * info.channels;
+
+		for (std::size_t i = 0; i < rowElements; ++i)
+		{
+			EXPECT_EQ(buffer[y * rowStride + i], img.data[y * rowElements + i]);
+		}
+
+		for (std::size_t i = rowElements; i < rowStride; ++i)
+		{
+			EXPECT_EQ(buffer[y * rowStride + i], 0xCD);
+		}
+	}
+
+	std::vector<std::uint8_t> tooSmall(rowStride * info.height - 6);
+	EXPECT_THROW(trv::decode_into<std::uint8_t>(path, tooSmall, rowStride), std::runtime_error);
+	EXPECT_THROW(trv::decode_into<std::uint8_t>(path, buffer, info.width), std::runtime_error);
+}
+
+// Reference conversion of a native 8 bit pixel to format
+static std::vector<std::uint32_t> format_reference(const std::uint8_t* pixel,
+                                                   std::uint32_t channels,
+                                                   trv::PixelFormat format)
+{
+	bool gray           = channels <= 2;
+	std::uint32_t red   = pixel[0];
+	std::uint32_t green = gray ? pixel[0] : pixel[1];
+	std::uint32_t blue  = gray ? pixel[0] : pixel[2];
+	std::uint32_t alpha = channels % 2 == 0 ? pixel[channels - 1] : 255;
+	std::uint32_t luma  = gray ? red : (red * 77 + green * 150 + blue * 29 + 128) >> 8;
+
+	auto premultiply = [alpha](std::uint32_t color) { return (color * alpha + 127) / 255; };
+
+	switch (format)
+	{
+		case trv::PixelFormat::Gray:
+			return { luma };
+		case trv::PixelFormat::GrayAlpha:
+			return { luma, alpha };
+		case trv::PixelFormat::RGB:
+			return { red, green, blue };
+		case trv::PixelFormat::RGBA:
+			return { red, green, blue, alpha };
+		case trv::PixelFormat::BGRA:
+			return { blue, green, red, alpha };
+		case trv::PixelFormat::PremultipliedRGBA:
+			return { premultiply(red), premultiply(green), premultiply(blue), alpha };
+		default:
+			return std::vector<std::uint32_t>(pixel, pixel + channels);
+	}
+}
+
+TEST(TestImage, TestPixelFormats)
+{
+	static const std::vector<std::string> files = {
+		"plte_bit_depth_4_trns.png", "plte_bit_depth_8.png",     "gray_bit_depth_2_adam7.png",
+		"gray_bit_depth_2_trns.png", "gray_bit_depth_16.png",    "rgb_bit_depth_8_trns.png",
+		"rgba_bit_depth_16.png",     "ga_bit_depth_16_adam7.png", "rgb_bit_depth_16.png"
+	};
+
+	static const std::vector<trv::PixelFormat> formats = {
+		trv::PixelFormat::Gray, trv::PixelFormat::GrayAlpha, trv::PixelFormat::RGB,
+		trv::PixelFormat::RGBA, trv::PixelFormat::BGRA,      trv::PixelFormat::PremultipliedRGBA
+	};
+
+	for (const auto& file : files)
+	{
+		const std::string path { "./samples/" + file };
+		trv::Image<std::uint8_t> native { trv::load_image<std::uint8_t>(path) };
+
+		for (auto format : formats)
+		{
+			trv::DecodeOptions options;
+			options.format = format;
+
+			trv::Image<std::uint8_t> img { trv::load_image<std::uint8_t>(path, options) };
+
+			ASSERT_EQ(img.channels, trv::format_channels(format, native.channels));
+			ASSERT_EQ(img.channels, trv::read_image_info(path, options).channels);
+
+			for (std::size_t pixel = 0; pixel < img.width * img.height; ++pixel)
+			{
+				auto expected = format_reference(&native.data[pixel * native.channels],
+				                                 native.channels, format);
+
+				for (std::size_t c = 0; c < img.channels; ++c)
+				{
+					ASSERT_EQ(img.data[pixel * img.channels + c], expected[c])
+					    << file << " format " << static_cast<int>(format) << " pixel " << pixel;
+				}
+			}
+		}
+	}
+}
+
+TEST(TestImage, TestPlanarLayout)
+{
+	static const std::vector<std::string> files = {
+		"plte_bit_depth_4_trns.png", "gray_bit_depth_2_adam7.png", "rgb_bit_depth_8_trns.png",
+		"rgba_bit_depth_16.png", "ga_bit_depth_16_adam7.png"
+	};
+
+	for (const auto& file : files)
+	{
+		const std::string path { "./samples/" + file };
+		trv::Image<std::uint16_t> interleaved { trv::load_image<std::uint16_t>(path) };
+
+		trv::DecodeOptions options;
+		options.layout = trv::Layout::Planar;
+
+		trv::Image<std::uint16_t> packed { trv::load_image<std::uint16_t>(path, options) };
+		std::size_t pixels = packed.width * packed.height;
+
+		ASSERT_EQ(packed.channels, interleaved.channels);
+		ASSERT_EQ(packed.data.size(), pixels * packed.channels);
+
+		std::size_t rowStride = packed.width + 3;
+		options.planePitch    = rowStride * packed.height + 7;
+		std::vector<std::uint16_t> buffer(options.planePitch * packed.channels, 0xCDCD);
+
+		trv::decode_into<std::uint16_t>(path, buffer, rowStride, options);
+
+		for (std::uint32_t y = 0; y < packed.height; ++y)
+		{
+			for (std::uint32_t x = 0; x < packed.width; ++x)
+			{
+				for (std::uint32_t c = 0; c < packed.channels; ++c)
+				{
+					std::uint16_t expected =
+					    interleaved.data[(y * packed.width + x) * packed.channels + c];
+
+					EXPECT_EQ(packed.data[c * pixels + y * packed.width + x], expected) << file;
+					EXPECT_EQ(buffer[c * options.planePitch + y * rowStride + x], expected) << file;
+				}
+
+				for (std::uint32_t pad = packed.width; pad < rowStride; ++pad)
+				{
+					EXPECT_EQ(buffer[y * rowStride + pad], 0xCDCD) << file;
+				}
+			}
+		}
+
+		options.planePitch = rowStride * (packed.height - 1);
+		EXPECT_THROW(trv::decode_into<std::uint16_t>(path, buffer, rowStride, options),
+		             std::runtime_error);
+
+		// Entry points that allocate the output check planePitch too
+		options.planePitch = 1;
+		EXPECT_THROW(std::ignore = trv::load_image<std::uint16_t>(path, options),
+		             std::runtime_error);
+		EXPECT_THROW(std::ignore = trv::load_image<std::uint16_t>(path, options,
+		                                                          trv::AllocationPolicy {}),
+		             std::runtime_error);
+
+		trv::Decoder decoder;
+		EXPECT_THROW(std::ignore = decoder.load_image<std::uint16_t>(path, options),
+		             std::runtime_error);
+
+		std::vector<std::string> paths { path };
+		bool failed = false;
+		trv::load_images<std::uint16_t>(
+		    paths, [&](std::size_t, trv::BatchResult<std::uint16_t> result)
+		    { failed = !result.has_value(); },
+		    options);
+		EXPECT_TRUE(failed) << file;
+	}
+}
+
+TEST(TestImage, TestFloatSamples)
+{
+	static const std::vector<std::string> files = { "gray_bit_depth_16.png",
+		                                            "rgb_bit_depth_8_trns.png",
+		                                            "plte_bit_depth_2.png",
+		                                            "ga_bit_depth_16_adam7.png" };
+
+	for (const auto& file : files)
+	{
+		const std::string path { "./samples/" + file };
+		trv::Image<std::uint16_t> wide { trv::load_image<std::uint16_t>(path) };
+
+		trv::DecodeOptions options;
+		options.layout = trv::Layout::Planar;
+
+		trv::Image<float> img { trv::load_image<float>(path, options) };
+		std::size_t pixels = img.width * img.height;
+
+		ASSERT_EQ(img.channels, wide.channels);
+
+		for (std::size_t pixel = 0; pixel < pixels; ++pixel)
+		{
+			for (std::uint32_t c = 0; c < img.channels; ++c)
+			{
+				float expected = wide.data[pixel * wide.channels + c] / 65535.0f;
+				EXPECT_FLOAT_EQ(img.data[c * pixels + pixel], expected) << file;
+			}
+		}
+	}
+
+	const std::string path { "./samples/rgba_bit_depth_16.png" };
+	trv::DecodeOptions options;
+	options.format = trv::PixelFormat::PremultipliedRGBA;
+
+	trv::Image<float> straight { trv::load_image<float>(path) };
+	trv::Image<float> premultiplied { trv::load_image<float>(path, options) };
+
+	for (std::size_t index = 0; index < straight.data.size(); ++index)
+	{
+		float alpha    = straight.data[index | 3];
+		float expected = index % 4 == 3 ? alpha : straight.data[index] * alpha;
+
+		EXPECT_FLOAT_EQ(premultiplied.data[index], expected);
+	}
+}
+
+TEST(TestImage, TestAdam7Preview)
+{
+	static constexpr std::uint32_t blockWidth[7] { 8, 4, 4, 2, 2, 1, 1 };
+	static constexpr std::uint32_t blockHeight[7] { 8, 8, 4, 4, 2, 2, 1 };
+
+	static const std::vector<std::string> files = { "gray_bit_depth_2_adam7.png",
+		                                            "plte_bit_depth_4_adam7.png",
+		                                            "ga_bit_depth_16_adam7.png",
+		                                            "rgb_bit_depth_16_trns_adam7.png" };
+
+	for (const auto& file : files)
+	{
+		const std::string path { "./samples/" + file };
+		trv::Image<std::uint8_t> full { trv::load_image<std::uint8_t>(path) };
+
+		for (std::uint8_t passes = 1; passes <= 7; ++passes)
+		{
+			trv::DecodeOptions options;
+			options.previewPasses = passes;
+
+			trv::Image<std::uint8_t> preview { trv::load_image<std::uint8_t>(path, options) };
+
+			ASSERT_EQ(preview.data.size(), full.data.size());
+
+			for (std::uint32_t y = 0; y < full.height; ++y)
+			{
+				for (std::uint32_t x = 0; x < full.width; ++x)
+				{
+					std::uint32_t srcX = x - x % blockWidth[passes - 1];
+					std::uint32_t srcY = y - y % blockHeight[passes - 1];
+
+					for (std::uint32_t c = 0; c < full.channels; ++c)
+					{
+						ASSERT_EQ(preview.data[(y * full.width + x) * full.channels + c],
+						          full.data[(srcY * full.width + srcX) * full.channels + c])
+						    << file << " passes " << static_cast<int>(passes);
+					}
+				}
+			}
+		}
+
+		trv::DecodeOptions invalid;
+		invalid.previewPasses = 8;
+		EXPECT_THROW(std::ignore = trv::load_image<std::uint8_t>(path, invalid),
+		             std::runtime_error);
+	}
+}
+
+TEST(TestImage, TestReducedScale)
+{
+	static const std::vector<std::string> files = {
+		"gray_bit_depth_2_adam7.png", "ga_bit_depth_16_adam7.png", "plte_bit_depth_4_trns.png",
+		"rgb_bit_depth_16.png", "rgb_bit_depth_16_trns_adam7.png"
+	};
+
+	for (const auto& file : files)
+	{
+		const std::string path { "./samples/" + file };
+		trv::Image<std::uint8_t> full { trv::load_image<std::uint8_t>(path) };
+		trv::Chunks chunks = trv::read_chunks(path);
+		bool interlaced    = chunks.header->data.interlaceMethod;
+
+		for (std::uint8_t scale : { 2, 4, 8 })
+		{
+			trv::DecodeOptions options;
+			options.scale = scale;
+
+			trv::Image<std::uint8_t> img { trv::load_image<std::uint8_t>(path, options) };
+
+			ASSERT_EQ(img.width, (full.width + scale - 1) / scale);
+			ASSERT_EQ(img.height, (full.height + scale - 1) / scale);
+			ASSERT_EQ(img.width, trv::read_image_info(path, options).width);
+
+			for (std::uint32_t y = 0; y < img.height; ++y)
+			{
+				for (std::uint32_t x = 0; x < img.width; ++x)
+				{
+					for (std::uint32_t c = 0; c < img.channels; ++c)
+					{
+						std::uint32_t expected = 0;
+
+						if (interlaced)
+						{
+							expected = full.data[(y * scale * full.width + x * scale) *
+							                         full.channels + c];
+						}
+						else
+						{
+							std::uint32_t sum = 0, count = 0;
+
+							for (std::uint32_t sy = y * scale;
+							     sy < std::min<std::uint32_t>((y + 1) * scale, full.height); ++sy)
+							{
+								for (std::uint32_t sx = x * scale;
+								     sx < std::min<std::uint32_t>((x + 1) * scale, full.width);
+								     ++sx)
+								{
+									sum += full.data[(sy * full.width + sx) * full.channels + c];
+									++count;
+								}
+							}
+
+							expected = (sum + count / 2) / count;
+						}
+
+						ASSERT_EQ(img.data[(y * img.width + x) * img.channels + c], expected)
+						    << file << " scale " << static_cast<int>(scale);
+					}
+				}
+			}
+
+			if (interlaced)
+			{
+				EXPECT_LT(trv::decompress_image(chunks, options).size(),
+				          trv::decompress_image(chunks).size());
+			}
+		}
+
+		trv::DecodeOptions invalid;
+		invalid.scale = 3;
+		EXPECT_THROW(std::ignore = trv::load_image<std::uint8_t>(path, invalid),
+		             std::runtime_error);
+	}
+}
+
+TEST(TestImage, TestRegion)
+{
+	static const std::vector<std::string> files = {
+		"gray_bit_depth_1.png",       "plte_bit_depth_2.png",      "plte_bit_depth_4_adam7.png",
+		"gray_bit_depth_2_adam7.png", "rgb_bit_depth_16.png",      "ga_bit_depth_16_adam7.png",
+		"rgb_bit_depth_8_trns.png"
+	};
+
+	static const std::vector<trv::Region> regions = {
+		{ 0, 0, 1, 1 }, { 3, 2, 5, 4 }, { 1, 5, 9, 6 }, { 7, 0, 6, 11 }, { 0, 10, 13, 1 }
+	};
+
+	for (const auto& file : files)
+	{
+		const std::string path { "./samples/" + file };
+		trv::Image<std::uint16_t> full { trv::load_image<std::uint16_t>(path) };
+		trv::Chunks chunks = trv::read_chunks(path);
+
+		for (const auto& region : regions)
+		{
+			for (auto layout : { trv::Layout::Interleaved, trv::Layout::Planar })
+			{
+				trv::DecodeOptions options;
+				options.region = region;
+				options.layout = layout;
+
+				trv::Image<std::uint16_t> crop { trv::load_image<std::uint16_t>(path, options) };
+				bool planar        = layout == trv::Layout::Planar;
+				std::size_t pixels = region.width * region.height;
+
+				ASSERT_EQ(crop.width, region.width);
+				ASSERT_EQ(crop.height, region.height);
+				ASSERT_EQ(crop.data.size(), pixels * full.channels);
+
+				for (std::uint32_t y = 0; y < region.height; ++y)
+				{
+					for (std::uint32_t x = 0; x < region.width; ++x)
+					{
+						for (std::uint32_t c = 0; c < full.channels; ++c)
+						{
+							std::size_t index = planar ? c * pixels + y * region.width + x
+							                           : (y * region.width + x) * full.channels + c;
+							std::size_t source =
+							    ((region.y + y) * full.width + region.x + x) * full.channels + c;
+
+							ASSERT_EQ(crop.data[index], full.data[source])
+							    << file << " region " << region.x << "," << region.y;
+						}
+					}
+				}
+			}
+
+			trv::DecodeOptions options;
+			options.region = region;
+
+			if (region.y + region.height < full.height)
+			{
+				EXPECT_LT(trv::decompress_image(chunks, options).size(),
+				          trv::decompress_image(chunks).size())
+				    << file;
+			}
+		}
+
+		for (trv::Region invalid : { trv::Region { full.width, 0, 1, 1 },
+		                             trv::Region { 0, 5, 2, 7 }, trv::Region { 2, 2, 0, 3 } })
+		{
+			trv::DecodeOptions options;
+			options.region = invalid;
+			EXPECT_THROW(std::ignore = trv::load_image<std::uint16_t>(path, options),
+			             std::runtime_error)
+			    << file << " region " << invalid.x << "," << invalid.y;
+		}
+	}
+}
+
+TEST(TestImage, TestRowReader)
+{
+	static const std::vector<std::string> files = {
+		"gray_bit_depth_1.png",     "plte_bit_depth_4_trns.png", "gray_bit_depth_16_trns.png",
+		"rgb_bit_depth_8_trns.png", "rgba_bit_depth_16.png",     "plte_bit_depth_8.png"
+	};
+
+	for (const auto& file : files)
+	{
+		const std::string path { "./samples/" + file };
+
+		trv::DecodeOptions options;
+		options.format = trv::PixelFormat::BGRA;
+
+		trv::Image<std::uint16_t> img { trv::load_image<std::uint16_t>(path, options) };
+		trv::RowReader<std::uint16_t> reader(path, options);
+		trv::ImageInfo info = reader.info();
+
+		ASSERT_EQ(info.width, img.width);
+		ASSERT_EQ(info.height, img.height);
+		ASSERT_EQ(info.channels, img.channels);
+
+		std::size_t rowElements = info.width * info.channels;
+		std::vector<std::uint16_t> row(rowElements);
+		std::uint32_t rows = 0;
+
+		while (reader.next_row(row))
+		{
+			for (std::size_t i = 0; i < rowElements; ++i)
+			{
+				ASSERT_EQ(row[i], img.data[rows * rowElements + i]) << file << " row " << rows;
+			}
+			++rows;
+		}
+
+		EXPECT_EQ(rows, info.height) << file;
+		EXPECT_FALSE(reader.next_row(row));
+
+		std::vector<std::uint16_t> tooSmall(rowElements - 1);
+		EXPECT_THROW(reader.next_row(tooSmall), std::runtime_error);
+	}
+
+	EXPECT_THROW(trv::RowReader<std::uint8_t>("./samples/gray_bit_depth_2_adam7.png"),
+	             std::runtime_error);
+}
+
+TEST(TestImage, TestDecoderReuse)
+{
+	static const std::vector<std::string> files = { "rgba_bit_depth_16.png",
+		                                            "gray_bit_depth_1.png",
+		                                            "ga_bit_depth_16_adam7.png",
+		                                            "plte_bit_depth_4_trns.png",
+		                                            "rgb_bit_depth_16_trns_adam7.png",
+		                                            "plte_bit_depth_8.png" };
+
+	trv::Decoder decoder;
+
+	// Every image follows one of a different size and layout, buffers carry over between them
+	for (int round = 0; round < 2; ++round)
+	{
+		for (const auto& file : files)
+		{
+			const std::string path { "./samples/" + file };
+
+			trv::DecodeOptions options;
+			options.format = round ? trv::PixelFormat::RGBA : trv::PixelFormat::Native;
+
+			trv::Image<std::uint16_t> expected { trv::load_image<std::uint16_t>(path, options) };
+			trv::Image<std::uint16_t> img { decoder.load_image<std::uint16_t>(path, options) };
+
+			EXPECT_EQ(img.width, expected.width) << file;
+			EXPECT_EQ(img.height, expected.height) << file;
+			EXPECT_EQ(img.channels, expected.channels) << file;
+			EXPECT_EQ(img.data, expected.data) << file;
+
+			std::size_t rowStride = expected.width * expected.channels + 3;
+			std::vector<std::uint16_t> dst(expected.height * rowStride);
+			decoder.decode_into<std::uint16_t>(path, dst, rowStride, options);
+
+			for (std::uint32_t y = 0; y < expected.height; ++y)
+			{
+				for (std::uint32_t x = 0; x < expected.width * expected.channels; ++x)
+				{
+					ASSERT_EQ(dst[y * rowStride + x],
+					          expected.data[y * expected.width * expected.channels + x])
+					    << file;
+				}
+			}
+
+			EXPECT_THROW(decoder.decode_into<std::uint16_t>(path, dst, rowStride - 4, options),
+			             std::runtime_error);
+		}
+
+		EXPECT_THROW(std::ignore = decoder.load_image<std::uint8_t>("./samples/missing.png"),
+		             std::runtime_error);
+	}
+}
+
+// Counts the samples it zeroes, as std::allocator does when a vector grows.
+template <typename T>
+struct ZeroingAllocator : std::allocator<T>
+{
+	ZeroingAllocator() = default;
+
+	template <typename U>
+	ZeroingAllocator(const ZeroingAllocator<U>&) noexcept
+	{
+	}
+
+	template <typename U>
+	void construct(U* ptr)
+	{
+		++zeroed;
+		::new (static_cast<void*>(ptr)) U();
+	}
+
+	static inline std::size_t zeroed = 0;
+};
+
+TEST(TestImage, TestOutputSkipsFill)
+{
+	// Samples an output grows by are left for decoding to write
+	trv::SampleBuffer<std::uint8_t> samples(64, 0xAB);
+	samples.resize(0);
+	samples.resize(64);
+	EXPECT_EQ(std::count(samples.begin(), samples.end(), 0xAB), 64);
+
+	// Decoding into an image of the same size reuses its samples without touching them first
+	const std::string path { "./samples/rgb_bit_depth_16_trns_adam7.png" };
+	trv::Image<std::uint16_t> expected { trv::load_image<std::uint16_t>(path) };
+
+	trv::Decoder decoder;
+	trv::Image<std::uint16_t, ZeroingAllocator<std::uint16_t>> image({}, 0, 0, 0);
+
+	decoder.load_image(path, image);
+	EXPECT_EQ(ZeroingAllocator<std::uint16_t>::zeroed, expected.data.size());
+
+	const std::uint16_t* storage = image.data.data();
+	ZeroingAllocator<std::uint16_t>::zeroed = 0;
+
+	decoder.load_image(path, image);
+	EXPECT_EQ(ZeroingAllocator<std::uint16_t>::zeroed, 0);
+	EXPECT_EQ(image.data.data(), storage);
+	EXPECT_EQ(image.width, expected.width);
+	EXPECT_EQ(image.height, expected.height);
+	EXPECT_EQ(image.rowStride, expected.rowStride);
+	EXPECT_TRUE(std::equal(image.data.begin(), image.data.end(), expected.data.begin(),
+	                       expected.data.end()));
+}
+
+TEST(TestImage, TestShortImageData)
+{
+	const std::filesystem::path dir       = std::filesystem::temp_directory_path();
+	const std::filesystem::path full      = dir / "trv_full.png";
+	const std::filesystem::path truncated = dir / "trv_short.png";
+
+	// Rows of a filter byte and 8 samples
+	std::vector<unsigned char> rows;
+
+	for (int row = 0; row < 8; ++row)
+	{
+		rows.push_back(0);
+		rows.insert(rows.end(), 8, 200);
+	}
+
+	std::vector<unsigned char> twoRows(18, 7);
+	twoRows[0] = twoRows[9] = 0;
+
+	for (const auto& [path, data] : { std::pair { full, gray_png(8, 8, rows) },
+	                                  std::pair { truncated, gray_png(8, 8, twoRows) } })
+	{
+		std::ofstream(path, std::ios_base::binary)
+		    .write(reinterpret_cast<const char*>(data.data()), static_cast<long>(data.size()));
+	}
+
+	// The short stream is complete and its ADLER32 matches, but holds 2 of the 8 scanlines
+	trv::Decoder decoder;
+	EXPECT_EQ(decoder.load_image<std::uint8_t>(full.string()).data,
+	          trv::SampleBuffer<std::uint8_t>(64, 200));
+	EXPECT_THROW(std::ignore = decoder.load_image<std::uint8_t>(truncated.string()),
+	             std::runtime_error);
+	EXPECT_THROW(std::ignore = trv::load_image<std::uint8_t>(truncated.string()),
+	             std::runtime_error);
+
+	std::filesystem::remove(full);
+	std::filesystem::remove(truncated);
+}
+
+TEST(TestImage, TestParallelismPolicy)
+{
+	static const std::vector<std::string> files = { "rgba_bit_depth_16.png",
+		                                            "gray_bit_depth_1.png",
+		                                            "ga_bit_depth_16_adam7.png",
+		                                            "plte_bit_depth_4_trns.png",
+		                                            "rgb_bit_depth_16_trns_adam7.png" };
+
+	trv::ThreadPool pool(3);
+
+	// Blocks smaller than the rows of the samples so that lanes trail each other
+	trv::ParallelismPolicy parallel { trv::Parallelism::Parallel, 3, 8, &pool };
+	trv::Decoder decoder(parallel);
+
+	for (const auto& file : files)
+	{
+		const std::string path { "./samples/" + file };
+
+		trv::DecodeOptions serial;
+		serial.parallelism = trv::ParallelismPolicy { trv::Parallelism::Serial };
+
+		trv::DecodeOptions threaded;
+		threaded.parallelism = parallel;
+
+		trv::Image<std::uint16_t> expected { trv::load_image<std::uint16_t>(path, serial) };
+
+		EXPECT_EQ(trv::load_image<std::uint16_t>(path, threaded).data, expected.data) << file;
+		EXPECT_EQ(trv::load_image<std::uint16_t>(path).data, expected.data) << file;
+		EXPECT_EQ(decoder.load_image<std::uint16_t>(path).data, expected.data) << file;
+		EXPECT_EQ(decoder.load_image<std::uint16_t>(path, serial).data, expected.data) << file;
+	}
+}
+
+// Counts what is allocated through it, to check that every buffer of a decode uses the policy.
+class CountingResource : public std::pmr::memory_resource
+{
+   public:
+	std::size_t allocations = 0;
+	std::size_t outstanding = 0;
+
+   private:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override
+	{
+		++allocations;
+		outstanding += bytes;
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override
+	{
+		outstanding -= bytes;
+		std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+TEST(TestImage, TestAllocationPolicy)
+{
+	static const std::vector<std::string> files = { "rgb_bit_depth_8_trns.png",
+		                                            "gray_bit_depth_16.png",
+		                                            "plte_bit_depth_4_adam7.png" };
+
+	for (const auto& file : files)
+	{
+		const std::string path { "./samples/" + file };
+
+		for (trv::Layout layout : { trv::Layout::Interleaved, trv::Layout::Planar })
+		{
+			trv::DecodeOptions options;
+			options.layout = layout;
+
+			trv::Image<float> expected { trv::load_image<float>(path, options) };
+
+			CountingResource counter;
+			trv::AlignedResource aligned(64, 0, &counter);
+
+			{
+				trv::MemoryUsage usage;
+				options.memoryUsage = &usage;
+
+				trv::AllocationPolicy policy { &aligned, 64 };
+				trv::PmrImage<float> img { trv::load_image<float>(path, options, policy) };
+
+				EXPECT_EQ(reinterpret_cast<std::uintptr_t>(img.data.data()) % 64, 0) << file;
+				EXPECT_EQ(img.rowStride * sizeof(float) % 64, 0) << file;
+				EXPECT_GE(counter.allocations, 2) << file;
+
+				// Both buffers from the resource are still held, the IDAT data isn't from it
+				EXPECT_EQ(aligned.allocated(), counter.outstanding) << file;
+				EXPECT_GE(aligned.peak(), usage.decompressed + usage.output) << file;
+				EXPECT_EQ(usage.output, img.data.capacity() * sizeof(float)) << file;
+
+				bool planar             = layout == trv::Layout::Planar;
+				std::size_t rowElements = planar ? img.width : img.width * img.channels;
+				std::size_t planes      = planar ? img.channels : 1;
+
+				for (std::size_t plane = 0; plane < planes; ++plane)
+				{
+					for (std::uint32_t y = 0; y < img.height; ++y)
+					{
+						for (std::size_t x = 0; x < rowElements; ++x)
+						{
+							ASSERT_EQ(img.data[(plane * img.height + y) * img.rowStride + x],
+							          expected.data[(plane * img.height + y) * rowElements + x])
+							    << file;
+						}
+					}
+				}
+			}
+
+			EXPECT_EQ(counter.outstanding, 0) << file;
+			EXPECT_EQ(aligned.allocated(), 0) << file;
+			EXPECT_GT(aligned.peak(), 0) << file;
+
+			aligned.reset_peak();
+			EXPECT_EQ(aligned.peak(), 0) << file;
+		}
+	}
+
+	// Allocations past the threshold are placed on huge page boundaries
+	trv::AlignedResource huge(64, 1);
+	trv::PmrImage<std::uint8_t> img {
+		trv::load_image<std::uint8_t>("./samples/rgba_bit_depth_16.png", {}, { &huge, 0 })
+	};
+	std::uintptr_t address = reinterpret_cast<std::uintptr_t>(img.data.data());
+	EXPECT_EQ(address % trv::AlignedResource::hugePageSize, 0);
+
+	EXPECT_THROW(std::ignore = trv::load_image<float>("./samples/rgba_bit_depth_16.png", {},
+	                                                  { std::pmr::get_default_resource(), 6 }),
+	             std::runtime_error);
+}
+
+TEST(TestImage, TestMemoryBudget)
+{
+	const std::string path { "./samples/rgb_bit_depth_8_trns.png" };
+
+	trv::MemoryUsage usage;
+	trv::DecodeOptions options;
+	options.memoryUsage = &usage;
+
+	trv::Image<std::uint16_t> img { trv::load_image<std::uint16_t>(path, options) };
+	trv::Chunks chunks = trv::read_chunks(path);
+
+	std::size_t compressed   = chunks.image_data->data.data.size();
+	std::size_t decompressed = img.height * (img.width * 3 + 1);
+	std::size_t output       = img.data.size() * sizeof(std::uint16_t);
+
+	// Measured from the buffers, which hold at least what the headers ask for
+	EXPECT_GE(usage.compressed, compressed);
+	EXPECT_EQ(usage.decompressed, decompressed);
+	EXPECT_EQ(usage.output, img.data.capacity() * sizeof(std::uint16_t));
+	EXPECT_EQ(usage.peak, usage.compressed + usage.decompressed + usage.output);
+
+	// The budget is checked from the headers, exactly their sum fits and one byte less doesn't
+	options.memoryBudget = compressed + decompressed + output;
+	EXPECT_NO_THROW(std::ignore = trv::load_image<std::uint16_t>(path, options));
+
+	options.memoryBudget = compressed + decompressed + output - 1;
+	EXPECT_THROW(std::ignore = trv::load_image<std::uint16_t>(path, options), std::runtime_error);
+
+	// Too small for the scanlines alone, rejected while reading the chunks
+	options.memoryBudget = decompressed - 1;
+	EXPECT_THROW(std::ignore = trv::read_chunks(path, options), std::runtime_error);
+
+	// Rejected from its IHDR before the multi-gigabyte image is allocated
+	trv::DecodeOptions bounded;
+	bounded.memoryBudget = 64 << 20;
+	EXPECT_THROW(std::ignore = trv::load_image<std::uint8_t>("./samples/rgba_bit_depth_16_huge.png",
+	                                                         bounded),
+	             std::runtime_error);
+
+	// Data past the last scanline is never inflated
+	trv::MemoryUsage bombUsage;
+	trv::DecodeOptions bomb;
+	bomb.memoryUsage = &bombUsage;
+
+	trv::Image<std::uint8_t> single {
+		trv::load_image<std::uint8_t>("./samples/gray_bit_depth_8_bomb.png", bomb)
+	};
+
+	EXPECT_EQ(single.data, trv::SampleBuffer<std::uint8_t> { 0 });
+	EXPECT_EQ(bombUsage.decompressed, 2);
+}
+
+TEST(TestImage, TestMemoryBudgetChunkOrder)
+{
+	// An IDAT claiming almost 2 GiB ahead of IHDR, rejected before its data is allocated
+	const std::string path { "./samples/idat_before_ihdr.png" };
+
+	trv::DecodeOptions bounded;
+	bounded.memoryBudget = 1 << 20;
+	EXPECT_THROW(std::ignore = trv::read_chunks(path, bounded), std::runtime_error);
+	EXPECT_THROW(std::ignore = trv::load_image<std::uint8_t>(path, bounded), std::runtime_error);
+
+	// Out of order even without a budget
+	EXPECT_THROW(std::ignore = trv::read_chunks(path), std::runtime_error);
+}
+
+TEST(TestImage, TestBatchPipeline)
+{
+	static const std::vector<std::string> files = { "rgba_bit_depth_16.png",
+		                                            "gray_bit_depth_1.png",
+		                                            "ga_bit_depth_16_adam7.png",
+		                                            "missing.png",
+		                                            "plte_bit_depth_4_trns.png",
+		                                            "rgb_bit_depth_16_trns_adam7.png",
+		                                            "plte_bit_depth_8.png",
+		                                            "rgba_bit_depth_16_huge.png" };
+
+	std::vector<std::string> paths;
+	std::vector<std::vector<unsigned char>> contents;
+
+	for (const auto& file : files)
+	{
+		paths.push_back("./samples/" + file);
+
+		std::ifstream infile(paths.back(), std::ios_base::binary);
+		contents.emplace_back(std::istreambuf_iterator<char>(infile),
+		                      std::istreambuf_iterator<char>());
+	}
+
+	std::vector<std::span<const unsigned char>> buffers(contents.begin(), contents.end());
+
+	trv::DecodeOptions options;
+	options.memoryBudget = 1 << 20;
+
+	// A single image in flight blocks reading behind every decode
+	trv::BatchOptions batch;
+	batch.maxInFlight = 1;
+
+	auto check = [&](auto&& load)
+	{
+		std::vector<int> delivered(files.size());
+
+		load(
+		    [&](std::size_t index, trv::BatchResult<std::uint16_t> result)
+		    {
+			    ASSERT_LT(index, files.size());
+			    ++delivered[index];
+
+			    if (files[index] == "missing.png" || files[index] == "rgba_bit_depth_16_huge.png")
+			    {
+				    EXPECT_FALSE(result.has_value()) << files[index];
+				    return;
+			    }
+
+			    ASSERT_TRUE(result.has_value()) << files[index];
+
+			    trv::Image<std::uint16_t> expected {
+				    trv::load_image<std::uint16_t>(paths[index], options)
+			    };
+
+			    EXPECT_EQ(result->width, expected.width) << files[index];
+			    EXPECT_EQ(result->height, expected.height) << files[index];
+			    EXPECT_EQ(result->channels, expected.channels) << files[index];
+			    EXPECT_EQ(result->data, expected.data) << files[index];
+		    });
+
+		EXPECT_EQ(delivered, std::vector<int>(files.size(), 1));
+	};
+
+	check([&](auto callback)
+	      { trv::load_images<std::uint16_t>(paths, callback, options, batch); });
+	// Empty buffer of the missing file fails to parse
+	check([&](auto callback)
+	      { trv::load_images<std::uint16_t>(buffers, callback, options, batch); });
+
+	// Without workers the reading threads decode
+	trv::ThreadPool idle(0);
+	trv::DecodeOptions onIdle = options;
+	onIdle.parallelism        = trv::ParallelismPolicy { trv::Parallelism::Auto, 0, 0, &idle };
+
+	trv::BatchOptions readers;
+	readers.readThreads = 3;
+	check([&](auto callback)
+	      { trv::load_images<std::uint16_t>(paths, callback, onIdle, readers); });
+
+	// The first exception of the callback stops the batch
+	std::size_t calls = 0;
+
+	EXPECT_THROW(trv::load_images<std::uint8_t>(
+	                 paths,
+	                 [&](std::size_t, trv::BatchResult<std::uint8_t>)
+	                 {
+		                 ++calls;
+		                 throw std::logic_error("stop");
+	                 },
+	                 options, batch),
+	             std::logic_error);
+	EXPECT_EQ(calls, 1);
+}
+
+TEST(TestImage, TestDecodeStats)
+{
+	const std::string path { "./samples/rgb_bit_depth_8_trns.png" };
+
+	std::ifstream infile(path, std::ios_base::binary);
+	std::vector<unsigned char> file { std::istreambuf_iterator<char>(infile),
+		                              std::istreambuf_iterator<char>() };
+
+	// A tEXt chunk after IHDR, which is 8 + 25 bytes into the file
+	const std::string text("Comment\0stats", 13);
+	std::vector<unsigned char> chunk { 0, 0, 0, static_cast<unsigned char>(text.size()), 't', 'E',
+		                               'X', 't' };
+	chunk.insert(chunk.end(), text.begin(), text.end());
+	chunk.insert(chunk.end(), 4, 0);
+
+	std::vector<unsigned char> withText = file;
+	withText.insert(withText.begin() + 33, chunk.begin(), chunk.end());
+
+	// Skipped silently unless a handler is set
+	std::vector<std::pair<std::string, std::uint32_t>> unknown;
+	trv::DecodeOptions options;
+	options.unknownChunk = [&](std::string_view type, std::uint32_t size)
+	{ unknown.emplace_back(type, size); };
+
+	std::ignore = trv::read_chunks(withText, options);
+	EXPECT_EQ(unknown, (std::vector<std::pair<std::string, std::uint32_t>> { { "tEXt", 13 } }));
+
+	if constexpr (!trv::statsEnabled)
+	{
+		GTEST_SKIP() << "Built without TRV_STATS";
+	}
+
+	trv::DecodeStats stats;
+	options.stats = &stats;
+
+	std::ignore = trv::read_chunks(withText, options);
+	EXPECT_EQ(stats.bytesRead, withText.size());
+	EXPECT_EQ(stats.imageDataChunks, 1);
+	EXPECT_EQ(stats.unknownChunks, 1);
+
+	stats = {};
+	trv::Image<std::uint8_t> img { trv::load_image<std::uint8_t>(path, options) };
+
+	EXPECT_EQ(stats.bytesRead, file.size());
+	EXPECT_EQ(stats.unknownChunks, 0);
+	EXPECT_GT(stats.blocks[0] + stats.blocks[1] + stats.blocks[2], 0);
+	EXPECT_EQ(stats.huffmanTables, 2 * stats.blocks[2]);
+
+	std::size_t lengths = 0, distances = 0, scanlines = 0;
+	for (std::size_t count : stats.matchLengths) lengths += count;
+	for (std::size_t count : stats.matchDistances) distances += count;
+	for (std::size_t count : stats.filters) scanlines += count;
+
+	EXPECT_EQ(lengths, distances);
+	EXPECT_EQ(scanlines, img.height);
+
+	// Counters accumulate over decodes
+	std::ignore = trv::load_image<std::uint8_t>(path, options);
+	EXPECT_EQ(stats.bytesRead, 2 * file.size());
+	EXPECT_EQ(stats.imageDataChunks, 2);
+}
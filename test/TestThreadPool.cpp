@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+TEST(TestThreadPool, TestParallelForCoversRange)
+{
+	trv::ThreadPool pool(3);
+
+	for (std::size_t grain : { 1, 7, 64, 5000 })
+	{
+		std::vector<std::atomic<int>> visits(1000);
+
+		pool.parallel_for(10, 1000, grain,
+		                  [&](std::size_t first, std::size_t last)
+		                  {
+			                  EXPECT_LE(last - first, grain);
+			                  for (std::size_t i = first; i < last; ++i)
+			                  {
+				                  ++visits[i];
+			                  }
+		                  });
+
+		for (std::size_t i = 0; i < visits.size(); ++i)
+		{
+			ASSERT_EQ(visits[i].load(), i >= 10 ? 1 : 0) << "grain " << grain;
+		}
+	}
+}
+
+TEST(TestThreadPool, TestNestedParallelFor)
+{
+	trv::ThreadPool pool(2);
+	std::atomic<std::size_t> sum = 0;
+
+	// Inner loops run from workers, which keep taking tasks while they wait
+	pool.parallel_for(0, 8, 1,
+	                  [&](std::size_t outer, std::size_t)
+	                  {
+		                  pool.parallel_for(0, 100, 3,
+		                                    [&](std::size_t first, std::size_t last)
+		                                    {
+			                                    for (std::size_t i = first; i < last; ++i)
+			                                    {
+				                                    sum += outer * 100 + i;
+			                                    }
+		                                    });
+	                  });
+
+	EXPECT_EQ(sum.load(), 800 * 799 / 2);
+}
+
+TEST(TestThreadPool, TestExceptionsPropagate)
+{
+	trv::ThreadPool pool(2);
+
+	EXPECT_THROW(pool.parallel_for(0, 100, 1,
+	                               [](std::size_t first, std::size_t)
+	                               {
+		                               if (first == 42) throw std::runtime_error("failed");
+	                               }),
+	             std::runtime_error);
+
+	// The pool is still usable afterwards
+	std::atomic<int> count = 0;
+	pool.parallel_for(0, 10, 1, [&](std::size_t, std::size_t) { ++count; });
+	EXPECT_EQ(count.load(), 10);
+}
+
+TEST(TestThreadPool, TestSubmitCallables)
+{
+	trv::ThreadPool pool(2);
+	std::vector<std::future<int>> results;
+
+	for (int i = 0; i < 50; ++i)
+	{
+		auto promise = std::make_shared<std::promise<int>>();
+		results.push_back(promise->get_future());
+		pool.submit([promise, i]() { promise->set_value(i * i); });
+	}
+
+	for (int i = 0; i < 50; ++i)
+	{
+		EXPECT_EQ(results[i].get(), i * i);
+	}
+
+	EXPECT_EQ(&trv::ThreadPool::instance(), &trv::ThreadPool::instance());
+}
+
+TEST(TestThreadPool, TestNanosPerLane)
+{
+	trv::ThreadPool serial(0);
+	trv::ThreadPool small(1);
+	trv::ThreadPool large(4);
+
+	EXPECT_EQ(serial.nanos_per_lane(), 0);
+	EXPECT_GT(small.nanos_per_lane(), 0);
+	EXPECT_GT(large.nanos_per_lane(), 0);
+
+	EXPECT_EQ(serial.unfilter_nanos_per_byte(4), 0);
+
+	for (std::size_t bpp : { 1, 2, 3, 4, 6, 8 })
+	{
+		EXPECT_GT(large.unfilter_nanos_per_byte(bpp), 0) << bpp;
+	}
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Batch.hpp"
+#include "Image.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+static std::string read_trace(const std::filesystem::path& path)
+{
+	std::ifstream infile(path, std::ios_base::binary);
+	return { std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>() };
+}
+
+TEST(TestTrace, TestDecodeStages)
+{
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "trv_trace.json";
+
+	trv::ThreadPool pool(3);
+	trv::DecodeOptions options;
+	options.parallelism = trv::ParallelismPolicy { trv::Parallelism::Parallel, 3, 8, &pool };
+
+	trv::start_tracing(path.string());
+	EXPECT_TRUE(trv::tracing());
+
+	std::ignore = trv::load_image<std::uint8_t>("./samples/rgba_bit_depth_16.png", options);
+
+	// Events of a thread that exited before the trace was written are kept
+	std::thread([]() { trv::TraceScope scope("exited thread"); }).join();
+
+	std::vector<std::string> paths = { "./samples/rgb_bit_depth_16_trns_adam7.png",
+		                               "./samples/plte_bit_depth_4_trns.png" };
+	// The calling thread is the first reader, the second is named
+	trv::BatchOptions batch;
+	batch.readThreads = 2;
+	trv::load_images<std::uint8_t>(
+	    paths, [](std::size_t, trv::BatchResult<std::uint8_t>) {}, options, batch);
+
+	trv::stop_tracing();
+	EXPECT_FALSE(trv::tracing());
+
+	std::string trace = read_trace(path);
+
+	EXPECT_EQ(trace.rfind("{\"traceEvents\":[", 0), 0);
+	EXPECT_NE(trace.find("],\"displayTimeUnit\":\"ns\"}"), std::string::npos);
+
+	for (const char* name : { "\"parse\"", "\"read_chunk\"", "\"crc\"", "\"inflate\"",
+	                          "\"inflate_block\"", "\"unfilter\"", "\"unfilter_lane\"",
+	                          "\"expand\"", "\"exited thread\"", "\"pool worker 0\"",
+	                          "\"read 1\"", "\"read_file\"", "\"decode_image\"" })
+	{
+		EXPECT_NE(trace.find(name), std::string::npos) << name;
+	}
+
+	// Events are written once, a new trace starts empty
+	trv::start_tracing(path.string());
+	trv::stop_tracing();
+
+	trace = read_trace(path);
+	EXPECT_EQ(trace.find("\"ph\":\"X\""), std::string::npos);
+
+	std::filesystem::remove(path);
+}
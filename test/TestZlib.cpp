@@ -2,10 +2,6 @@
 
 #include <random>
 
-#ifndef TRV_TEST_MULTITHREADED
-#undef TRV_PNG_MULTITHREADED
-#endif
-
 #include "Zlib.hpp"
 
 using namespace trv;
@@ -32,6 +28,46 @@ TEST(TestZlib, TestDeflateNoCompression)
 	}
 }
 
+TEST(TestZlib, TestAdler32Trailer)
+{
+	static const std::vector<unsigned char> data { 0x08, 0x1d, 0x01, 0x10, 0x00, 0xef, 0xff,
+		                                           0x00, 0x00, 0x00, 0xff, 0x00, 0x0f, 0x00,
+		                                           0xf0, 0x00, 0x33, 0x00, 0xcc, 0x00, 0x55,
+		                                           0x00, 0xaa, 0x1d, 0x22, 0x03, 0xfd };
+
+	std::vector<unsigned char> corrupt = data;
+	corrupt.back() ^= 1;
+
+	std::vector<unsigned char> output;
+	DeflateArgs args { true, corrupt, output };
+	EXPECT_THROW(decompress(args), std::runtime_error);
+
+	std::vector<unsigned char> truncated(data.begin(), data.end() - 2);
+	output.clear();
+	DeflateArgs truncatedArgs { true, truncated, output };
+	EXPECT_THROW(decompress(truncatedArgs), std::runtime_error);
+
+	// Output stopped short of the end is never checked
+	output.clear();
+	DeflateArgs limitedArgs { true, corrupt, output };
+	limitedArgs.outputLimit = 15;
+	EXPECT_NO_THROW(decompress(limitedArgs));
+	EXPECT_EQ(output.size(), 15);
+}
+
+TEST(TestZlib, TestFixedHuffmanLongMatch)
+{
+	// A literal and a match of length 101, whose fixed code 279 is followed by set extra bits
+	static const std::vector<unsigned char> data { 0x78, 0x01, 0x4b, 0x4c, 0xa4, 0x07, 0x00, 0x00,
+		                                           0xc7, 0x34, 0x26, 0xa7, 0x00, 0x00 };
+	std::vector<unsigned char> output;
+	DeflateArgs args { true, data, output };
+
+	decompress(args);
+
+	EXPECT_EQ(output, std::vector<unsigned char>(102, 'a'));
+}
+
 TEST(TestZlib, PeekLitteByteLittleBit)
 {
 	static const std::vector<unsigned char> input1 { 0b00100101, 0b01000010 };
@@ -211,3 +247,58 @@ TEST(TestZlib, ConsumeBigByteBigBit)
 	result = consumer.consume_bits<uint16_t, std::endian::big>(10);
 	EXPECT_EQ(result, 0b11111);
 }
+
+TEST(TestZlib, TestInflaterMatchesDecompress)
+{
+	// zlib.compress(bytes((i * i + 3 * i) % 29 for i in range(600)), 9)
+	static const std::vector<unsigned char> data {
+		0x78, 0xda, 0x63, 0x60, 0xe1, 0x12, 0x92, 0xe1, 0x96, 0xe4, 0x61, 0x14, 0xe5, 0xe3, 0x64,
+		0x63, 0x65, 0xe3, 0xe4, 0x13, 0x65, 0xe4, 0x91, 0xe4, 0x96, 0x11, 0xe2, 0x62, 0x61, 0x90,
+		0x96, 0x66, 0x18, 0x95, 0x1c, 0x95, 0x24, 0x4f, 0x12, 0x00, 0xa7, 0x69, 0x1e, 0x58
+	};
+
+	std::vector<unsigned char> expected(600);
+
+	for (size_t i = 0; i < expected.size(); ++i)
+	{
+		expected[i] = static_cast<unsigned char>((i * i + 3 * i) % 29);
+	}
+
+	std::vector<unsigned char> output;
+	DeflateArgs args { true, data, output };
+	decompress(args);
+
+	EXPECT_EQ(output, expected);
+
+	// Input arrives one byte at a time and is read back in uneven pieces
+	std::size_t fed = 0;
+	Inflater inflater(true,
+	                  [&](std::vector<unsigned char>& input)
+	                  {
+		                  if (fed == data.size()) return false;
+		                  input.push_back(data[fed++]);
+		                  return true;
+	                  });
+
+	std::vector<unsigned char> streamed(expected.size() + 10);
+	std::size_t read = 0;
+
+	for (std::size_t piece = 1; read < streamed.size(); ++piece)
+	{
+		std::size_t count = std::min(piece, streamed.size() - read);
+		std::size_t got   = inflater.read(streamed.data() + read, count);
+		read += got;
+
+		if (got < count) break;
+	}
+
+	streamed.resize(read);
+	EXPECT_EQ(streamed, expected);
+
+	std::vector<unsigned char> limited;
+	DeflateArgs limitedArgs { true, data, limited };
+	limitedArgs.outputLimit = 123;
+	decompress(limitedArgs);
+
+	EXPECT_EQ(limited, std::vector<unsigned char>(expected.begin(), expected.begin() + 123));
+}